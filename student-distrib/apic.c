@@ -0,0 +1,256 @@
+/* apic.c - local APIC timer, IOAPIC routing and interrupt acknowledgement.
+ *
+ * When the machine has APICs, the scheduler tick comes from each cpu's local APIC timer
+ * (calibrated against the PIT) and the keyboard and RTC are routed through the IOAPIC, so an EOI
+ * is one store to the local APIC instead of port writes to one or both 8259s. Without an MP table,
+ * or with USE_APIC set to 0, everything stays on the 8259 and the PIT. Every device handler
+ * acknowledges through irq_eoi, which picks the right controller and records the entry-to-EOI
+ * cost of each path. */
+
+#include "apic.h"
+#include "smp.h"
+#include "smp_s.h"
+#include "lib.h"
+#include "x86_desc.h"
+#include "paging.h"
+#include "pcb.h"
+#include "scheduler.h"
+#include "timer.h"
+#include "keyboard.h"
+#include "rtc.h"
+#include "kinfo.h"
+#include "serial.h"
+
+volatile uint32_t irq_routed = 0;
+uint32_t lapic_timer_count = 0;
+
+static irq_cost_t irq_cost[MAX_CPUS][NUM_IRQS][NUM_IRQ_PATHS];
+
+static void irq_account(uint32_t irq, uint32_t path);
+
+static inline uint32_t ioapic_read(uint32_t reg) {
+    *(volatile uint32_t*)(ioapic_base + IOAPIC_REGSEL) = reg;
+    return *(volatile uint32_t*)(ioapic_base + IOAPIC_WIN);
+}
+
+static inline void ioapic_write(uint32_t reg, uint32_t val) {
+    *(volatile uint32_t*)(ioapic_base + IOAPIC_REGSEL) = reg;
+    *(volatile uint32_t*)(ioapic_base + IOAPIC_WIN) = val;
+}
+
+/* lapic_timer_calibrate
+ *   Inputs: none
+ *   Return Value: none
+ *   Function: Called on the boot cpu with interrupts on. Lets the local APIC timer count down
+ *             from its maximum for LAPIC_CALIBRATE_TICKS PIT ticks to find the count for one
+ *             tick. The bus clock is shared, so the other cpus use the same count. */
+void lapic_timer_calibrate() {
+    uint32_t start, elapsed;
+
+    if (!USE_APIC || lapic_base == 0)
+        return;
+
+    lapic_write(LAPIC_TIMER_DIV, LAPIC_TIMER_DIV16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+
+    /* start right after a tick so the window is whole ticks */
+    start = pit_ticks;
+    while (pit_ticks == start)
+        asm volatile ("hlt");
+
+    start = pit_ticks;
+    lapic_write(LAPIC_TIMER_INIT, 0xFFFFFFFF);
+    while (pit_ticks - start < LAPIC_CALIBRATE_TICKS)
+        asm volatile ("hlt");
+    elapsed = 0xFFFFFFFF - lapic_read(LAPIC_TIMER_CUR);
+    lapic_write(LAPIC_TIMER_INIT, 0);
+
+    lapic_timer_count = elapsed / LAPIC_CALIBRATE_TICKS;
+    if (lapic_timer_count == 0)
+        return;
+
+    idt[LAPIC_TIMER_VECTOR].present = 1;
+    idt[LAPIC_TIMER_VECTOR].dpl = 0;
+    idt[LAPIC_TIMER_VECTOR].reserved0 = 0;
+    idt[LAPIC_TIMER_VECTOR].size = 1;
+    idt[LAPIC_TIMER_VECTOR].reserved1 = 1;
+    idt[LAPIC_TIMER_VECTOR].reserved2 = 1;
+    idt[LAPIC_TIMER_VECTOR].reserved3 = 0;
+    idt[LAPIC_TIMER_VECTOR].reserved4 = 0;
+    idt[LAPIC_TIMER_VECTOR].seg_selector = KERNEL_CS;
+    SET_IDT_ENTRY(idt[LAPIC_TIMER_VECTOR], apic_timer_link);
+}
+
+/* lapic_timer_start
+ *   Inputs: none
+ *   Return Value: none
+ *   Function: starts this cpu's local APIC timer at PIT_FREQ, if it was calibrated */
+void lapic_timer_start() {
+    if (lapic_timer_count == 0)
+        return;
+
+    lapic_write(LAPIC_TIMER_DIV, LAPIC_TIMER_DIV16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_PERIODIC | LAPIC_TIMER_VECTOR);
+    lapic_write(LAPIC_TIMER_INIT, lapic_timer_count);
+}
+
+/* apic_route_irq
+ *   Inputs: irq - ISA IRQ, on - 1 to deliver it through the IOAPIC, 0 to go back to the 8259
+ *   Return Value: none
+ *   Function: Moves one IRQ line between the controllers, keeping its vector. Edge interrupts
+ *             raised while the IOAPIC entry is masked are lost, so the caller re-arms the device. */
+void apic_route_irq(uint32_t irq, uint32_t on) {
+    uint32_t flags;
+    uint32_t reg;
+
+    if (ioapic_base == 0 || irq >= NUM_ISA_IRQS)
+        return;
+
+    reg = IOAPIC_REDTBL + 2 * isa_irq_pin[irq];
+
+    cli_and_save(flags);
+    if (on) {
+        disable_irq(irq);
+        /* fixed delivery to the boot cpu, physical destination, edge triggered, active high */
+        ioapic_write(reg + 1, cpus[0].apic_id << 24);
+        ioapic_write(reg, IRQ_VECTOR_BASE + irq);
+        irq_routed |= (1 << irq);
+    } else {
+        ioapic_write(reg, IOAPIC_MASKED | (IRQ_VECTOR_BASE + irq));
+        irq_routed &= ~(1 << irq);
+        enable_irq(irq);
+    }
+    restore_flags(flags);
+}
+
+/* apic_init
+ *   Inputs: none
+ *   Return Value: none
+ *   Function: Called from smp_init once the APICs are found and the other cpus are up. Moves the boot cpu's scheduler tick from
+ *             the PIT to its local APIC timer and the keyboard, RTC and COM1 to the IOAPIC. Whatever
+ *             is missing stays on the 8259. */
+void apic_init() {
+    if (!USE_APIC || lapic_base == 0)
+        return;
+
+    if (lapic_timer_count != 0) {
+        lapic_timer_start();
+        disable_irq(PIT_IRQ);
+    }
+
+    if (ioapic_base != 0 && (ioapic_base >> 22) == (APIC_MMIO_BASE >> 22)) {
+        apic_route_irq(KEYBOARD_IRQ, 1);
+        apic_route_irq(RTC_IRQ, 1);
+        apic_route_irq(SERIAL_IRQ, 1);
+        rtc_ack();
+        serial_ack();
+    } else {
+        ioapic_base = 0;
+    }
+
+    printf("apic: timer %u counts per tick, ioapic %s\n", lapic_timer_count,
+            ioapic_base ? "on" : "off");
+}
+
+/* apic_timer_handler
+ *   Inputs: frame - registers saved by apic_timer_link
+ *   Return Value: none
+ *   Function: Scheduler tick from the local APIC timer. Every cpu gets its own, so nothing is
+ *             forwarded; the boot cpu also keeps the clock and the timer wheel. */
+void apic_timer_handler(irq_frame_t* frame) {
+    irq_enter();
+    lapic_eoi();
+    irq_account(PIT_IRQ, IRQ_PATH_APIC);
+    cli();
+    if (smp_cpu_id() == 0) {
+        pit_ticks++;
+        timer_tick();
+        if (pit_ticks % PRESENT_TICKS == 0)
+            console_present();
+    }
+    kinfo_update();
+    account_tick(frame->cs);
+
+    switch_process();
+
+    sti();
+}
+
+/* irq_enter
+ *   Inputs: none
+ *   Return Value: none
+ *   Function: first thing a device handler does, stamps the start of the entry-to-EOI window */
+void irq_enter() {
+    this_cpu()->irq_tsc = rdtsc();
+}
+
+/* irq_account
+ *   Inputs: irq - IRQ being serviced, path - controller it was acknowledged on
+ *   Return Value: none
+ *   Function: records the time from irq_enter to now, called right after the EOI */
+static void irq_account(uint32_t irq, uint32_t path) {
+    uint32_t cpu = smp_cpu_id();
+    uint32_t cost = (uint32_t)(rdtsc() - cpus[cpu].irq_tsc);
+    irq_cost_t* stat = &irq_cost[cpu][irq][path];
+
+    stat->count++;
+    stat->cycles += cost;
+    if (cost > stat->max)
+        stat->max = cost;
+}
+
+/* irq_eoi
+ *   Inputs: irq - IRQ being serviced
+ *   Return Value: none
+ *   Function: acknowledges irq on whichever controller delivered it. The local APIC timer is
+ *             not an IRQ line and is acknowledged by apic_timer_handler itself. */
+void irq_eoi(uint32_t irq) {
+    if (irq >= NUM_IRQS)
+        return;
+
+    if (irq_routed & (1 << irq)) {
+        lapic_eoi();
+        irq_account(irq, IRQ_PATH_APIC);
+    } else {
+        send_eoi(irq);
+        irq_account(irq, IRQ_PATH_8259);
+    }
+}
+
+/* irq_cost_reset
+ *   Inputs: none
+ *   Return Value: none
+ *   Function: clears the entry-to-EOI statistics */
+void irq_cost_reset() {
+    uint32_t flags;
+    cli_and_save(flags);
+    memset(irq_cost, 0, sizeof(irq_cost));
+    restore_flags(flags);
+}
+
+/* irq_cost_report
+ *   Inputs: none
+ *   Return Value: none
+ *   Function: prints the average and worst entry-to-EOI cycles of every source and path seen
+ *             since the last reset, all cpus together */
+void irq_cost_report() {
+    uint32_t irq, path, cpu;
+    irq_cost_t sum;
+
+    for (irq = 0; irq < NUM_IRQS; irq++) {
+        for (path = 0; path < NUM_IRQ_PATHS; path++) {
+            sum.count = sum.cycles = sum.max = 0;
+            for (cpu = 0; cpu < MAX_CPUS; cpu++) {
+                sum.count += irq_cost[cpu][irq][path].count;
+                sum.cycles += irq_cost[cpu][irq][path].cycles;
+                if (irq_cost[cpu][irq][path].max > sum.max)
+                    sum.max = irq_cost[cpu][irq][path].max;
+            }
+            if (sum.count == 0)
+                continue;
+            printf("irq %u %s: %u irqs, avg %u cycles, max %u\n", irq,
+                    path == IRQ_PATH_APIC ? "apic" : "8259",
+                    sum.count, sum.cycles / sum.count, sum.max);
+        }
+    }
+}
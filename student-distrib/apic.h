@@ -0,0 +1,58 @@
+#ifndef _APIC_H
+#define _APIC_H
+
+#include "types.h"
+#include "i8259.h"
+#include "pit.h"
+
+/* set to 0 to keep every interrupt on the 8259 and the PIT, as before */
+#define USE_APIC 1
+
+/* IOAPIC registers: an index is written to IOREGSEL, then the register is accessed through IOWIN */
+#define IOAPIC_REGSEL   0x00
+#define IOAPIC_WIN      0x10
+#define IOAPIC_REDTBL   0x10            // redirection entry n is registers 0x10+2n (low) and 0x11+2n (high)
+#define IOAPIC_MASKED   0x10000
+
+/* vector of ISA IRQ n, the same whether it comes through the 8259 or the IOAPIC */
+#define IRQ_VECTOR_BASE 0x20
+
+/* An 8259 acknowledged with nothing left to deliver, e.g. when a line is masked just as it fires,
+ * answers with IRQ 7 (master) or IRQ 15 (slave). Neither line is used here, so only spurious
+ * interrupts arrive on these vectors */
+#define PIC_SPURIOUS_VECTOR         (IRQ_VECTOR_BASE + 7)
+#define PIC_SPURIOUS_SLAVE_VECTOR   (IRQ_VECTOR_BASE + 15)
+
+/* PIT ticks the local APIC timer is counted against */
+#define LAPIC_CALIBRATE_TICKS 10
+
+/* which controller acknowledged an interrupt */
+#define IRQ_PATH_8259   0
+#define IRQ_PATH_APIC   1
+#define NUM_IRQ_PATHS   2
+
+/* entry-to-EOI cost of one interrupt source over one path */
+typedef struct irq_cost_t{
+    uint32_t count;
+    uint32_t cycles;                    // total, reset before a measurement so it does not wrap
+    uint32_t max;
+}irq_cost_t;
+
+/* bitmask of the IRQ lines acknowledged through the local APIC instead of the 8259 */
+extern volatile uint32_t irq_routed;
+
+/* local APIC count per PIT tick, 0 if the scheduler tick still comes from the PIT */
+extern uint32_t lapic_timer_count;
+
+extern void apic_init();
+extern void lapic_timer_calibrate();
+extern void lapic_timer_start();
+extern void apic_route_irq(uint32_t irq, uint32_t on);
+extern void apic_timer_handler(irq_frame_t* frame);
+
+extern void irq_enter();
+extern void irq_eoi(uint32_t irq);
+extern void irq_cost_reset();
+extern void irq_cost_report();
+
+#endif
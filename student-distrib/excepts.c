@@ -7,6 +7,9 @@
 #include "lib.h"
 #include "excepts_s.h"
 #include "systemcall.h"
+#include "fpu.h"
+#include "signal.h"
+#include "klog.h"
 
 extern void divide_error_link(); 
 extern void debug_link();
@@ -85,14 +88,18 @@ void setup_exceptions(){
 }
 
 /* divide_error
- *   Inputs: none
+ *   Inputs: frame - registers at the fault
  *   Return Value: none
- *   Function: Exception handler for divide exception.  */
-void divide_error(){
+ *   Function: Exception handler for divide exception.
+ *             A fault in a user program that has a SIG_DIV_ZERO handler becomes that signal instead.  */
+void divide_error(irq_frame_t* frame){
+
+    if (raise_fault(frame, SIG_DIV_ZERO))
+        return;
 
     cli(); 
     exception_flag = 1; 
-    printf("ERR Trying to divide by 0 \n");
+    printk(KLOG_ERR, "ERR Trying to divide by 0 \n");
     halt(0);
 
     sti(); 
@@ -106,7 +113,7 @@ extern void debug(){
 
     cli();
     exception_flag = 1; 
-    printf("ERR DB exception \n");
+    printk(KLOG_ERR, "ERR DB exception \n");
     halt(0);
 
     sti(); 
@@ -121,7 +128,7 @@ extern void nmi_interrupt(){
 
     cli(); 
     exception_flag = 1;  
-    printf("ERR Non-Maskable Interrupt \n");
+    printk(KLOG_ERR, "ERR Non-Maskable Interrupt \n");
     halt(0);
 
     sti(); 
@@ -135,7 +142,7 @@ extern void breakpoint(){
 
     cli(); 
     exception_flag = 1;  
-    printf("ERR breakpoint \n");
+    printk(KLOG_ERR, "ERR breakpoint \n");
     halt(0);
 
     sti(); 
@@ -150,7 +157,7 @@ extern void overflow(){
 
     cli(); 
     exception_flag = 1;  
-    printf("ERR overflow \n");
+    printk(KLOG_ERR, "ERR overflow \n");
     halt(0);
 
     sti(); 
@@ -165,7 +172,7 @@ extern void bound_rng_ex(){
 
     cli();
     exception_flag = 1;  
-    printf("ERR bound range exceeded \n");
+    printk(KLOG_ERR, "ERR bound range exceeded \n");
     halt(0);
 
     sti(); 
@@ -173,14 +180,18 @@ extern void bound_rng_ex(){
 
 
 /* invalid_op
- *   Inputs: none
+ *   Inputs: frame - registers at the fault
  *   Return Value: none
- *   Function: Exception handler for invalid opcode exception.  */
-extern void invalid_op(){
+ *   Function: Exception handler for invalid opcode exception.
+ *             A fault in a user program that has a SIG_SEGFAULT handler becomes that signal instead.  */
+extern void invalid_op(irq_frame_t* frame){
+
+    if (raise_fault(frame, SIG_SEGFAULT))
+        return;
 
     cli();
     exception_flag = 1;  
-    printf("ERR invalid opcode \n");
+    printk(KLOG_ERR, "ERR invalid opcode \n");
     halt(0);
 
     sti(); 
@@ -191,15 +202,11 @@ extern void invalid_op(){
 /* device_not_avail
  *   Inputs: none
  *   Return Value: none
- *   Function: Exception handler for device not available exception.  */
+ *   Function: Exception handler for device not available exception. Raised by the first fpu/SSE
+ *             instruction after a process switch, hands the fpu to the current process.  */
 extern void device_not_avail(){
 
-    cli();
-    exception_flag = 1;  
-    printf("ERR device not available \n");
-    halt(0);
-
-    sti(); 
+    fpu_handle_nm();
 }
 
 
@@ -211,7 +218,7 @@ extern void dbl_fault(){
 
     cli(); 
     exception_flag = 1;  
-    printf("ERR Double Fault \n");
+    printk(KLOG_ERR, "ERR Double Fault \n");
     halt(0);
 
     sti(); 
@@ -226,7 +233,7 @@ extern void co_seg_overrun(){
     
     cli(); 
     exception_flag = 1;  
-    printf("ERR Coprocessor Segment Overrun \n");
+    printk(KLOG_ERR, "ERR Coprocessor Segment Overrun \n");
     halt(0);
 
     sti(); 
@@ -240,7 +247,7 @@ extern void invalid_tss(){
 
     cli(); 
     exception_flag = 1;  
-    printf("ERR Invalid TSS \n");
+    printk(KLOG_ERR, "ERR Invalid TSS \n");
     halt(0);
 
     sti();
@@ -256,7 +263,7 @@ extern void seg_not_present(){
        
     cli();
     exception_flag = 1;  
-    printf("ERR Segment Not Present \n");
+    printk(KLOG_ERR, "ERR Segment Not Present \n");
     halt(0);
 
     sti();
@@ -264,14 +271,18 @@ extern void seg_not_present(){
 
 
 /* stack_seg_fault
- *   Inputs: none
+ *   Inputs: frame - registers at the fault
  *   Return Value: none
- *   Function: Exception handler for Stack Segment Fault.  */
-extern void stack_seg_fault(){
+ *   Function: Exception handler for Stack Segment Fault.
+ *             A fault in a user program that has a SIG_SEGFAULT handler becomes that signal instead.  */
+extern void stack_seg_fault(irq_frame_t* frame){
+
+    if (raise_fault(frame, SIG_SEGFAULT))
+        return;
 
     cli();
     exception_flag = 1;  
-    printf("ERR Stack-Segment Fault \n");
+    printk(KLOG_ERR, "ERR Stack-Segment Fault \n");
     halt(0);
 
     sti();
@@ -279,14 +290,18 @@ extern void stack_seg_fault(){
 
 
 /* gen_prot
- *   Inputs: none
+ *   Inputs: frame - registers at the fault
  *   Return Value: none
- *   Function: Exception handler for General Protection Fault.  */
-extern void gen_prot(){
+ *   Function: Exception handler for General Protection Fault.
+ *             A fault in a user program that has a SIG_SEGFAULT handler becomes that signal instead.  */
+extern void gen_prot(irq_frame_t* frame){
+
+    if (raise_fault(frame, SIG_SEGFAULT))
+        return;
 
     cli(); 
     exception_flag = 1;  
-    printf("ERR General Protection Fault \n");
+    printk(KLOG_ERR, "ERR General Protection Fault \n");
     halt(0);
 
     sti();
@@ -295,14 +310,18 @@ extern void gen_prot(){
 
 
 /* page_fault
- *   Inputs: none
+ *   Inputs: frame - registers at the fault
  *   Return Value: none
- *   Function: Exception handler for Page Fault.  */
-extern void page_fault(){
+ *   Function: Exception handler for Page Fault.
+ *             A fault in a user program that has a SIG_SEGFAULT handler becomes that signal instead.  */
+extern void page_fault(irq_frame_t* frame){
+
+    if (raise_fault(frame, SIG_SEGFAULT))
+        return;
 
     cli();
     exception_flag = 1;  
-    printf("ERR Page Fault \n");
+    printk(KLOG_ERR, "ERR Page Fault \n");
     halt(0);
 
     sti(); 
@@ -318,7 +337,7 @@ extern void fp_error(){
 
     cli(); 
     exception_flag = 1;  
-    printf("ERR Floating-Point Error \n");
+    printk(KLOG_ERR, "ERR Floating-Point Error \n");
     halt(0);
 
     sti(); 
@@ -334,7 +353,7 @@ extern void align_check(){
 
     cli();
     exception_flag = 1;  
-    printf("ERR Alignment Check Fault \n");
+    printk(KLOG_ERR, "ERR Alignment Check Fault \n");
     halt(0);
 
     sti();
@@ -349,7 +368,7 @@ extern void mach_check(){
 
     cli(); 
     exception_flag = 1;  
-    printf("ERR Machine Check \n");
+    printk(KLOG_ERR, "ERR Machine Check \n");
     halt(0);
     sti();
 }
@@ -363,7 +382,7 @@ extern void simd_fp(){
 
     cli(); 
     exception_flag = 1;  
-    printf("ERR SIMD Floating-Point Exception \n");
+    printk(KLOG_ERR, "ERR SIMD Floating-Point Exception \n");
     halt(0);
     sti(); 
     
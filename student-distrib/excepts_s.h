@@ -32,5 +32,6 @@ extern void simd_fp_link();
 extern void rtc_link(); 
 extern void keyboard_link(); 
 extern void pit_int_link();
+extern void serial_link();
 
 #endif
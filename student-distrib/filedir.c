@@ -64,8 +64,8 @@ int32_t dir_read(int32_t fd, void* buf, int32_t nbytes){
     cli();
 
     // Initialize variables for reading data
-    uint32_t dir_fname_offset = pcb_ptr[active_pid]->fd_array[fd].file_pos % FNAME_SIZE;              // offset into file name of current directory entry
-    uint32_t dir_index = pcb_ptr[active_pid]->fd_array[fd].file_pos / FNAME_SIZE;
+    uint32_t dir_fname_offset = fd_get(fd)->file_pos % FNAME_SIZE;              // offset into file name of current directory entry
+    uint32_t dir_index = fd_get(fd)->file_pos / FNAME_SIZE;
 
     while((bytes_read < nbytes) && (dir_index < boot_block->num_dir_entries)){
 
@@ -87,7 +87,7 @@ int32_t dir_read(int32_t fd, void* buf, int32_t nbytes){
     }
 
     // update file position
-    pcb_ptr[active_pid]->fd_array[fd].file_pos +=bytes_read; 
+    fd_get(fd)->file_pos +=bytes_read; 
 
     sti();
 
@@ -0,0 +1,135 @@
+/* fpu.c - lazy x87/SSE context switching. The fpu is handed to a process only when it first
+ * executes an fpu/SSE instruction after a switch (#NM with CR0.TS set), so processes that never
+ * use floating point never pay for saving it. */
+
+#include "fpu.h"
+#include "lib.h"
+#include "pcb.h"
+#include "scheduler.h"
+#include "x86_desc.h"
+
+#define CR0_MP 0x02         // monitor coprocessor: wait/fwait also honor TS
+#define CR0_EM 0x04         // emulation: must be clear to use the fpu
+#define CR0_TS 0x08         // task switched: next fpu instruction raises #NM
+#define CR0_NE 0x20         // native fpu error reporting through #MF
+#define CR4_OSFXSR 0x200    // enable fxsave/fxrstor and SSE
+#define CR4_OSXMMEXCPT 0x400 // unmasked SIMD exceptions raise #XM
+
+#define CPUID_FXSR (1 << 24)
+#define CPUID_SSE (1 << 25)
+
+/* process whose state is live in each cpu's fpu registers, -1 if none. Processes never change cpu */
+static int32_t cpu_fpu_owner[MAX_CPUS] = { [0 ... MAX_CPUS-1] = -1 };
+#define fpu_owner (cpu_fpu_owner[smp_cpu_id()])
+static uint8_t has_fxsr = 0;
+static uint8_t has_sse = 0;
+
+static inline uint32_t read_cr0() {
+    uint32_t val;
+    asm volatile ("movl %%cr0, %0" : "=r"(val));
+    return val;
+}
+
+static inline void write_cr0(uint32_t val) {
+    asm volatile ("movl %0, %%cr0" : : "r"(val) : "memory");
+}
+
+/* fpu_init
+ *   Inputs: none
+ *   Return Value: none
+ *   Function: Enables the x87 fpu and, when the cpu has them, fxsave and SSE. Leaves CR0.TS set
+ *             so the first process to use the fpu traps into fpu_handle_nm. Run once on every cpu. */
+void fpu_init() {
+    uint32_t eax, ebx, ecx, edx;
+    uint32_t cr0, cr4;
+
+    eax = 1;
+    asm volatile ("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+    has_fxsr = (edx & CPUID_FXSR) ? 1 : 0;
+    has_sse = (has_fxsr && (edx & CPUID_SSE)) ? 1 : 0;
+
+    if (has_fxsr) {
+        asm volatile ("movl %%cr4, %0" : "=r"(cr4));
+        cr4 |= CR4_OSFXSR;
+        if (has_sse)
+            cr4 |= CR4_OSXMMEXCPT;
+        asm volatile ("movl %0, %%cr4" : : "r"(cr4) : "memory");
+    }
+
+    cr0 = read_cr0();
+    cr0 &= ~(CR0_EM | CR0_TS);
+    cr0 |= CR0_MP | CR0_NE;
+    write_cr0(cr0);
+    asm volatile ("fninit");
+
+    write_cr0(cr0 | CR0_TS);
+    fpu_owner = -1;
+}
+
+/* fpu_switch
+ *   Inputs: pid - process about to run
+ *   Return Value: none
+ *   Function: Called on every process switch. Sets CR0.TS unless pid already owns the fpu,
+ *             in which case its registers are still live and it can use them without a trap. */
+void fpu_switch(int32_t pid) {
+    uint32_t cr0 = read_cr0();
+
+    if (pid == fpu_owner) {
+        if (cr0 & CR0_TS)
+            asm volatile ("clts");
+    } else if (!(cr0 & CR0_TS)) {
+        write_cr0(cr0 | CR0_TS);
+    }
+}
+
+/* fpu_release
+ *   Inputs: pid - process that is exiting or being replaced
+ *   Return Value: none
+ *   Function: drops the fpu state of pid, its registers no longer need saving */
+void fpu_release(int32_t pid) {
+    if (fpu_owner == pid)
+        fpu_owner = -1;
+    pcb_ptr[pid]->fpu.used = 0;
+    write_cr0(read_cr0() | CR0_TS);
+}
+
+/* fpu_handle_nm
+ *   Inputs: none
+ *   Return Value: none
+ *   Function: #NM handler. Saves the previous owner's registers into its PCB, then loads the
+ *             current process's (or a clean state on first use) and lets the instruction retry. */
+void fpu_handle_nm() {
+    uint32_t flags;
+    pcb_entry_t* pcb;
+
+    cli_and_save(flags);
+    asm volatile ("clts");
+
+    if (fpu_owner == active_pid || active_pid < 0)
+        { restore_flags(flags); return; }
+
+    if (fpu_owner != -1) {
+        pcb = pcb_ptr[fpu_owner];
+        if (has_fxsr)
+            asm volatile ("fxsave (%0)" : : "r"(pcb->fpu.area) : "memory");
+        else
+            asm volatile ("fnsave (%0)" : : "r"(pcb->fpu.area) : "memory");
+    }
+
+    pcb = pcb_ptr[active_pid];
+    if (pcb->fpu.used) {
+        if (has_fxsr)
+            asm volatile ("fxrstor (%0)" : : "r"(pcb->fpu.area) : "memory");
+        else
+            asm volatile ("frstor (%0)" : : "r"(pcb->fpu.area) : "memory");
+    } else {
+        uint32_t mxcsr = MXCSR_DEFAULT;
+        asm volatile ("fninit");
+        if (has_sse)
+            asm volatile ("ldmxcsr %0" : : "m"(mxcsr));
+        pcb->fpu.used = 1;
+    }
+
+    fpu_owner = active_pid;
+    restore_flags(flags);
+}
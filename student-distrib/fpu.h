@@ -0,0 +1,20 @@
+#ifndef _FPU_H
+#define _FPU_H
+
+#include "types.h"
+
+#define FXSAVE_SIZE 512
+#define MXCSR_DEFAULT 0x1F80     // all SIMD exceptions masked, round to nearest
+
+/* x87/SSE register state of a process, saved only while another process owns the fpu */
+typedef struct fpu_state_t{
+    uint8_t area[FXSAVE_SIZE] __attribute__((aligned(16)));     // fxsave image (fnsave uses the first 108 bytes)
+    uint8_t used;                                               // process has touched the fpu since execute
+}fpu_state_t;
+
+extern void fpu_init();
+extern void fpu_switch(int32_t pid);
+extern void fpu_release(int32_t pid);
+extern void fpu_handle_nm();
+
+#endif
@@ -0,0 +1,98 @@
+/* ioring.c - batched system calls through a submission and a completion ring.
+ *
+ * A process queues reads, writes, opens and closes in its submission ring and hands them all to
+ * the kernel with one ioring_enter trap. Each entry goes through the same checks and the same
+ * fd table and file_op_tbl_ptr dispatch as the single system call would, in order. */
+
+#include "ioring.h"
+#include "systemcall.h"
+#include "lib.h"
+#include "pcb.h"
+#include "scheduler.h"
+
+/* ioring_setup
+ *   Inputs: ring - rings in the calling process's memory, NULL to unregister
+ *   Return Value: 0 on success, -1 if the rings are not in user memory
+ *   Function: registers the rings and empties them */
+int32_t ioring_setup(io_ring_t* ring){
+    if (ring == NULL) {
+        pcb_ptr[active_pid]->ring = NULL;
+        return 0;
+    }
+    if (bad_userspace_addr(ring, sizeof(io_ring_t)))
+        return -1;
+
+    ring->sq_head = ring->sq_tail = 0;
+    ring->cq_head = ring->cq_tail = 0;
+    pcb_ptr[active_pid]->ring = ring;
+    return 0;
+}
+
+/* ioring_op
+ *   Inputs: sqe - copy of a submission entry
+ *   Return Value: result of the operation, -1 on a bad entry
+ *   Function: runs one entry through the regular system call */
+static int32_t ioring_op(io_sqe_t* sqe){
+    switch (sqe->opcode) {
+        case IORING_OP_NOP:
+            return 0;
+        case IORING_OP_READ:
+            if (bad_userspace_addr((void*)sqe->addr, sqe->len))
+                return -1;
+            return read(sqe->fd, (void*)sqe->addr, sqe->len);
+        case IORING_OP_WRITE:
+            if (bad_userspace_addr((void*)sqe->addr, sqe->len))
+                return -1;
+            return write(sqe->fd, (const void*)sqe->addr, sqe->len);
+        case IORING_OP_OPEN:
+            if (bad_userspace_addr((void*)sqe->addr, 1))
+                return -1;
+            return open((const uint8_t*)sqe->addr);
+        case IORING_OP_CLOSE:
+            return close(sqe->fd);
+        default:
+            return -1;
+    }
+}
+
+/* ioring_enter
+ *   Inputs: to_submit - most submission entries to run
+ *   Return Value: number of entries consumed, -1 if no rings are registered or they are corrupt
+ *   Function: Runs queued entries in order, posting a completion for each. Stops early when the
+ *             submission ring is empty or the completion ring is full. */
+int32_t ioring_enter(uint32_t to_submit){
+    io_ring_t* ring = pcb_ptr[active_pid]->ring;
+    io_sqe_t sqe;
+    io_cqe_t* cqe;
+    uint32_t done = 0;
+    int32_t res, prev = 0;
+
+    if (ring == NULL)
+        return -1;
+    if (ring->sq_tail - ring->sq_head > IORING_ENTRIES || ring->cq_tail - ring->cq_head > IORING_ENTRIES)
+        return -1;
+
+    while (done < to_submit && ring->sq_head != ring->sq_tail) {
+        if (ring->cq_tail - ring->cq_head == IORING_ENTRIES)
+            break;
+
+        /* copy first, the process owns the slot */
+        sqe = ring->sq[ring->sq_head & IORING_MASK];
+
+        if (sqe.flags & IOSQE_LEN_FROM_PREV) {
+            sqe.len = prev;
+            res = (prev > 0) ? ioring_op(&sqe) : 0;
+        } else {
+            res = ioring_op(&sqe);
+        }
+        prev = res;
+
+        cqe = &ring->cq[ring->cq_tail & IORING_MASK];
+        cqe->user_data = sqe.user_data;
+        cqe->res = res;
+        ring->cq_tail++;
+        ring->sq_head++;
+        done++;
+    }
+    return done;
+}
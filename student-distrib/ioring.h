@@ -0,0 +1,53 @@
+#ifndef _IORING_H
+#define _IORING_H
+
+#include "types.h"
+
+/* slots in each ring, a power of two */
+#define IORING_ENTRIES 32
+#define IORING_MASK (IORING_ENTRIES - 1)
+
+/* operations */
+#define IORING_OP_NOP   0
+#define IORING_OP_READ  1
+#define IORING_OP_WRITE 2
+#define IORING_OP_OPEN  3
+#define IORING_OP_CLOSE 4
+
+/* sqe flags: take len from the result of the entry before it in the same ioring_enter, and
+ * complete with 0 without running if that result was 0 or an error (read then write chains) */
+#define IOSQE_LEN_FROM_PREV 0x01
+
+/* submission entry, filled in by the process */
+typedef struct io_sqe_t{
+    uint8_t opcode;
+    uint8_t flags;
+    uint16_t reserved;
+    int32_t fd;
+    uint32_t addr;                  // buffer for read/write, file name for open
+    int32_t len;
+    uint32_t user_data;             // copied to the completion
+}io_sqe_t;
+
+/* completion entry, filled in by the kernel */
+typedef struct io_cqe_t{
+    uint32_t user_data;
+    int32_t res;                    // what the equivalent system call would have returned
+}io_cqe_t;
+
+/* Both rings live in the process's own memory and are registered with ioring_setup. The process
+ * advances sq_tail and cq_head, the kernel advances sq_head and cq_tail. Indices run freely and
+ * are masked on use. */
+typedef struct io_ring_t{
+    volatile uint32_t sq_head;
+    volatile uint32_t sq_tail;
+    volatile uint32_t cq_head;
+    volatile uint32_t cq_tail;
+    io_sqe_t sq[IORING_ENTRIES];
+    io_cqe_t cq[IORING_ENTRIES];
+}io_ring_t;
+
+extern int32_t ioring_setup(io_ring_t* ring);
+extern int32_t ioring_enter(uint32_t to_submit);
+
+#endif
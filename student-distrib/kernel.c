@@ -20,6 +20,12 @@
 #include "pcb.h"
 #include "pit.h"
 #include "terminal.h"
+#include "timer.h"
+#include "fpu.h"
+#include "smp.h"
+#include "kinfo.h"
+#include "klog.h"
+#include "serial.h"
 
 #define RUN_TESTS
 
@@ -32,18 +38,21 @@
 void entry(unsigned long magic, unsigned long addr) {
 
     multiboot_info_t *mbi;
+    int32_t tid;
 
     /* Clear the screen. */
     clear();
 
-    /* Init video mem for all terminals */
-    memcpy((void*)TERMINAL_VIDMEM_PTR[0], (void*)VIDEO, FOUR_KB);
-    memcpy((void*)TERMINAL_VIDMEM_PTR[1], (void*)VIDEO, FOUR_KB);
-    memcpy((void*)TERMINAL_VIDMEM_PTR[2], (void*)VIDEO, FOUR_KB);
+    /* Init video mem for all terminals, blank like terminal 0's */
+    for (tid = 1; tid < NUM_TERMINALS; tid++) {
+        echo_to(tid);
+        clear();
+    }
+    echo_to(-1);
 
     /* Am I booted by a Multiboot-compliant boot loader? */
     if (magic != MULTIBOOT_BOOTLOADER_MAGIC) {
-        printf("Invalid magic number: 0x%#x\n", (unsigned)magic);
+        printk(KLOG_ERR, "Invalid magic number: 0x%#x\n", (unsigned)magic);
         return;
     }
 
@@ -132,29 +141,8 @@ void entry(unsigned long magic, unsigned long addr) {
         lldt(KERNEL_LDT);
     }
 
-    /* Construct a TSS entry in the GDT */
-    {
-        seg_desc_t the_tss_desc;
-        the_tss_desc.granularity   = 0x0;
-        the_tss_desc.opsize        = 0x0;
-        the_tss_desc.reserved      = 0x0;
-        the_tss_desc.avail         = 0x0;
-        the_tss_desc.seg_lim_19_16 = TSS_SIZE & 0x000F0000;
-        the_tss_desc.present       = 0x1;
-        the_tss_desc.dpl           = 0x0;
-        the_tss_desc.sys           = 0x0;
-        the_tss_desc.type          = 0x9;
-        the_tss_desc.seg_lim_15_00 = TSS_SIZE & 0x0000FFFF;
-
-        SET_TSS_PARAMS(the_tss_desc, &tss, tss_size);
-
-        tss_desc_ptr = the_tss_desc;
-
-        tss.ldt_segment_selector = KERNEL_LDT;
-        tss.ss0 = KERNEL_DS;
-        tss.esp0 = 0x800000;
-        ltr(KERNEL_TSS);
-    }
+    /* Construct the boot cpu's TSS entry in the GDT and load it */
+    tss_init(0);
 
 
     /* Initialize devices, memory, filesystem, enable device interrupts on the
@@ -163,11 +151,16 @@ void entry(unsigned long magic, unsigned long addr) {
     /* Construct 20 exception entries in IDT */
     setup_exceptions();
 
+    /* Enable x87/SSE, state is switched lazily through #NM */
+    fpu_init();
+
     /* add system call entry to idt */
     init_syscall_idt();
+    sysenter_init();
 
      /* enable pit interrupts */
     pit_init();
+    timer_init();
 
     /* Init the RTC*/
     rtc_init();
@@ -175,6 +168,9 @@ void entry(unsigned long magic, unsigned long addr) {
     /* Init the keyboard */
     keyboard_init();
 
+    /* COM1, if there is one, also gets a copy of the kernel log from here on */
+    serial_init();
+
     /* load idtr */
     lidt(idt_desc_ptr);
 
@@ -189,9 +185,13 @@ void entry(unsigned long magic, unsigned long addr) {
     /* init pcb structs */
     pcb_init();
 
+    /* wall clock and the shared kernel info page */
+    kinfo_init();
+
     enable_irq(RTC_IRQ);
     enable_irq(KEYBOARD_IRQ);
     enable_irq(PIT_IRQ);
+    enable_irq(SERIAL_IRQ);
 
     /* Enable interrupts */
     /* Do not enable the following until after you have set up your
@@ -200,12 +200,16 @@ void entry(unsigned long magic, unsigned long addr) {
    //printf("Enabling Interrupts\n");
    sti();
 
+    /* Start the other cpus */
+    smp_init();
+
 
 #ifdef RUN_TESTS
      /* Run tests */
    launch_tests();
  #endif
-    /* Execute the first program ("shell") ... */
+    /* Give every cpu its terminals, which starts the base shells ("shell") on the next ticks */
+    smp_start_terminals();
 
     /* Spin (nicely, so we don't chew up cycles) */
     asm volatile (".1: hlt; jmp .1;");
@@ -8,6 +8,10 @@
 #include "systemcall.h"
 #include "terminal.h"
 #include "scheduler.h"
+#include "spinlock.h"
+#include "apic.h"
+#include "signal.h"
+#include "poll.h"
 
 
 #define KEYBOARD_IRQ 1
@@ -19,9 +23,19 @@
 #define CAPS_LOCK_PRESSED 0x58
 #define CAPS_LOCK_RELEASED 0xF0
 #define TAB_SIZE 4
+#define ESCAPE_SCAN 0x01
+#define PGUP_SCAN 0x49
+#define PGDN_SCAN 0x51
+#define ASCII_ESC 0x1B
 
 extern void keyboard_link(); 
 
+/* the CRTC index/data port pair must not interleave between cpus */
+static spinlock_t vga_lock = SPINLOCK_INIT;
+
+/* VGA start address (cells from 0xB8000), the cursor position is relative to it */
+static int screen_start = 0;
+
 /* Keyboard variables */
 volatile int key_pressed;
 volatile int shift_pressed;
@@ -103,12 +117,94 @@ extern void keyboard_init() {
     caps_enabled = 0;
     ctrl_pressed = 0;
     int i;
-    for (i=0; i<NUM_TERMINALS; i++)
-        terminals[i].enter_pressed = 0;
+    for (i=0; i<NUM_TERMINALS; i++) {
+        terminals[i].kbd_head = terminals[i].kbd_tail = terminals[i].line_start = 0;
+        terminals[i].raw_pid = -1;
+        terminals[i].sync_pid = -1;
+    }
     
     // enter_pressed = 0;
     alt_pressed = 0;
-    terminals[cur_terminal].buf_ptr = 0;
+}
+
+/* key_char
+ *   Inputs: scan key
+ *   Return Value: character for the key with the current shift and caps lock state */
+static char key_char(uint8_t scan_key) {
+    if (is_letter(scan_key)) { // is a letter (both caps and shift affect output)
+        
+        if (shift_pressed && caps_enabled) // shift + caps negate each other
+            return key_map[scan_key];
+        else if (!shift_pressed && caps_enabled) // caps lock pressed, so print shifted letter
+            return shifted_key_map[scan_key];
+        else if (shift_pressed && !caps_enabled) // shift pressed, so print shifted letter
+            return shifted_key_map[scan_key];
+        else // no shift or caps, so print normal letter
+            return key_map[scan_key];
+    
+    } else { // not a letter (shift affects output, caps does not)
+        
+        if (shift_pressed)      
+            return shifted_key_map[scan_key];
+        else
+            return key_map[scan_key];            
+    
+    }
+}
+
+/* raw_push
+ *   Inputs: c - character typed
+ *   Return Value: none
+ *   Function: queues a keystroke for a raw mode reader of the visible terminal, dropped when the
+ *             queue is full. Only the keyboard interrupt adds, only the reader removes */
+static void raw_push(char c) {
+    terminal_t* term = &terminals[cur_terminal];
+
+    if (term->raw_tail - term->raw_head == RAW_BUF_SIZE)
+        return;
+    term->raw_buf[term->raw_tail % RAW_BUF_SIZE] = c;
+    term->raw_tail++;
+    poll_wake();
+}
+
+/* kbd_push
+ *   Inputs: c - character typed in line mode
+ *   Return Value: 1 if it was queued (and should be echoed), 0 if it was dropped
+ *   Function: adds a key to the visible terminal's line being typed, Enter finishes the line and
+ *             hands it to the reader. A line stops growing at MAX_BUFFER_SIZE - 1 characters, and
+ *             one slot is kept for the '\n' so a line being typed can always be finished. Nothing,
+ *             not even Enter, is queued over unread input once the ring is full. Only the
+ *             keyboard interrupt adds, only the reader removes, so neither side takes a lock */
+static int kbd_push(char c) {
+    terminal_t* term = &terminals[cur_terminal];
+    uint32_t tail = term->kbd_tail;
+
+    if (tail - term->kbd_head >= KBD_BUF_SIZE)
+        return 0;
+    if (c != '\n' && (tail - term->line_start >= MAX_BUFFER_SIZE - 1 || tail - term->kbd_head + 2 > KBD_BUF_SIZE))
+        return 0;
+    term->kbd_buf[tail % KBD_BUF_SIZE] = c;
+    /* the character is in before the index that lets the reader see it */
+    asm volatile ("" : : : "memory");
+    term->kbd_tail = tail + 1;
+    if (c == '\n') {
+        term->line_start = tail + 1;
+        poll_wake();
+    }
+    return 1;
+}
+
+/* kbd_erase
+ *   Inputs: none
+ *   Return Value: 1 if a character was taken back, 0 if the line being typed is empty
+ *   Function: Backspace in line mode, never reaches into lines already entered */
+static int kbd_erase() {
+    terminal_t* term = &terminals[cur_terminal];
+
+    if (term->kbd_tail == term->line_start)
+        return 0;
+    term->kbd_tail--;
+    return 1;
 }
 
 /* keyboard_handler
@@ -118,47 +214,69 @@ extern void keyboard_init() {
 extern void keyboard_handler() {
     char out;
     int i;
-    uint32_t ignore;
+
+    irq_enter();
 
     /* Remap the video memory to print to the visible terminal */
-    remap_vidmem(cur_terminal);
+    echo_to(cur_terminal);
     
     /* Get keyboard input */
     uint8_t scan_key = inb(KEYBOARD_DATA_PORT);
 
     /* Check if modifier is pressed. If so update modifier flag and return */
     if (check_modifiers(scan_key))
-        { remap_vidmem(active_tid); send_eoi(KEYBOARD_IRQ);  return; }
+        { echo_to(-1); irq_eoi(KEYBOARD_IRQ);  return; }
  
     /* Check if invalid scan key (scancodes greater than 0x57 are not processed) */
     if (scan_key > 0x57) // invalid scan_key
-        { remap_vidmem(active_tid); send_eoi(KEYBOARD_IRQ); return; }
+        { echo_to(-1); irq_eoi(KEYBOARD_IRQ); return; }
             
+    /* Shift+PgUp/PgDn (0x49/0x51) page the visible terminal through its scrollback, any other
+     * key brings it back to the live screen */
+    if (shift_pressed && (scan_key == PGUP_SCAN || scan_key == PGDN_SCAN)) {
+        screen_scrollback(cur_terminal, (scan_key == PGUP_SCAN) ? SCROLLBACK_STEP : -SCROLLBACK_STEP);
+        echo_to(-1); irq_eoi(KEYBOARD_IRQ); return;
+    }
+    if (terminals[cur_terminal].view_back != 0)
+        screen_scrollback(cur_terminal, -BACK_ROWS);
+
+    /* Raw mode: the key goes to the reader as typed, unechoed. Ctrl and Alt combinations
+     * (Ctrl+C, terminal switching) still do what they do below */
+    if (terminals[cur_terminal].raw_pid >= 0 && !ctrl_pressed && !alt_pressed) {
+        if (scan_key == ESCAPE_SCAN)
+            raw_push(ASCII_ESC);
+        else if (scan_key == 0x0E)
+            raw_push('\b');
+        else if (scan_key == 0x0F)
+            raw_push('\t');
+        else if (scan_key < sizeof(key_map))
+            raw_push(key_char(scan_key));
+        echo_to(-1); irq_eoi(KEYBOARD_IRQ); return;
+    }
+
     /* Check for tab (0x0F is tab scan code)*/
     if (scan_key == 0x0F) {
         for (i=0; i<TAB_SIZE; i++)
-            { putc(' '); buf_push(' ');  }
-        remap_vidmem(active_tid); send_eoi(KEYBOARD_IRQ); return;
+            if (kbd_push(' '))
+                putc(' ');
+        echo_to(-1); irq_eoi(KEYBOARD_IRQ); return;
     } 
     
     /* Backspace (0x0E is backspace scan code)*/
     if (scan_key == 0x0E) {
-        if (terminals[cur_terminal].buf_ptr==0)
-            { remap_vidmem(active_tid); send_eoi(KEYBOARD_IRQ); return; }
-        
-        buf_pop();
-        putc('\b');
-        remap_vidmem(active_tid); send_eoi(KEYBOARD_IRQ); return;
+        if (kbd_erase())
+            putc('\b');
+        echo_to(-1); irq_eoi(KEYBOARD_IRQ); return;
     }
     
     /* CTRL functions (0x26/0x2E are l/c scan codes) */
     if (ctrl_pressed) {
         if (scan_key == 0x26) // CTRL + L
-            { clear(); remap_vidmem(active_tid); send_eoi(KEYBOARD_IRQ); return; } 
-        else if (scan_key == 0x2E) // CTRL + C
-            { remap_vidmem(active_tid); halt(ignore); send_eoi(KEYBOARD_IRQ); return; }
+            { clear(); echo_to(-1); irq_eoi(KEYBOARD_IRQ); return; } 
+        else if (scan_key == 0x2E) // CTRL + C, INTERRUPT to the visible terminal's program(s)
+            { signal_terminal(cur_terminal, SIG_INTERRUPT); echo_to(-1); irq_eoi(KEYBOARD_IRQ); return; }
         else // do nothing
-            { remap_vidmem(active_tid); send_eoi(KEYBOARD_IRQ); return;}
+            { echo_to(-1); irq_eoi(KEYBOARD_IRQ); return;}
     }
 
     /* ALT Functions (print nothing) */
@@ -170,40 +288,21 @@ extern void keyboard_handler() {
         else if (scan_key == 0x3d)
             terminal_switch(2);
         
-       remap_vidmem(active_tid); send_eoi(KEYBOARD_IRQ); return;
+       echo_to(-1); irq_eoi(KEYBOARD_IRQ); return;
     }    
 
     /* Set key to be printed */    
-    if (is_letter(scan_key)) { // is a letter (both caps and shift affect output)
-        
-        if (shift_pressed && caps_enabled) // shift + caps negate each other
-            out = key_map[scan_key];
-        else if (!shift_pressed && caps_enabled) // caps lock pressed, so print shifted letter
-            out = shifted_key_map[scan_key];
-        else if (shift_pressed && !caps_enabled) // shift pressed, so print shifted letter
-            out = shifted_key_map[scan_key];
-        else if (!shift_pressed && !caps_enabled) // no shift or caps, so print normal letter
-            out = key_map[scan_key];
+    out = key_char(scan_key);
     
-    } else { // not a letter (shift affects output, caps does not)
-        
-        if (shift_pressed)      
-            out = shifted_key_map[scan_key];
-        else if (caps_enabled)
-            out = key_map[scan_key];
-        else 
-            out = key_map[scan_key];            
-    
-    }
-    
-    /* Push character to line buffer and print to screen */
-    buf_push(out); putc(out);
+    /* Queue the character and print it to the screen, Enter wakes a reader polling stdin */
+    if (kbd_push(out))
+        putc(out);
 
     /* Remap the video memory to print to the currently servicing terminal*/
-    remap_vidmem(active_tid);
+    echo_to(-1);
 
     /* End of Interrupt */
-    send_eoi(KEYBOARD_IRQ);
+    irq_eoi(KEYBOARD_IRQ);
 }
 
 /* check_modifiers
@@ -230,10 +329,6 @@ int check_modifiers(uint8_t scan_key) {
             ctrl_pressed = 1; return 1;
         case 0x9D: // lcontrol released
             ctrl_pressed = 0; return 1;
-        case 0x1C: // enter pressed
-            terminals[cur_terminal].enter_pressed = 1; return 0;
-        case 0x9C: // enter released
-            terminals[cur_terminal].enter_pressed = 0; return 0;
         case 0x38: // alt pressed
             alt_pressed = 1; return 1;
         case 0xB8: // alt released
@@ -261,74 +356,55 @@ int is_letter(uint8_t scan_key) {
     }
 }
 
-/* clear_line_buffer
- *   Inputs: none
- *   Return Value: none
- *   Function: clears teh line buffer, sets all characters to null  */
-extern void clear_line_buffer() {
-    int i;
-    /* Set all elements of line buffer to null*/
-    for (i=0; i < MAX_BUFFER_SIZE; i++) {
-        terminals[cur_terminal].keyboard_buffer[i] = '\0';
+/* read_line_buffer
+ *   Inputs: buf - where to copy the line, num_bytes - most to copy, nonblock - fail instead of waiting
+ *   Return Value: number of characters copied (without the '\n'), -1 if no line came before a
+ *                 signal (or at once if nonblock)
+ *   Function: line mode read, takes the oldest line entered on the current process's terminal.
+ *             Lines typed ahead stay queued for later reads; what does not fit in buf is dropped */
+extern int read_line_buffer(char buf[], int num_bytes, int nonblock) {
+    terminal_t* term = &terminals[active_tid];
+    int num_bytes_read = 0;
+    uint32_t head;
+    char c;
+
+    /* Wait for a whole line, give up if a signal has to be delivered */
+    while (term->kbd_head == term->line_start) {
+        if (nonblock || signal_pending())
+            return -1;
     }
-}
 
-/* read_line_buffer
- *   Inputs: terminal buffer, num_bytes (number of bytes to read)
- *   Return Value: return number of bytes read
- *   Function: when enter is pressed, copy line buffer into terminal buffer (the specified number of bytes)  */
-extern int read_line_buffer(char terminal_buffer[], int num_bytes) {
-    int i, num_bytes_read = 0;
-
-    /* Wait for enter keypress */
-    terminals[active_tid].enter_pressed = 0;
-    while (terminals[active_tid].enter_pressed ==0);
-    
-    /* Copy keyboard buffer into passed pointer. Protect read into line buffer */
-    for (i=0; i < num_bytes; i++) {
-        /* Check if reached newline (end of string). If so then clear line buffer and return */
-        if (terminals[cur_terminal].keyboard_buffer[i] == '\n') 
-            { clear_line_buffer(); terminals[cur_terminal].buf_ptr=0; return num_bytes_read; }
-        
-        /* Copy from line buffer to terminal buffer */
-        terminal_buffer[i] = terminals[cur_terminal].keyboard_buffer[i];
-        
-        /* Increment number of bytes read */
-        num_bytes_read++;
+    /* Copy up to the newline, then free the line for the keyboard */
+    head = term->kbd_head;
+    while ((c = term->kbd_buf[head % KBD_BUF_SIZE]) != '\n') {
+        if (num_bytes_read < num_bytes)
+            buf[num_bytes_read++] = c;
+        head++;
     }
+    asm volatile ("" : : : "memory");
+    term->kbd_head = head + 1;
 
-    /* Clear the line buffer */
-    clear_line_buffer();
-    terminals[cur_terminal].buf_ptr=0;
-    
-    /* Return number of bytes read */
     return num_bytes_read;
 }
 
-/* buf_push
- *   Inputs: val (character to push onto buffer)
- *   Return Value: none
- *   Function: pushes a single character onto line buffer and appends newline to end (if there is enough space) */
-void buf_push(char val) {
-    int cur_buf_ptr = terminals[cur_terminal].buf_ptr;
-
-    if (cur_buf_ptr+1 < MAX_BUFFER_SIZE) {
-        terminals[cur_terminal].keyboard_buffer[cur_buf_ptr] = val;
-        terminals[cur_terminal].buf_ptr++;
-        terminals[cur_terminal].keyboard_buffer[ terminals[cur_terminal].buf_ptr ] = '\n';
+/* read_raw_buffer
+ *   Inputs: buf - where to copy keystrokes, num_bytes - most to copy, nonblock - fail instead of waiting
+ *   Return Value: number of keystrokes copied, -1 if none came before a signal (or at once if nonblock)
+ *   Function: raw mode read, returns whatever has been typed as soon as there is anything */
+extern int read_raw_buffer(char buf[], int num_bytes, int nonblock) {
+    terminal_t* term = &terminals[active_tid];
+    int num_bytes_read = 0;
+
+    while (term->raw_head == term->raw_tail) {
+        if (nonblock || signal_pending())
+            return -1;
     }
-}
 
-/* buf_pop
- *   Inputs: none
- *   Return Value: none
- *   Function: removes single character from line buffer (if able to), keeps the newline at the end of buffer */
-void buf_pop() {
-    int cur_buf_ptr = terminals[cur_terminal].buf_ptr;
-    if (cur_buf_ptr-1 > -1) {
-        terminals[cur_terminal].keyboard_buffer[cur_buf_ptr]='\n'; 
-        terminals[cur_terminal].buf_ptr--;
+    while (num_bytes_read < num_bytes && term->raw_head != term->raw_tail) {
+        buf[num_bytes_read++] = term->raw_buf[term->raw_head % RAW_BUF_SIZE];
+        term->raw_head++;
     }
+    return num_bytes_read;
 }
 
 /*
@@ -339,15 +415,39 @@ void buf_pop() {
 */
 extern void set_cursor(int x, int y)
 {
-	uint16_t pos = y * TERM_WIDTH + x;
+	uint32_t flags;
+	uint16_t pos;
  
+	spin_lock_irqsave(&vga_lock, flags);
+	pos = screen_start + y * TERM_WIDTH + x;	// relative to the displayed screen
 	outb(0x0F, 0x3D4);
 	outb((uint8_t) (pos & 0xFF),0x3D5);
 	outb(0x0E,0x3D4);
 	outb((uint8_t) ((pos >> 8) & 0xFF), 0x3D5);
+	spin_unlock_irqrestore(&vga_lock, flags);
 }
 
 
+/*
+*   Function: set_screen_start
+*   Desc: sets the CRTC start address, the cell of video memory shown at the top left of the
+*         screen. Moving it by a row scrolls the display without copying anything
+*   Input: offset - cells from 0xB8000
+*   Output: None
+*/
+extern void set_screen_start(int offset)
+{
+	uint32_t flags;
+
+	spin_lock_irqsave(&vga_lock, flags);
+	screen_start = offset;
+	outb(0x0C, 0x3D4);
+	outb((uint8_t) ((offset >> 8) & 0xFF), 0x3D5);
+	outb(0x0D, 0x3D4);
+	outb((uint8_t) (offset & 0xFF), 0x3D5);
+	spin_unlock_irqrestore(&vga_lock, flags);
+}
+
 /*
 *   Function: enable_cursor
 *   Desc: Enabling the cursor also allows you to set the start and end scanlines, 
@@ -17,13 +17,12 @@ extern void keyboard_init();
 extern void keyboard_handler();
 int check_modifiers(uint8_t scan_key);
 int is_letter(uint8_t scan_key);
-extern int read_line_buffer(char terminal_buffer[], int num_bytes);
-extern void clear_line_buffer();
+extern int read_line_buffer(char buf[], int num_bytes, int nonblock);
+extern int read_raw_buffer(char buf[], int num_bytes, int nonblock);
 extern void set_cursor(int x, int y);
+extern void set_screen_start(int offset);
 extern void enable_cursor(uint8_t cursor_start, uint8_t cursor_end);
 extern void disable_cursor();
-void buf_push(char val);
-void buf_pop();
 
 
 #endif
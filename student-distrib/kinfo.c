@@ -0,0 +1,55 @@
+/* kinfo.c - the read-only kernel info page mapped into every process */
+
+#include "kinfo.h"
+#include "lib.h"
+#include "x86_desc.h"
+#include "pit.h"
+#include "rtc.h"
+#include "smp.h"
+#include "scheduler.h"
+#include "systemcall.h"
+
+/* one page per cpu, mapped at KINFO_ADDR by that cpu's video page table */
+uint8_t kinfo_pages[MAX_CPUS][4096] __attribute__((aligned(4096)));
+
+/* wall clock time at pit tick 0 */
+static uint32_t boot_time = 0;
+
+/* kinfo_init
+ *   Inputs: none
+ *   Return Value: none
+ *   Function: reads the wall clock from the RTC once and fills in the fields that never change */
+void kinfo_init() {
+    uint32_t cpu;
+    kinfo_t* info;
+
+    boot_time = rtc_read_time() - pit_ticks / PIT_FREQ;
+    for (cpu = 0; cpu < MAX_CPUS; cpu++) {
+        info = (kinfo_t*)kinfo_pages[cpu];
+        info->pid = -1;
+        info->terminal = -1;
+        info->cpu = cpu;
+        info->hz = PIT_FREQ;
+        info->features = has_sep ? KINFO_SYSENTER : 0;
+    }
+    kinfo_update();
+}
+
+/* kinfo_update
+ *   Inputs: none
+ *   Return Value: none
+ *   Function: Refreshes this cpu's page. Called on every tick and whenever the cpu starts running
+ *             a different process, with interrupts off. */
+void kinfo_update() {
+    kinfo_t* info = (kinfo_t*)kinfo_pages[smp_cpu_id()];
+    uint32_t ticks = pit_ticks;
+
+    info->seq++;
+    asm volatile ("" : : : "memory");
+    info->pid = active_pid;
+    info->terminal = active_tid;
+    info->ticks = ticks;
+    info->time = boot_time + ticks / PIT_FREQ;
+    asm volatile ("" : : : "memory");
+    info->seq++;
+}
@@ -0,0 +1,33 @@
+#ifndef _KINFO_H
+#define _KINFO_H
+
+#include "types.h"
+
+/* user address of the kernel info page: the page after the vidmap page, read-only for users */
+#define KINFO_ADDR 0x08401000
+#define KINFO_PTE (KINFO_ADDR >> 12 & 0x3FF)    // entry in video_page_table
+
+/* Kernel info shared with every process. Each cpu has its own page describing the process it is
+ * running, so user programs read their pid, terminal, the tick count and the time with a plain
+ * load instead of a system call. seq is odd while the kernel is writing; a reader wanting more
+ * than one field retries until it sees the same even seq before and after. */
+typedef struct kinfo_t{
+    volatile uint32_t seq;
+    int32_t pid;
+    int32_t terminal;
+    uint32_t cpu;
+    uint32_t ticks;                 // PIT ticks since boot
+    uint32_t hz;                    // ticks per second
+    uint32_t time;                  // seconds since 1970-01-01 00:00 UTC
+    uint32_t features;              // KINFO_*, what the user library may use
+}kinfo_t;
+
+/* features: SYSENTER is set up, without it system calls must use int $0x80 */
+#define KINFO_SYSENTER 0x1
+
+extern uint8_t kinfo_pages[][4096];
+
+extern void kinfo_init();
+extern void kinfo_update();
+
+#endif
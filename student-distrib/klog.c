@@ -0,0 +1,165 @@
+/* klog.c - the kernel log.
+ *
+ * Kernel messages (printk, and printf, which logs at KLOG_INFO) go into a ring of the last
+ * KLOG_ENTRIES records, each with its level and the pit tick it was logged at. Only those at
+ * klog_console_level or more severe are also printed, so diagnostics no longer land in whatever
+ * a program has on screen, and logging one is a short copy under klog_lock rather than a trip
+ * through the console. The dmesg system call reads the ring back as text, and with klog_serial
+ * set every record is also sent to the serial port as it is logged. */
+
+#include "klog.h"
+#include "lib.h"
+#include "pit.h"
+#include "spinlock.h"
+#include "serial.h"
+
+typedef struct klog_rec_t{
+    uint32_t ticks;
+    uint8_t level;
+    uint8_t len;
+    int8_t text[KLOG_LINE];
+}klog_rec_t;
+
+static klog_rec_t klog[KLOG_ENTRIES];
+
+/* records logged so far, record n is klog[n % KLOG_ENTRIES] while n > klog_next - KLOG_ENTRIES */
+static uint32_t klog_next = 0;
+
+static spinlock_t klog_lock = SPINLOCK_INIT;
+
+int32_t klog_console_level = KLOG_CONSOLE_DEFAULT;
+int32_t klog_serial = KLOG_SERIAL_DEFAULT;
+
+static int32_t klog_format(const klog_rec_t* rec, int8_t* out);
+
+/* klog_add
+ *   Inputs: level - message level, text - the message, len - its length (at most KLOG_LINE)
+ *   Return Value: none
+ *   Function: appends a record, overwriting the oldest once the ring is full, and copies it to
+ *             the serial port if klog_serial is set */
+static void klog_add(int32_t level, const int8_t* text, uint32_t len){
+    klog_rec_t rec;
+    int8_t line[KLOG_FMT_MAX];
+    uint32_t flags;
+
+    rec.level = level;
+    rec.len = len;
+    memcpy(rec.text, text, len);
+
+    spin_lock_irqsave(&klog_lock, flags);
+    rec.ticks = pit_ticks;
+    klog[klog_next % KLOG_ENTRIES] = rec;
+    klog_next++;
+    spin_unlock_irqrestore(&klog_lock, flags);
+
+    if (klog_serial)
+        serial_log(line, klog_format(&rec, line));
+}
+
+/* klog_piece
+ *   Inputs: piece - up to KLOG_LINE characters of a message, len - how many, level - its level
+ *   Return Value: none
+ *   Function: Prints one piece of a message to the console if its level is shown there and logs
+ *             it as a record. A trailing newline is not stored, each record is a line of its own */
+static void klog_piece(int8_t* piece, int32_t len, void* level){
+    if ((int32_t)level <= klog_console_level)
+        puts(piece);
+
+    if (len > 0 && piece[len - 1] == '\n')
+        len--;
+    if (len > 0)
+        klog_add((int32_t)level, piece, len);
+}
+
+/* vprintk
+ *   Inputs: level - message level, format - printf format, args - its arguments on the stack
+ *   Return Value: number of characters in the message
+ *   Function: formats a message into the log, and onto the console if its level is shown there.
+ *             The console gets all of it; a message longer than KLOG_LINE is logged as several
+ *             records in a row */
+int32_t vprintk(int32_t level, int8_t* format, int32_t* args){
+    int8_t line[KLOG_LINE + 1];
+    int32_t len;
+
+    len = vformat_split(line, sizeof(line), format, args, klog_piece, (void*)level);
+    klog_piece(line, strlen(line), (void*)level);
+    return len;
+}
+
+/* printk
+ *   Inputs: level - KLOG_ERR..KLOG_DEBUG, format - printf format, ... - its arguments
+ *   Return Value: number of characters in the message
+ *   Function: logs a kernel message */
+int32_t printk(int32_t level, int8_t* format, ...){
+    return vprintk(level, format, (int32_t*)&format + 1);
+}
+
+/* klog_format
+ *   Inputs: rec - record to print, out - room for KLOG_FMT_MAX characters
+ *   Return Value: characters written
+ *   Function: one line of dmesg output, "<level>[seconds.hundredths] message\n" */
+static int32_t klog_format(const klog_rec_t* rec, int8_t* out){
+    int8_t num[12];
+    int32_t n = 0, len;
+
+    out[n++] = '<';
+    out[n++] = '0' + rec->level;
+    out[n++] = '>';
+    out[n++] = '[';
+    itoa(rec->ticks / PIT_FREQ, num, 10);
+    for (len = strlen(num); len < 5; len++)
+        out[n++] = ' ';
+    strcpy(&out[n], num);
+    n += strlen(num);
+    out[n++] = '.';
+    itoa(rec->ticks % PIT_FREQ, num, 10);
+    if (rec->ticks % PIT_FREQ < 10)
+        out[n++] = '0';
+    strcpy(&out[n], num);
+    n += strlen(num);
+    out[n++] = ']';
+    out[n++] = ' ';
+    memcpy(&out[n], rec->text, rec->len);
+    n += rec->len;
+    out[n++] = '\n';
+    return n;
+}
+
+/* dmesg
+ *   Inputs: seq - in: first record wanted (0 for the oldest kept), out: the record to ask for next
+ *           buf - where to put the text, nbytes - room in buf (a line is at most KLOG_FMT_MAX)
+ *   Return Value: bytes copied, whole lines only, 0 once there is nothing newer; -1 on bad arguments
+ *   Function: dmesg system call. Records already overwritten are skipped, so calling it again with
+ *             the returned seq never repeats a line and follows new ones as they are logged */
+int32_t dmesg(uint32_t* seq, uint8_t* buf, int32_t nbytes){
+    klog_rec_t rec;
+    int8_t line[KLOG_FMT_MAX];
+    uint32_t next, flags;
+    int32_t copied = 0, n;
+
+    if (nbytes < 0 || bad_userspace_addr(seq, sizeof(uint32_t)) || bad_userspace_addr(buf, nbytes))
+        return -1;
+
+    next = *seq;
+    while (1) {
+        /* copy the record out so the user buffer is not touched under the lock */
+        spin_lock_irqsave(&klog_lock, flags);
+        if (klog_next - next > KLOG_ENTRIES)
+            next = (klog_next > KLOG_ENTRIES) ? klog_next - KLOG_ENTRIES : 0;
+        if (klog_next == next) {
+            spin_unlock_irqrestore(&klog_lock, flags);
+            break;
+        }
+        rec = klog[next % KLOG_ENTRIES];
+        spin_unlock_irqrestore(&klog_lock, flags);
+
+        n = klog_format(&rec, line);
+        if (copied + n > nbytes)
+            break;
+        memcpy(buf + copied, line, n);
+        copied += n;
+        next++;
+    }
+    *seq = next;
+    return copied;
+}
@@ -0,0 +1,30 @@
+#ifndef _KLOG_H
+#define _KLOG_H
+
+#include "types.h"
+
+/* message levels, lower is more severe */
+#define KLOG_ERR    3
+#define KLOG_WARN   4
+#define KLOG_INFO   6
+#define KLOG_DEBUG  7
+
+/* records kept (a power of two) and the longest record, longer messages take several */
+#define KLOG_ENTRIES 256
+#define KLOG_LINE    120
+/* longest line dmesg returns, "<l>[" + seconds + ".hh] " + message + '\n' */
+#define KLOG_FMT_MAX (KLOG_LINE + 20)
+
+/* messages at this level or more severe are also printed to the console */
+#define KLOG_CONSOLE_DEFAULT KLOG_ERR
+/* 1 to copy every record to the serial port as it is logged, in dmesg format */
+#define KLOG_SERIAL_DEFAULT 1
+
+extern int32_t klog_console_level;
+extern int32_t klog_serial;
+
+extern int32_t printk(int32_t level, int8_t* format, ...);
+extern int32_t vprintk(int32_t level, int8_t* format, int32_t* args);
+extern int32_t dmesg(uint32_t* seq, uint8_t* buf, int32_t nbytes);
+
+#endif
@@ -2,42 +2,240 @@
  * vim:ts=4 noexpandtab */
 
 #include "lib.h"
+#include "klog.h"
 #include "terminal.h"
+#include "x86_desc.h"
+#include "smp.h"
 
 
 #define VIDEO       0xB8000
 #define NUM_COLS    80
 #define NUM_ROWS    25
 #define ATTRIB      0x7
+#define USER_PAGE_START 0x08000000      // 128MB, user program page
+#define USER_PAGE_END   0x08400000      // 132MB
 
 
 
-static int *screen_x;
-static int *screen_y;
+/* cursor of the terminal this cpu is printing to (see render_tid) */
+#define screen_x (&terminals[render_tid()].cursor_x)
+#define screen_y (&terminals[render_tid()].cursor_y)
 
+#define SCREEN_CELLS (NUM_COLS * NUM_ROWS)
+#define BLANK       ((ATTRIB << 8) | ' ')
+/* each terminal's screen scrolls through its region of VGA memory (TERMINAL_VIDMEM_PTR) by
+ * moving screen_top instead of copying */
+#define SCROLL_CELLS (TERM_REGION_SIZE / 2)
+#define BACK_MASK   (BACK_ROWS - 1)
 
+int scroll_y_count = 0;
 
+/* set by the first console_present: until the timer presents, output is presented as it is
+ * printed so boot messages show up */
+static int present_ticking = 0;
 
-static char* video_mem = (char *)VIDEO;
-int scroll_y_count = 0;
+/* render_tid
+ *   Inputs: none
+ *   Return Value: terminal this cpu prints to
+ *   Function: the terminal output is redirected to (see echo_to), else the running process's,
+ *             terminal 0 before any is running */
+static int32_t render_tid(){
+    cpu_t* cpu = this_cpu();
+    int32_t tid = (cpu->echo_tid >= 0) ? cpu->echo_tid : cpu->tid;
+
+    return tid < 0 ? 0 : tid;
+}
+
+/* back_row
+ *   Inputs: term - terminal, y - screen row
+ *   Return Value: the back buffer row shown on screen row y */
+static uint16_t* back_row(terminal_t* term, int y){
+    return term->back[(term->top_line + y) & BACK_MASK];
+}
+
+/* show_cursor
+ *   Inputs: term - the terminal being viewed
+ *   Return Value: none
+ *   Function: sets the cursor, below the bottom of the screen (hidden) if the display is
+ *             scrolled back past it */
+static void show_cursor(terminal_t* term){
+    if (term->cursor_y + term->view_back < NUM_ROWS)
+        set_cursor(term->cursor_x, term->cursor_y + term->view_back);
+    else
+        set_cursor(0, NUM_ROWS);
+}
+
+/* mark_line
+ *   Inputs: term - terminal, line - line number, lo/hi - first and one past the last column changed
+ *   Return Value: none
+ *   Function: widens the line's span of cells still to be copied to VGA memory */
+static void mark_line(terminal_t* term, uint32_t line, int lo, int hi){
+    uint32_t r = line & BACK_MASK;
+
+    if (term->dirty_hi[r] == 0) {
+        term->dirty_lo[r] = lo;
+        term->dirty_hi[r] = hi;
+    } else {
+        if (lo < term->dirty_lo[r])
+            term->dirty_lo[r] = lo;
+        if (hi > term->dirty_hi[r])
+            term->dirty_hi[r] = hi;
+    }
+}
+
+/* mark_dirty
+ *   Inputs: term - terminal, y - screen row, lo/hi - first and one past the last column changed
+ *   Return Value: none
+ *   Function: mark_line for a row of the live screen */
+static void mark_dirty(terminal_t* term, int y, int lo, int hi){
+    mark_line(term, term->top_line + y, lo, hi);
+}
+
+/* present
+ *   Inputs: tid - terminal
+ *   Return Value: none
+ *   Function: brings the terminal's VGA region up to date with the part of its back buffer on
+ *             display. If that moved by less than a screen since the last present, VGA memory
+ *             is scrolled by moving screen_top (and the start address, if the terminal is
+ *             viewed) and only the rows it exposes are copied; only when that runs out of
+ *             room, or a whole screen went by, is every row copied. Then the dirty span of
+ *             each displayed row is copied. Caller holds console_lock */
+static void present(int32_t tid){
+    terminal_t* term = &terminals[tid];
+    uint16_t* vga = (uint16_t*)TERMINAL_VIDMEM_PTR[tid];
+    uint32_t shown = term->top_line - term->view_back;
+    int32_t moved = shown - term->vga_line;
+    uint32_t r;
+    int y, lo, first = 0, last = 0;
+
+    if (moved > 0 && moved < NUM_ROWS && term->screen_top + moved * NUM_COLS + SCREEN_CELLS <= SCROLL_CELLS) {
+        term->screen_top += moved * NUM_COLS;
+        first = NUM_ROWS - moved;
+        last = NUM_ROWS;
+    } else if (moved < 0 && -moved < NUM_ROWS && term->screen_top >= -moved * NUM_COLS) {
+        term->screen_top += moved * NUM_COLS;
+        last = -moved;
+    } else if (moved != 0) {
+        term->screen_top = 0;
+        last = NUM_ROWS;
+    }
+    if (moved != 0) {
+        for (y = first; y < last; y++)
+            mark_line(term, shown + y, 0, NUM_COLS);
+        term->vga_line = shown;
+        if (tid == cur_terminal)
+            set_screen_start((TERMINAL_VIDMEM_PTR[tid] - VIDEO) / 2 + term->screen_top);
+    }
+
+    for (y = 0; y < NUM_ROWS; y++) {
+        r = (shown + y) & BACK_MASK;
+        if (term->dirty_hi[r] == 0)
+            continue;
+        lo = term->dirty_lo[r];
+        memcpy(vga + term->screen_top + y * NUM_COLS + lo, &term->back[r][lo], (term->dirty_hi[r] - lo) * 2);
+        term->dirty_hi[r] = 0;
+    }
+
+    if (tid == cur_terminal)
+        show_cursor(term);
+}
+
+/* console_present
+ *   Inputs: none
+ *   Return Value: none
+ *   Function: called from the timer every PRESENT_TICKS. Presents what every terminal printed
+ *             since the last call, so output costs VGA writes at most once per frame however
+ *             often it changes. Background terminals too, so a switch has nothing to copy */
+void console_present(){
+    uint32_t flags;
+    int32_t tid;
+
+    spin_lock_irqsave(&console_lock, flags);
+    present_ticking = 1;
+    for (tid = 0; tid < NUM_TERMINALS; tid++)
+        present(tid);
+    spin_unlock_irqrestore(&console_lock, flags);
+}
+
+/* screen_show
+ *   Inputs: tid - terminal that has just become the one viewed
+ *   Return Value: none
+ *   Function: presents it and points the start address and the cursor at its region. Caller
+ *             holds console_lock */
+void screen_show(int32_t tid){
+    present(tid);
+    set_screen_start((TERMINAL_VIDMEM_PTR[tid] - VIDEO) / 2 + terminals[tid].screen_top);
+    show_cursor(&terminals[tid]);
+}
+
+/* screen_scrollback
+ *   Inputs: tid - terminal, rows - how far to move the display back through the scrollback,
+ *           negative to move it forward
+ *   Return Value: none
+ *   Function: moves the display, no further back than the oldest line in the ring nor forward
+ *             past the live screen, and presents it at once */
+void screen_scrollback(int32_t tid, int32_t rows){
+    terminal_t* term = &terminals[tid];
+    int32_t back, oldest;
+    uint32_t flags;
+
+    spin_lock_irqsave(&console_lock, flags);
+    oldest = (term->top_line < BACK_ROWS - NUM_ROWS) ? term->top_line : BACK_ROWS - NUM_ROWS;
+    back = (int32_t)term->view_back + rows;
+    if (back < 0)
+        back = 0;
+    if (back > oldest)
+        back = oldest;
+    term->view_back = back;
+    present(tid);
+    spin_unlock_irqrestore(&console_lock, flags);
+}
 
 /* void clear(void);
  * Inputs: void
  * Return Value: none
  * Function: Clears video memory */
 void clear(void) {
-    int32_t i;
-    for (i = 0; i < NUM_ROWS * NUM_COLS; i++) {
-        *(uint8_t *)(video_mem + (i << 1)) = ' ';
-        *(uint8_t *)(video_mem + (i << 1) + 1) = ATTRIB;
+    terminal_t* term = &terminals[render_tid()];
+    int y;
+
+    for (y = 0; y < NUM_ROWS; y++) {
+        memset_word(back_row(term, y), BLANK, NUM_COLS);
+        mark_dirty(term, y, 0, NUM_COLS);
     }
     scroll_y_count=0;
     *screen_x=0;
     *screen_y=0;
-    set_cursor(*screen_x, *screen_y);
+    if (!present_ticking)
+        present(render_tid());
 
 }
 
+/* screen_home
+ *   Inputs: none
+ *   Return Value: none
+ *   Function: if the screen of this cpu's terminal has scrolled on from the start of its region,
+ *             moves it back there (and out of the scrollback), so a vidmap of the region's first
+ *             page is what is displayed */
+void screen_home(){
+    terminal_t* term = &terminals[render_tid()];
+    uint32_t flags;
+    int y;
+
+    spin_lock_irqsave(&console_lock, flags);
+    if (term->screen_top != 0 || term->view_back != 0) {
+        term->screen_top = 0;
+        term->view_back = 0;
+        term->vga_line = term->top_line;
+        for (y = 0; y < NUM_ROWS; y++)
+            mark_dirty(term, y, 0, NUM_COLS);
+        screen_show(render_tid());
+        if (render_tid() != cur_terminal)
+            screen_show(cur_terminal);
+    }
+    spin_unlock_irqrestore(&console_lock, flags);
+}
+
 /* update_screen_coords;
  * Inputs: new_screen_x, new_screen_y. 
  * Return Value: none
@@ -48,12 +246,6 @@ void update_screen_coords(int new_screen_x, int new_screen_y){
     *screen_y = new_screen_y; 
 }
 
-void update_screen_ptr(int *new_screen_x, int *new_screen_y){
-
-    screen_x = new_screen_x;
-    screen_y = new_screen_y; 
-}
-
 int get_screen_x(){
     return *screen_x;
 }
@@ -62,7 +254,8 @@ int get_screen_y(){
     return *screen_y; 
 }
 
-/* Standard printf().
+/* Standard printf(), except that it goes to the kernel log (see klog.c) at KLOG_INFO and so only
+ * reaches the console when that level is shown there. Use printk to pick the level.
  * Only supports the following format strings:
  * %%  - print a literal '%' character
  * %x  - print a number in hexadecimal
@@ -80,13 +273,78 @@ int get_screen_y(){
  *       Also note: %x is the only conversion specifier that can use
  *       the "#" modifier to alter output. */
 int32_t printf(int8_t *format, ...) {
+    return vprintk(KLOG_INFO, format, (int32_t*)&format + 1);
+}
+
+/* fmt_out_t - where vformat is writing: out[len] is next, out has size bytes (one for the '\0').
+ * With a flush function a full out is handed to it and refilled, instead of cutting off */
+typedef struct fmt_out_t {
+    int8_t* out;
+    int32_t size;
+    int32_t len;
+    int32_t total;
+    fmt_flush_t flush;
+    void* arg;
+} fmt_out_t;
+
+/* fmt_putc
+ *   Inputs: f - output, c - character to append
+ *   Return Value: none
+ *   Function: appends c if it fits, flushing a full buffer first if there is a flush function */
+static void fmt_putc(fmt_out_t* f, int8_t c) {
+    if (f->len == f->size - 1 && f->flush != NULL) {
+        f->out[f->len] = '\0';
+        f->flush(f->out, f->len, f->arg);
+        f->len = 0;
+    }
+    if (f->len < f->size - 1) {
+        f->out[f->len++] = c;
+        f->total++;
+    }
+}
+
+/* fmt_puts
+ *   Inputs: f - output, s - string to append
+ *   Return Value: none
+ *   Function: appends as much of s as fits */
+static void fmt_puts(fmt_out_t* f, const int8_t* s) {
+    while (*s != '\0')
+        fmt_putc(f, *s++);
+}
+
+/* vformat
+ *   Inputs: out - where to write, size - its size, format - printf format (see printf),
+ *           args - the arguments, where printf's "..." starts on the stack
+ *   Return Value: characters written, not counting the '\0'
+ *   Function: printf into a buffer. What does not fit is cut off, out always ends in '\0' */
+int32_t vformat(int8_t* out, int32_t size, int8_t* format, int32_t* args) {
+    return vformat_split(out, size, format, args, NULL, NULL);
+}
+
+/* vformat_split
+ *   Inputs: out, size, format, args - as for vformat
+ *           flush - called with out (and arg) every time out fills up, NULL to cut off instead
+ *   Return Value: characters formatted in all, not counting the '\0'
+ *   Function: printf of any length through a buffer of size bytes. Each full buffer goes to
+ *             flush and is reused; the last piece is left in out, ending in '\0', for the caller */
+int32_t vformat_split(int8_t* out, int32_t size, int8_t* format, int32_t* args,
+        fmt_flush_t flush, void* arg) {
+    fmt_out_t f;
 
     /* Pointer to the format string */
     int8_t* buf = format;
 
     /* Stack pointer for the other parameters */
-    int32_t* esp = (void *)&format;
-    esp++;
+    int32_t* esp = args;
+
+    f.out = out;
+    f.size = size;
+    f.len = 0;
+    f.total = 0;
+    f.flush = flush;
+    f.arg = arg;
+    if (size <= 0)
+        return 0;
 
     while (*buf != '\0') {
         switch (*buf) {
@@ -100,7 +358,7 @@ format_char_switch:
                     switch (*buf) {
                         /* Print a literal '%' character */
                         case '%':
-                            putc('%');
+                            fmt_putc(&f, '%');
                             break;
 
                         /* Use alternate formatting */
@@ -118,7 +376,7 @@ format_char_switch:
                                 int8_t conv_buf[64];
                                 if (alternate == 0) {
                                     itoa(*((uint32_t *)esp), conv_buf, 16);
-                                    puts(conv_buf);
+                                    fmt_puts(&f, conv_buf);
                                 } else {
                                     int32_t starting_index;
                                     int32_t i;
@@ -128,7 +386,7 @@ format_char_switch:
                                         conv_buf[i] = '0';
                                         i++;
                                     }
-                                    puts(&conv_buf[starting_index]);
+                                    fmt_puts(&f, &conv_buf[starting_index]);
                                 }
                                 esp++;
                             }
@@ -139,7 +397,7 @@ format_char_switch:
                             {
                                 int8_t conv_buf[36];
                                 itoa(*((uint32_t *)esp), conv_buf, 10);
-                                puts(conv_buf);
+                                fmt_puts(&f, conv_buf);
                                 esp++;
                             }
                             break;
@@ -155,20 +413,20 @@ format_char_switch:
                                 } else {
                                     itoa(value, conv_buf, 10);
                                 }
-                                puts(conv_buf);
+                                fmt_puts(&f, conv_buf);
                                 esp++;
                             }
                             break;
 
                         /* Print a single character */
                         case 'c':
-                            putc((uint8_t) *((int32_t *)esp));
+                            fmt_putc(&f, (uint8_t) *((int32_t *)esp));
                             esp++;
                             break;
 
                         /* Print a NULL-terminated string */
                         case 's':
-                            puts(*((int8_t **)esp));
+                            fmt_puts(&f, *((int8_t **)esp));
                             esp++;
                             break;
 
@@ -180,12 +438,13 @@ format_char_switch:
                 break;
 
             default:
-                putc(*buf);
+                fmt_putc(&f, *buf);
                 break;
         }
         buf++;
     }
-    return (buf - format);
+    out[f.len] = '\0';
+    return f.total;
 }
 
 /* int32_t puts(int8_t* s);
@@ -193,12 +452,7 @@ format_char_switch:
  *   Return Value: Number of bytes written
  *    Function: Output a string to the console */
 int32_t puts(int8_t* s) {
-    register int32_t index = 0;
-    while (s[index] != '\0') {
-        putc(s[index]);
-        index++;
-    }
-    return index;
+    return putbuf((uint8_t*)s, strlen(s));
 }
 
 /* int32_t putc(int8_t* s);
@@ -208,68 +462,84 @@ int32_t puts(int8_t* s) {
 int newline_flag = 0;
 
 void putc(uint8_t c) {
-    if(c == '\n' || c == '\r') {
-        (*screen_y)++;
-        *screen_x = 0;
-        newline_flag = 1;
-    } else if (c == '\b') { // backspace
-        if (*screen_x > 0) {
+    putbuf(&c, 1);
+}
+
+/* putbuf
+ *   Inputs: buf - characters to print, n - how many
+ *   Return Value: number of characters printed ('\0' is skipped)
+ *   Function: prints a whole buffer to the console like n putc calls, but takes console_lock
+ *             once. Cells go to the terminal's back buffer in RAM and are marked dirty; the
+ *             timer presents them, or this call does if the terminal is in O_SYNC mode */
+int32_t putbuf(const uint8_t* buf, int32_t n) {
+    int32_t tid = render_tid();
+    terminal_t* term = &terminals[tid];
+    uint32_t flags;
+    int32_t i, printed = 0;
+    uint8_t c;
+
+    /* other cpus print to other terminals (or echo keys to this one), serialize on the console */
+    spin_lock_irqsave(&console_lock, flags);
+
+    for (i = 0; i < n; i++) {
+        c = buf[i];
+        if (c == '\0')
+            continue;
+        printed++;
+
+        if (c == '\n' || c == '\r') {
+            (*screen_y)++;
+            *screen_x = 0;
+            newline_flag = 1;
+        } else if (c == '\b') {
+            if (*screen_x == 0) {
+                if (scroll_y_count == 0)
+                    continue;
+                scroll_y_count--;
+                *screen_x = NUM_COLS;
+                (*screen_y)--;
+            }
             (*screen_x)--;
-            *(uint8_t *)(video_mem + ((NUM_COLS * (*screen_y) + (*screen_x)) << 1)) = ' ';
-            *(uint8_t *)(video_mem + ((NUM_COLS * (*screen_y) + (*screen_x)) << 1) + 1) = ATTRIB;
-        } else if (*screen_x==0 && scroll_y_count>0) {
-            scroll_y_count--;
-            *screen_x = NUM_COLS-1;
-            (*screen_y)--;
-            *(uint8_t *)(video_mem + ((NUM_COLS * (*screen_y) + (*screen_x)) << 1)) = ' ';
-            *(uint8_t *)(video_mem + ((NUM_COLS * (*screen_y) + (*screen_x)) << 1) + 1) = ATTRIB;
+            back_row(term, *screen_y)[*screen_x] = BLANK;
+            mark_dirty(term, *screen_y, *screen_x, *screen_x + 1);
+        } else {
+            back_row(term, *screen_y)[*screen_x] = (ATTRIB << 8) | c;
+            mark_dirty(term, *screen_y, *screen_x, *screen_x + 1);
+            if (++(*screen_x) == NUM_COLS)
+                { *screen_x = 0; (*screen_y)++; scroll_y_count++; }
         }
-    } else { // Write a character
-        *(uint8_t *)(video_mem + ((NUM_COLS * (*screen_y) + (*screen_x)) << 1)) = c;
-        *(uint8_t *)(video_mem + ((NUM_COLS * (*screen_y) + (*screen_x)) << 1) + 1) = ATTRIB;
-        (*screen_x)++;
-        if (*screen_x == NUM_COLS) // if reach end of line, go to next line
-            { *screen_x = 0; (*screen_y)++; scroll_y_count++; }
-        
-        if (*screen_y == NUM_ROWS) // if reach end of screen, scroll
-            scroll();
-    }
 
-    /* scrolling */
-    if(*screen_y >= NUM_ROWS){
-        scroll();
+        if (*screen_y >= NUM_ROWS)
+            scroll();
     }
 
-    /* update cursor */
-    set_cursor(*screen_x, *screen_y);
-
-} 
-
-
+    if (term->sync_pid >= 0 || !present_ticking)
+        present(tid);
+    spin_unlock_irqrestore(&console_lock, flags);
+    return printed;
+}
 
 /*
 *   Func: scroll
-*   Desc: Adds scrolling support to terminal. Shifts video memory and adds new line at 
-*         bottom when writing a new line, in the case that the screen is already full
+*   Desc: Adds scrolling support to terminal. Moves every row up one and blanks the bottom
+*         line, in the case that the screen is already full. The back buffer is a ring of rows,
+*         so this only moves its top on a row, and the row scrolled off stays in the ring as
+*         scrollback; present scrolls VGA memory to match
 *   Input:
 *   Output:
 */
 extern void scroll(void) {
-    int i, j, k;
+    terminal_t* term = &terminals[render_tid()];
 
-    /* scrolls up video screen aside from the bottom line */
-    for (i = 1; i < NUM_ROWS; i++) {
-        for (j = 0; j < NUM_COLS; j++) {
-            *(uint8_t *)(video_mem + ((NUM_COLS * (i-1) + j) << 1)) = *(uint8_t *)(video_mem + ((NUM_COLS * i + j) << 1));
-            *(uint8_t *)(video_mem + ((NUM_COLS * (i-1) + j) << 1) + 1) = ATTRIB;
-        }
-    }
+    term->top_line++;
 
-    /* clears the bottom line */
-    for (k = 0; k < NUM_COLS; k++) {
-        *(uint8_t *)(video_mem + ((NUM_COLS * (NUM_ROWS - 1) + k) << 1)) = ' ';
-        *(uint8_t *)(video_mem + ((NUM_COLS * (NUM_ROWS - 1) + k) << 1) + 1) = ATTRIB;
-    }
+    /* a display scrolled back stays on the same lines, until they are the oldest in the ring */
+    if (term->view_back > 0 && term->view_back < BACK_ROWS - NUM_ROWS)
+        term->view_back++;
+
+    /* clears the bottom line; the row it reuses held the oldest line of the scrollback */
+    memset_word(back_row(term, NUM_ROWS - 1), BLANK, NUM_COLS);
+    mark_dirty(term, NUM_ROWS - 1, 0, NUM_COLS);
 
     /* set position to bottom row */
     *screen_y = NUM_ROWS - 1; 
@@ -563,13 +833,33 @@ int8_t* strncpy(int8_t* dest, const int8_t* src, uint32_t n) {
     return dest;
 }
 
+/* int32_t bad_userspace_addr(const void* addr, int32_t len)
+ * Inputs: const void* addr = start of a buffer passed in by a user program
+ *              int32_t len = length of the buffer in bytes
+ * Return Value: 1 if any part of the buffer is outside the user program page, 0 otherwise
+ * Function: validates user pointers before the kernel reads or writes through them */
+int32_t bad_userspace_addr(const void* addr, int32_t len) {
+    uint32_t start = (uint32_t)addr;
+
+    if (len < 0)
+        return 1;
+    if (start < USER_PAGE_START || start >= USER_PAGE_END)
+        return 1;
+    if ((uint32_t)len > USER_PAGE_END - start)
+        return 1;
+    return 0;
+}
+
 /* void test_interrupts(void)
  * Inputs: void
  * Return Value: void
  * Function: increments video memory. To be used to test rtc */
 void test_interrupts(void) {
-    int32_t i;
-    for (i = 0; i < NUM_ROWS * NUM_COLS; i++) {
-        video_mem[i << 1]++;
+    terminal_t* term = &terminals[render_tid()];
+    int32_t y, x;
+    for (y = 0; y < NUM_ROWS; y++) {
+        for (x = 0; x < NUM_COLS; x++)
+            ((uint8_t*)&back_row(term, y)[x])[0]++;
+        mark_dirty(term, y, 0, NUM_COLS);
     }
 }
@@ -9,8 +9,14 @@
 #define VIDEO       0xB8000
 
 int32_t printf(int8_t *format, ...);
+int32_t vformat(int8_t* out, int32_t size, int8_t* format, int32_t* args);
+/* gets each full buffer of vformat_split: the text, its length and the caller's arg */
+typedef void (*fmt_flush_t)(int8_t* out, int32_t len, void* arg);
+int32_t vformat_split(int8_t* out, int32_t size, int8_t* format, int32_t* args,
+        fmt_flush_t flush, void* arg);
 void putc(uint8_t c);
 int32_t puts(int8_t *s);
+int32_t putbuf(const uint8_t* buf, int32_t n);
 int8_t *itoa(uint32_t value, int8_t* buf, int32_t radix);
 int8_t *strrev(int8_t* s);
 uint32_t strlen(const int8_t* s);
@@ -28,14 +34,44 @@ int8_t* strncpy(int8_t* dest, const int8_t*src, uint32_t n);
 extern void scroll();
 extern void test_interrupts(); 
 extern void update_screen_coords(int new_screen_x, int new_screen_y);
-extern void update_screen_ptr(int *new_screen_x, int *new_screen_y);
 extern int get_screen_x();
 extern int get_screen_y();
+extern void screen_home();
+extern void screen_show(int32_t tid);
+extern void screen_scrollback(int32_t tid, int32_t rows);
+extern void console_present();
 
 /* Userspace address-check functions */
 int32_t bad_userspace_addr(const void* addr, int32_t len);
 int32_t safe_strncpy(int8_t* dest, const int8_t* src, int32_t n);
 
+/* Reads the time-stamp counter. Only subtract readings; the kernel has no 64-bit division */
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    asm volatile ("rdtsc"
+            : "=a"(lo), "=d"(hi)
+    );
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/* Model-specific register access */
+static inline uint32_t rdmsr_lo(uint32_t msr) {
+    uint32_t lo, hi;
+    asm volatile ("rdmsr"
+            : "=a"(lo), "=d"(hi)
+            : "c"(msr)
+    );
+    return lo;
+}
+
+static inline void wrmsr(uint32_t msr, uint32_t lo, uint32_t hi) {
+    asm volatile ("wrmsr"
+            :
+            : "c"(msr), "a"(lo), "d"(hi)
+            : "memory"
+    );
+}
+
 /* Port read functions */
 /* Inb reads a byte and returns its value as a zero-extended 32-bit
  * unsigned int */
@@ -2,11 +2,13 @@
 
 #include "paging.h"
 #include "page.h"
+#include "lib.h"
+#include "kinfo.h"
 
-/* Page directory/table init */
-page_dir_entry_t page_dir[PAGE_ENTRIES] __attribute__((aligned(4096)));
-page_table_entry_t page_table[PAGE_ENTRIES] __attribute__((aligned(4096))); // new page table
-page_table_entry_t video_page_table[PAGE_ENTRIES] __attribute__((aligned(4096))); // new page table
+/* Page directory/table init, one set per cpu */
+page_dir_entry_t cpu_page_dir[MAX_CPUS][PAGE_ENTRIES] __attribute__((aligned(4096)));
+page_table_entry_t cpu_page_table[MAX_CPUS][PAGE_ENTRIES] __attribute__((aligned(4096))); // new page table
+page_table_entry_t cpu_video_page_table[MAX_CPUS][PAGE_ENTRIES] __attribute__((aligned(4096))); // new page table
 
 extern void loadPageDirectory(page_dir_entry_t* p_d); 
 extern void enablePaging(); 
@@ -37,7 +39,7 @@ void page_init() {
     
     /* Initalize page table 0 */
     for (i = 0; i < NUM_PAGES; i++) {
-        if(i>=184 && i<=187){
+        if(i >= (VGA_TEXT_START >> 12) && i < (VGA_TEXT_END >> 12)){       // all of VGA text memory
             page_table[i].present = 1;
             page_table[i].page_cache_disable = 0;       // pcd should be 0 for video memory pages
         }else{
@@ -58,10 +60,11 @@ void page_init() {
     }
 
 
-    /* Initialize video page table (for vidmap)*/
+    /* Initialize video page table (for vidmap). The vidmap page itself stays absent until a
+     * process asks for it */
         for (i = 0; i < NUM_PAGES; i++) {
         if(i==0){
-            video_page_table[i].present = 1;
+            video_page_table[i].present = 0;
             video_page_table[i].page_cache_disable = 0;       // pcd should be 0 for video memory pages
         }else{
             video_page_table[i].present = 0;              
@@ -79,6 +82,12 @@ void page_init() {
         video_page_table[i].page_base_address = i; // 4KB page size - 0x1000 = 4096
     }
     
+    /* kernel info page right after it, user read-only */
+    video_page_table[KINFO_PTE].present = 1;
+    video_page_table[KINFO_PTE].read_write = 0;
+    video_page_table[KINFO_PTE].page_cache_disable = 0;
+    video_page_table[KINFO_PTE].page_base_address = ((unsigned int)kinfo_pages[0]) >> 12;
+
     /* Set virtual memory 0-4MB (broken down into 4KB pages) */
     page_dir[0].page_dir_entry_4kb_t.present = 1;
     page_dir[0].page_dir_entry_4kb_t.read_write = 1;
@@ -103,12 +112,46 @@ void page_init() {
     page_dir[1].page_dir_entry_4mb_t.reserved = 0;
     page_dir[1].page_dir_entry_4mb_t.page_base_address = (KERNEL_START >> 22); // align the page_table address to 4MB boundary
 
+    /* 132-136MB: the vidmap and kernel info pages, present in every process */
+    page_dir[33].page_dir_entry_4kb_t.present = 1;
+    page_dir[33].page_dir_entry_4kb_t.read_write = 1;
+    page_dir[33].page_dir_entry_4kb_t.user_supervisor = 1;
+    page_dir[33].page_dir_entry_4kb_t.page_size = 0; // 4KB page size
+    page_dir[33].page_dir_entry_4kb_t.page_table_base_address = ((unsigned int) video_page_table) >> 12;
+
+    /* Map the IOAPIC/local APIC registers (0xFEC00000-0xFFFFFFFF), uncached and kernel only */
+    page_dir[APIC_MMIO_BASE >> 22].page_dir_entry_4mb_t.present = 1;
+    page_dir[APIC_MMIO_BASE >> 22].page_dir_entry_4mb_t.read_write = 1;
+    page_dir[APIC_MMIO_BASE >> 22].page_dir_entry_4mb_t.user_supervisor = 0;
+    page_dir[APIC_MMIO_BASE >> 22].page_dir_entry_4mb_t.page_write_through = 1;
+    page_dir[APIC_MMIO_BASE >> 22].page_dir_entry_4mb_t.page_cache_disable = 1;
+    page_dir[APIC_MMIO_BASE >> 22].page_dir_entry_4mb_t.page_size = 1; // 4MB page
+    page_dir[APIC_MMIO_BASE >> 22].page_dir_entry_4mb_t.reserved = 0;
+    page_dir[APIC_MMIO_BASE >> 22].page_dir_entry_4mb_t.page_base_address = (APIC_MMIO_BASE >> 22);
+
 
     /* load directory and enable */
     loadPageDirectory(page_dir);
     enablePaging();
 }
 
+/* page_init_cpu
+ *   Inputs: cpu - secondary cpu to build tables for
+ *   Return Value: none
+ *   Function: Copies the boot cpu's paging setup into another cpu's tables, pointing its
+ *             directory at its own page tables. The cpu loads them itself when it starts (smp_s.S) */
+void page_init_cpu(uint32_t cpu) {
+    memcpy(cpu_page_dir[cpu], cpu_page_dir[0], sizeof(cpu_page_dir[0]));
+    memcpy(cpu_page_table[cpu], cpu_page_table[0], sizeof(cpu_page_table[0]));
+    memcpy(cpu_video_page_table[cpu], cpu_video_page_table[0], sizeof(cpu_video_page_table[0]));
+
+    cpu_page_dir[cpu][0].page_dir_entry_4kb_t.page_table_base_address = ((unsigned int) cpu_page_table[cpu]) >> 12;
+    cpu_page_dir[cpu][32].page_dir_entry_4mb_t.present = 0;     // no process yet
+    cpu_page_dir[cpu][33].page_dir_entry_4kb_t.page_table_base_address = ((unsigned int) cpu_video_page_table[cpu]) >> 12;
+    cpu_video_page_table[cpu][0].present = 0;                   // no vidmap yet
+    cpu_video_page_table[cpu][KINFO_PTE].page_base_address = ((unsigned int) kinfo_pages[cpu]) >> 12;
+}
+
 void add_pid_page(uint32_t pid){
     uint32_t physical_address;
 
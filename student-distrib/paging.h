@@ -5,9 +5,14 @@
 #define _PAGING_H
 
 #include "types.h"
+#include "x86_desc.h"
 
 #define PAGE_ENTRIES 1024
 #define KERNEL_START 0x400000
+#define APIC_MMIO_BASE 0xFEC00000     // 4MB page holding the IOAPIC and local APIC registers
+/* VGA text memory, always mapped: the terminals' regions (TERM*_VIDMEM) lie inside it */
+#define VGA_TEXT_START 0xB8000
+#define VGA_TEXT_END   0xC0000
 
 /* Page table struct */
 typedef union page_table_entry_t {
@@ -67,11 +72,19 @@ typedef union page_dir_entry_t {
 
 
 
-extern page_dir_entry_t page_dir[PAGE_ENTRIES] __attribute__((aligned(4096)));
-extern page_table_entry_t page_table[PAGE_ENTRIES] __attribute__((aligned(4096))); // new page table
-extern page_table_entry_t video_page_table[PAGE_ENTRIES] __attribute__((aligned(4096))); // new page table
+/* Each cpu runs a different process, so each has its own page directory and the two page tables
+ * that change per process (video memory remapping and vidmap). Kernel mappings are the same in all. */
+extern page_dir_entry_t cpu_page_dir[MAX_CPUS][PAGE_ENTRIES] __attribute__((aligned(4096)));
+extern page_table_entry_t cpu_page_table[MAX_CPUS][PAGE_ENTRIES] __attribute__((aligned(4096)));
+extern page_table_entry_t cpu_video_page_table[MAX_CPUS][PAGE_ENTRIES] __attribute__((aligned(4096)));
+
+/* tables of the executing cpu */
+#define page_dir (cpu_page_dir[smp_cpu_id()])
+#define page_table (cpu_page_table[smp_cpu_id()])
+#define video_page_table (cpu_video_page_table[smp_cpu_id()])
 
 extern void page_init();
+extern void page_init_cpu(uint32_t cpu);
 void add_pid_page(uint32_t pid);
 
 #endif
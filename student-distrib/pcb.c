@@ -5,8 +5,10 @@
 #include "terminal.h"
 #include "systemcall.h"
 #include "scheduler.h"
-
-#define FILE_ARRAY_SIZE 8
+#include "pit.h"
+#include "smp.h"
+#include "poll.h"
+#include "klog.h"
 
 file_op_func_t rtc_funcs; 
 file_op_func_t file_funcs; 
@@ -15,6 +17,15 @@ file_op_func_t term_funcs;
 
 int i = 0x7fe000;
 pcb_entry_t* pcb_ptr[MAX_PROCESSES];
+spinlock_t pcb_lock = SPINLOCK_INIT;
+
+/* open files, shared by the fds that point at them */
+static file_arr_entry_t open_files[MAX_OPEN_FILES];
+/* protects open_files allocation and reference counts */
+static spinlock_t files_lock = SPINLOCK_INIT;
+
+/* fd table of each pid once it outgrows the one in its pcb */
+static file_arr_entry_t* fd_grown[MAX_PROCESSES][FD_TABLE_MAX];
 
 /* pcb_init
  *   Inputs: none
@@ -25,19 +36,23 @@ void pcb_init(){
     rtc_funcs.close_func = rtc_close;
     rtc_funcs.read_func = rtc_read;
     rtc_funcs.write_func = rtc_write;
+    rtc_funcs.poll_func = rtc_poll;
 
     file_funcs.close_func = file_close;
     file_funcs.read_func = file_read;
     file_funcs.write_func = file_write;
+    file_funcs.poll_func = poll_always;
 
     dir_funcs.close_func = dir_close;
     dir_funcs.read_func = dir_read;
     dir_funcs.write_func = dir_write;
+    dir_funcs.poll_func = poll_always;
 
 
     term_funcs.close_func = terminal_close;
     term_funcs.read_func = terminal_read;
     term_funcs.write_func = terminal_write;
+    term_funcs.poll_func = terminal_poll;
 
     // set up pcb pointers
     int i; 
@@ -47,59 +62,329 @@ void pcb_init(){
         pcb_ptr[i] = (pcb_entry_t*)(EIGHT_MB - (i+1)*EIGHT_KB);
         pcb_ptr[i]->current = 0;
         pcb_ptr[i]->pid_in_use = 0;
+        memset(&pcb_ptr[i]->rt, 0, sizeof(rt_params_t));
+        pcb_ptr[i]->sleeping = 0;
+        pcb_ptr[i]->fpu.used = 0;
+        pcb_ptr[i]->sleep_timer.pending = 0;
+        pcb_ptr[i]->alarm_timer.pending = 0;
+        pcb_ptr[i]->alarm_period = 0;
+        pcb_ptr[i]->sig_pending = 0;
+        pcb_ptr[i]->utime = 0;
+        pcb_ptr[i]->stime = 0;
+        pcb_ptr[i]->nsyscalls = 0;
+        fd_table_init(i);
+    }
+}
+
+/* account_tick
+ *   Inputs: cs - code segment the timer interrupt came in on
+ *   Return Value: none
+ *   Function: Charges one pit tick to the running process, as user time if the interrupt came
+ *             from ring 3 and as kernel time otherwise. Called from pit_int_handler with interrupts off.
+*/
+void account_tick(uint32_t cs){
+    pcb_entry_t* pcb;
+
+    if(active_pid < 0)
+        { this_cpu()->idle_ticks++; return; }
+
+    pcb = pcb_ptr[active_pid];
+    if(pcb->sleeping)
+        this_cpu()->idle_ticks++;       // halted in sleep_ticks waiting for any timer
+    else if((cs & 0x3) == 0x3)
+        pcb->utime++;
+    else
+        pcb->stime++;
+}
+
+/* cpustats
+ *   Inputs: stats - user buffer to fill in
+ *   Return Value: number of processes reported, -1 on bad pointer
+ *   Function: Snapshots the cpu counters of every pid in use. Callers sample twice and divide
+ *             the per-process deltas by the tick delta to get cpu share.
+*/
+int32_t cpustats(cpu_stats_t* stats){
+    uint32_t flags;
+    uint32_t cpu;
+    int32_t pid;
+    proc_stat_t* ps;
+
+    if(bad_userspace_addr(stats, sizeof(cpu_stats_t)))
+        return -1;
+
+    spin_lock_irqsave(&pcb_lock, flags);
+    stats->ticks = pit_ticks;
+    stats->hz = PIT_FREQ;
+    stats->idle_ticks = 0;
+    for(cpu=0; cpu<num_cpus; cpu++)
+        stats->idle_ticks += cpus[cpu].idle_ticks;
+    stats->ncpus = num_cpus;
+    stats->nprocs = 0;
+    for(pid=0; pid<MAX_PROCESSES; pid++){
+        if(!pcb_ptr[pid]->pid_in_use)
+            continue;
+        ps = &stats->procs[stats->nprocs++];
+        ps->pid = pid;
+        ps->parent_pid = pcb_ptr[pid]->parent_pid;
+        ps->t_id = pcb_ptr[pid]->t_id;
+        ps->utime = pcb_ptr[pid]->utime;
+        ps->stime = pcb_ptr[pid]->stime;
+        ps->nsyscalls = pcb_ptr[pid]->nsyscalls;
+        memcpy(ps->name, pcb_ptr[pid]->name, PROC_NAME_LEN);
+    }
+    spin_unlock_irqrestore(&pcb_lock, flags);
+
+    return stats->nprocs;
+}
+
+
+/* file_alloc
+ *   Inputs: file_funcs_ptr:    func operations of the new open file
+ *           inode:             inode of a regular file (or pipe index), else anything and ignored
+ *   Return Value:  the open file with one reference, NULL if all MAX_OPEN_FILES are in use
+ *   Function: takes a free open file from the system wide table
+*/
+file_arr_entry_t* file_alloc(file_op_func_t* file_funcs_ptr, uint32_t inode){
+    uint32_t flags;
+    int32_t k;
+
+    spin_lock_irqsave(&files_lock, flags);
+    for(k=0; k<MAX_OPEN_FILES; k++){
+        if(!open_files[k].in_use)
+            break;
     }
+    if(k==MAX_OPEN_FILES)
+        { spin_unlock_irqrestore(&files_lock, flags); return NULL; }
+
+    open_files[k].in_use = 1;
+    open_files[k].nonblock = 0;
+    open_files[k].refs = 1;
+    open_files[k].file_pos = 0;
+    open_files[k].file_op_tbl_ptr = file_funcs_ptr;
+    open_files[k].inode = inode;
+    spin_unlock_irqrestore(&files_lock, flags);
+    return &open_files[k];
+}
+
+/* file_get
+ *   Inputs: file:  open file
+ *   Return Value:  none
+ *   Function: takes another reference for a new fd pointing at the file
+*/
+void file_get(file_arr_entry_t* file){
+    uint32_t flags;
+
+    spin_lock_irqsave(&files_lock, flags);
+    file->refs++;
+    spin_unlock_irqrestore(&files_lock, flags);
+}
+
+/* file_put
+ *   Inputs: file:  open file
+ *   Return Value:  none
+ *   Function: drops a reference, the file is free again once there are none
+*/
+static void file_put(file_arr_entry_t* file){
+    uint32_t flags;
+
+    spin_lock_irqsave(&files_lock, flags);
+    if(--file->refs == 0)
+        file->in_use = 0;
+    spin_unlock_irqrestore(&files_lock, flags);
+}
+
+/* fd_get
+ *   Inputs: fd:    fd of the current process
+ *   Return Value:  the open file behind it, NULL if fd is out of range or closed, or if there is
+ *                  no current process (the boot context, e.g. launch_tests, has no fd table)
+*/
+file_arr_entry_t* fd_get(int32_t fd){
+    pcb_entry_t* pcb;
+
+    if(active_pid<0)
+        return NULL;
+    pcb = pcb_ptr[active_pid];
+    if(fd<0 || (uint32_t)fd >= pcb->fd_max)
+        return NULL;
+    return pcb->fd_table[fd];
+}
+
+/* fd_grow
+ *   Inputs: fd:    fd that must fit in the current process's table
+ *   Return Value:  0 if it fits (now), -1 if fd >= FD_TABLE_MAX or there is no current process
+ *   Function: moves the table out of the pcb into the process's own FD_TABLE_MAX table. There is
+ *             no kernel heap, so each pid has one set aside, used only by processes that need it
+*/
+static int32_t fd_grow(int32_t fd){
+    pcb_entry_t* pcb;
+
+    if(active_pid<0 || fd<0 || fd>=FD_TABLE_MAX)
+        return -1;
+    pcb = pcb_ptr[active_pid];
+    if((uint32_t)fd < pcb->fd_max)
+        return 0;
+
+    memset(fd_grown[active_pid], 0, sizeof(fd_grown[active_pid]));
+    memcpy(fd_grown[active_pid], pcb->fd_inline, sizeof(pcb->fd_inline));
+    pcb->fd_table = fd_grown[active_pid];
+    pcb->fd_max = FD_TABLE_MAX;
+    return 0;
 }
 
+/* fd_install
+ *   Inputs: file:      open file, whose reference the new fd takes over
+ *           min_fd:    lowest fd to use
+ *   Return Value:  the lowest free fd >= min_fd, growing the table if needed; -1 if there is none
+ *   Function: points a free fd of the current process at file
+*/
+int32_t fd_install(file_arr_entry_t* file, int32_t min_fd){
+    int32_t k;
+
+    if(file==NULL)
+        return -1;
+
+    for(k=min_fd; k<FD_TABLE_MAX; k++){
+        if(fd_grow(k)==-1)
+            return -1;
+        if(pcb_ptr[active_pid]->fd_table[k]==NULL){
+            pcb_ptr[active_pid]->fd_table[k] = file;
+            return k;
+        }
+    }
+    return -1;
+}
 
 /* insert_into_file_array
  *   Inputs: file_funcs_ptr:    ptr to func options that should be inserted into fd entry
  *           inode:             if inserting reg file, inode of that file, else is sent as -1 (or some other invalid #) and ignored
  *   Return Value:  fd of new file array entry if successful, -1 on failure
- *   Function: inserts a new entry into current pcb's file array if possible
+ *   Function: opens a new file and gives it the lowest free fd from 2 up
 */
 uint32_t insert_into_file_array(file_op_func_t* file_funcs_ptr, uint32_t inode){
+    file_arr_entry_t* file = file_alloc(file_funcs_ptr, inode);
+    int32_t fd;
 
-    uint8_t k; // iteration variable
-
-    // find available file array entry
-    for(k=2; k<FILE_ARRAY_SIZE; k++){
-        if(pcb_ptr[active_pid]->fd_array[k].in_use !=1){
-            // create file array entry here
-            pcb_ptr[active_pid]->fd_array[k].in_use = 1;
-            pcb_ptr[active_pid]->fd_array[k].file_pos = 0; 
-            pcb_ptr[active_pid]->fd_array[k].file_op_tbl_ptr = file_funcs_ptr;
-            if(inode>=0 && inode<=63){
-                pcb_ptr[active_pid]->fd_array[k].inode = inode; 
-            }
-
-            return k;   // return fd
-        }
-    }
+    if(file==NULL)
+        return -1;
 
-    // no available file array entry
-    //printf("ERR in insert_into_file_array: no room to open this file \n");
-    return -1; 
+    fd = fd_install(file, 2);
+    if(fd==-1)
+        file_put(file);
+    return fd;
 }
 
 /* remove_from_file_array
  *   Inputs: fd:    fd of file array entry to close
  *   Return Value:  0 if successfully closed, -1 on failure (fd invalid or already closed)
- *   Function: removes file array entry from current pcb's file array if possible
+ *   Function: frees the fd, and the open file if this was its last fd. Called by the close functions
 */
 uint32_t remove_from_file_array(int32_t fd){
+    file_arr_entry_t* file = fd_get(fd);
+    uint32_t flags;
 
-    if(fd<0 || fd>7){
-        printf("ERR trying to remove from file array with invalid fd. Given fd: %d \n", fd);
+    if(file==NULL){
+        printk(KLOG_WARN, "ERR cannot remove file array entry at fd: %d .Not open \n", fd);
         return -1; 
     }
 
-    if(pcb_ptr[active_pid]->fd_array[fd].in_use!=1){
-        printf("ERR cannot remove file array entry at fd: %d .File array entry already removed \n", fd);
-        return -1; 
+    /* halt closes files with interrupts off, keep them that way */
+    cli_and_save(flags);
+    pcb_ptr[active_pid]->fd_table[fd] = NULL;
+    file_put(file);
+    restore_flags(flags);
+    return 0;
+}
+
+/* fd_close
+ *   Inputs: fd:    fd of the current process
+ *   Return Value:  0 on success, -1 if fd is not open
+ *   Function: closes an fd. Only the last fd of an open file runs its close function
+*/
+int32_t fd_close(int32_t fd){
+    file_arr_entry_t* file = fd_get(fd);
+    uint32_t flags;
+
+    if(file==NULL)
+        return -1;
+
+    /* another fd keeps it open. A sole reference cannot gain one meanwhile, only its holder could dup it */
+    spin_lock_irqsave(&files_lock, flags);
+    if(file->refs > 1){
+        file->refs--;
+        pcb_ptr[active_pid]->fd_table[fd] = NULL;
+        spin_unlock_irqrestore(&files_lock, flags);
+        return 0;
     }
+    spin_unlock_irqrestore(&files_lock, flags);
 
-    cli();
-   pcb_ptr[active_pid]->fd_array[fd].in_use = 0;
-   sti();
-    return 0;
+    return file->file_op_tbl_ptr->close_func(fd);
+}
+
+/* fd_table_init
+ *   Inputs: pid:   process
+ *   Return Value:  none
+ *   Function: empty table in the pcb, for a process about to be started
+*/
+void fd_table_init(int32_t pid){
+    pcb_entry_t* pcb = pcb_ptr[pid];
+
+    memset(pcb->fd_inline, 0, sizeof(pcb->fd_inline));
+    pcb->fd_table = pcb->fd_inline;
+    pcb->fd_max = FD_INLINE;
+}
+
+/* fd_close_all
+ *   Inputs: none
+ *   Return Value:  none
+ *   Function: closes every fd of the current process (halt) and shrinks its table back
+*/
+void fd_close_all(){
+    uint32_t fd;
+
+    for(fd=0; fd<pcb_ptr[active_pid]->fd_max; fd++){
+        if(pcb_ptr[active_pid]->fd_table[fd]!=NULL)
+            fd_close(fd);
+    }
+    fd_table_init(active_pid);
+}
+
+/* dup
+ *   Inputs: fd:    open fd
+ *   Return Value:  the lowest free fd, now sharing fd's open file; -1 if fd is not open or the table is full
+ *   Function: dup system call
+*/
+int32_t dup(int32_t fd){
+    file_arr_entry_t* file = fd_get(fd);
+    int32_t new_fd;
+
+    if(file==NULL)
+        return -1;
+
+    file_get(file);
+    new_fd = fd_install(file, 0);
+    if(new_fd==-1)
+        file_put(file);
+    return new_fd;
+}
+
+/* dup2
+ *   Inputs: old_fd:    open fd
+ *           new_fd:    fd to point at the same open file, closed first if open
+ *   Return Value:  new_fd, -1 if old_fd is not open or new_fd is out of range
+ *   Function: dup2 system call, e.g. dup2(pipe_fd, 1) sends stdout into a pipe
+*/
+int32_t dup2(int32_t old_fd, int32_t new_fd){
+    file_arr_entry_t* file = fd_get(old_fd);
+
+    if(file==NULL || fd_grow(new_fd)==-1)
+        return -1;
+    if(old_fd==new_fd)
+        return new_fd;
+
+    if(pcb_ptr[active_pid]->fd_table[new_fd]!=NULL && fd_close(new_fd)==-1)
+        return -1;
+
+    file_get(file);
+    pcb_ptr[active_pid]->fd_table[new_fd] = file;
+    return new_fd;
 }
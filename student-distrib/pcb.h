@@ -6,15 +6,24 @@
 #include "file.h"
 #include "filedir.h"
 #include "keyboard.h"
-
-#define MAX_FD_ENTRIES 8
+#include "timer.h"
+#include "switch_s.h"
+#include "fpu.h"
+#include "spinlock.h"
+#include "signal.h"
+
+#define FD_INLINE 8         // fds every process has room for in its pcb
+#define FD_TABLE_MAX 64     // most fds a process can grow to
+#define MAX_OPEN_FILES 128  // open files system wide
 #define NUM_REGS 10
 #define MAX_PROCESSES 6
+#define PROC_NAME_LEN 32
 
 //typedef int32_t (*open_func_ptr)(const uint8_t* filename);
 typedef int32_t (*close_func_ptr)(int32_t fd);
 typedef int32_t (*read_func_ptr)(int32_t fd, void* buf, int32_t nbytes);
 typedef int32_t (*write_func_ptr)(int32_t fd, const void* buf, int32_t nbytes);
+typedef int32_t (*poll_func_ptr)(int32_t fd);
 
 typedef struct file_op_func_t{
 
@@ -22,6 +31,7 @@ typedef struct file_op_func_t{
     close_func_ptr close_func;
     read_func_ptr read_func;
     write_func_ptr write_func; 
+    poll_func_ptr poll_func;    // POLLIN/POLLOUT bits the fd is ready for right now, never blocks
 
 }file_op_func_t;
 
@@ -31,31 +41,50 @@ extern file_op_func_t dir_funcs;
 extern file_op_func_t term_funcs; 
 
 
+/* an open file. Every fd dup'd from it or inherited at execute/spawn points at the same one,
+ * so they share the position and flags; the close function runs when the last fd goes */
 typedef struct file_arr_entry_t{
 
     file_op_func_t* file_op_tbl_ptr;
     uint32_t inode;
     uint32_t file_pos;
+    uint32_t refs;                      // fds pointing here, in all processes
     union{
         uint32_t flags; 
         struct{
-            uint32_t in_use : 1;
-            uint32_t reserved : 31;
+            uint32_t in_use : 1;          // allocated from open_files
+            uint32_t nonblock : 1;      // O_NONBLOCK (see fcntl): reads/writes fail instead of waiting
+            uint32_t reserved : 30;
         } __attribute__((packed));
     }; 
     
 }file_arr_entry_t;
 
+/* real-time scheduling state of a process. period==0 means best-effort. All times are in PIT ticks */
+typedef struct rt_params_t{
+    uint32_t period;
+    uint32_t budget;        // cpu ticks granted per period
+    uint32_t util;          // budget/period scaled by RT_UTIL_SCALE, counted against admission
+    uint32_t remaining;     // budget left for the current job
+    uint32_t deadline;      // absolute tick the current job must finish by
+    uint32_t next_release;  // absolute tick the next job is released at
+    uint32_t releases;
+    uint32_t misses;
+    uint8_t job_active;     // set at release, cleared when the job waits for its next frame
+}rt_params_t;
+
 typedef struct pcb_entry{
-    /* current regs*/
-    uint32_t esp;
-    uint32_t ebp;
+    /* kernel context while switched out by the scheduler */
+    context_t context;
 
     uint32_t esp_exec;
     uint32_t ebp_exec;
 
-    /* Current Task Info */
-    file_arr_entry_t fd_array[MAX_FD_ENTRIES];
+    /* Current Task Info. fd -> open file, NULL when closed. fd_table is fd_inline until the
+     * process needs more than FD_INLINE fds, then a table of FD_TABLE_MAX (see fd_grow) */
+    file_arr_entry_t** fd_table;
+    uint32_t fd_max;
+    file_arr_entry_t* fd_inline[FD_INLINE];
 
 
     /* current args */
@@ -68,20 +97,90 @@ typedef struct pcb_entry{
     // thread id. matches 0 indexed terminal this process is on
     uint8_t t_id; 
 
+    // has called vidmap, its terminal's first VGA page is mapped at 132MB while it runs
+    uint8_t vidmapped;
+
     // flag to track if this process is current process of it's thread
     uint8_t current;
 
     // flag to track if this pcb currently being used
     uint8_t pid_in_use;
 
+    // started by spawn(SPAWN_NOWAIT): runs alongside its parent and frees itself in halt
+    uint8_t detached;
+
+    // real-time scheduling class (see scheduler.c)
+    rt_params_t rt;
+
+    // x87/SSE registers, saved lazily (see fpu.c)
+    fpu_state_t fpu;
+
+    // set while blocked in sleep/nanosleep, cleared by sleep_timer
+    volatile uint8_t sleeping;
+    timer_t sleep_timer;
+
+    // cpu accounting in PIT ticks, charged by pit_int_handler from the interrupted privilege level
+    uint32_t utime;
+    uint32_t stime;
+    uint32_t nsyscalls;
+    uint8_t name[PROC_NAME_LEN];
+
+    // batched system call rings in user memory, NULL until ioring_setup (see ioring.c)
+    struct io_ring_t* ring;
+
+    // pid whose trace log this process's system calls go to, -1 if untraced (see systrace.c)
+    int32_t tracer;
+    uint8_t trace_children;
+
+    // signals (see signal.c): user handler per signal or NULL for the default, pending bits,
+    // set while a handler runs. ALARM is sent every alarm_period pit ticks, 0 when off
+    void* sig_handler[NUM_SIGNALS];
+    volatile uint32_t sig_pending;
+    uint8_t sig_in_handler;
+    uint32_t alarm_period;
+    timer_t alarm_timer;
 
 }pcb_entry_t;
 
+/* per-process cpu usage as reported by the cpustats system call */
+typedef struct proc_stat_t{
+    int32_t pid;
+    int32_t parent_pid;
+    uint32_t t_id;
+    uint32_t utime;
+    uint32_t stime;
+    uint32_t nsyscalls;
+    uint8_t name[PROC_NAME_LEN];
+}proc_stat_t;
+
+typedef struct cpu_stats_t{
+    uint32_t ticks;         // pit ticks since boot
+    uint32_t hz;            // pit ticks per second
+    uint32_t idle_ticks;    // ticks with no process running (boot, or everyone asleep), summed over cpus
+    uint32_t ncpus;         // cpus online, busy + idle ticks add up to ticks * ncpus
+    uint32_t nprocs;        // valid entries in procs
+    proc_stat_t procs[MAX_PROCESSES];
+}cpu_stats_t;
+
 extern pcb_entry_t* pcb_ptr[MAX_PROCESSES]; 
 
+/* protects pid allocation (pid_in_use) between cpus */
+extern spinlock_t pcb_lock;
+
 extern uint32_t insert_into_file_array(file_op_func_t* file_funcs_ptr, uint32_t inode);
 extern uint32_t remove_from_file_array(int32_t fd);
+extern file_arr_entry_t* file_alloc(file_op_func_t* file_funcs_ptr, uint32_t inode);
+extern void file_get(file_arr_entry_t* file);
+extern file_arr_entry_t* fd_get(int32_t fd);
+extern int32_t fd_install(file_arr_entry_t* file, int32_t min_fd);
+extern int32_t fd_close(int32_t fd);
+extern void fd_table_init(int32_t pid);
+extern void fd_close_all();
+extern int32_t dup(int32_t fd);
+extern int32_t dup2(int32_t old_fd, int32_t new_fd);
 
 extern void pcb_init();
+extern void account_tick(uint32_t cs);
+extern int32_t cpustats(cpu_stats_t* stats);
 
 #endif
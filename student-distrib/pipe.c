@@ -0,0 +1,244 @@
+/* pipe.c - pipes between processes.
+ *
+ * A pipe is a PIPE_SIZE ring buffer with two ends, each an open file with its own
+ * file_op_func_t. Readers block while it is empty and see end of file once every write end is
+ * closed; writers block while it is full and fail once every read end is closed. An end handed
+ * to other processes at execute/spawn or dup'd stays one open file, whose close function only
+ * runs for its last fd, so readers/writers count open ends, not fds.
+ * Every change a poller could be waiting for ends with poll_wake, after the pipe lock is dropped
+ * (poll takes the pipe lock inside its own). */
+
+#include "pipe.h"
+#include "scheduler.h"
+#include "signal.h"
+#include "poll.h"
+#include "lib.h"
+
+static int32_t pipe_read(int32_t fd, void* buf, int32_t nbytes);
+static int32_t pipe_write(int32_t fd, const void* buf, int32_t nbytes);
+static int32_t pipe_close_read(int32_t fd);
+static int32_t pipe_close_write(int32_t fd);
+static int32_t pipe_bad_read(int32_t fd, void* buf, int32_t nbytes);
+static int32_t pipe_bad_write(int32_t fd, const void* buf, int32_t nbytes);
+static int32_t pipe_poll_read(int32_t fd);
+static int32_t pipe_poll_write(int32_t fd);
+
+file_op_func_t pipe_read_funcs = { pipe_close_read, pipe_read, pipe_bad_write, pipe_poll_read };
+file_op_func_t pipe_write_funcs = { pipe_close_write, pipe_bad_read, pipe_write, pipe_poll_write };
+
+static pipe_t pipes[MAX_PIPES];
+
+/* protects finding a free pipe */
+static spinlock_t pipes_lock = SPINLOCK_INIT;
+
+/* fd_pipe
+ *   Inputs: fd - descriptor of the current process
+ *   Return Value: the pipe behind it */
+static pipe_t* fd_pipe(int32_t fd){
+    return &pipes[fd_get(fd)->inode];
+}
+
+/* pipe
+ *   Inputs: fds - where to store the read end (fds[0]) and the write end (fds[1])
+ *   Return Value: 0 on success, -1 if fds is bad or no pipe or descriptor is free
+ *   Function: pipe system call */
+int32_t pipe(int32_t* fds){
+    uint32_t flags;
+    int32_t i, rfd, wfd;
+
+    if (bad_userspace_addr(fds, 2 * sizeof(int32_t)))
+        return -1;
+
+    spin_lock_irqsave(&pipes_lock, flags);
+    for (i = 0; i < MAX_PIPES; i++) {
+        if (pipes[i].readers == 0 && pipes[i].writers == 0)
+            break;
+    }
+    if (i == MAX_PIPES)
+        { spin_unlock_irqrestore(&pipes_lock, flags); return -1; }
+
+    pipes[i].head = pipes[i].tail = 0;
+    pipes[i].waiters = 0;
+    pipes[i].readers = pipes[i].writers = 1;
+    spin_unlock_irqrestore(&pipes_lock, flags);
+
+    rfd = insert_into_file_array(&pipe_read_funcs, i);
+    wfd = (rfd == -1) ? -1 : insert_into_file_array(&pipe_write_funcs, i);
+    if (wfd == -1) {
+        if (rfd != -1)
+            remove_from_file_array(rfd);
+        pipes[i].readers = pipes[i].writers = 0;
+        return -1;
+    }
+
+    fds[0] = rfd;
+    fds[1] = wfd;
+    return 0;
+}
+
+/* pipe_read
+ *   Inputs: fd - read end, buf - user buffer, nbytes - most bytes to read
+ *   Return Value: bytes read, 0 at end of file, -1 on a bad buffer or a signal (or, O_NONBLOCK,
+ *                 on an empty pipe)
+ *   Function: blocks until there is data or no writer is left, then returns what is there */
+static int32_t pipe_read(int32_t fd, void* buf, int32_t nbytes){
+    uint32_t flags, n, first;
+    pipe_t* p = fd_pipe(fd);
+
+    if (bad_userspace_addr(buf, nbytes))
+        return -1;
+
+    spin_lock_irqsave(&p->lock, flags);
+    while (p->tail == p->head) {
+        if (p->writers == 0 || nbytes == 0)
+            { spin_unlock_irqrestore(&p->lock, flags); return 0; }
+        if (fd_get(fd)->nonblock || signal_pending())
+            { spin_unlock_irqrestore(&p->lock, flags); return -1; }
+        sleep_on(&p->waiters, &p->lock);
+    }
+
+    n = p->tail - p->head;
+    if (n > (uint32_t)nbytes)
+        n = nbytes;
+    first = PIPE_SIZE - (p->head & PIPE_MASK);
+    if (first > n)
+        first = n;
+    memcpy(buf, &p->buf[p->head & PIPE_MASK], first);
+    memcpy((uint8_t*)buf + first, p->buf, n - first);
+    p->head += n;
+
+    /* room for blocked writers */
+    wake_up(&p->waiters);
+    spin_unlock_irqrestore(&p->lock, flags);
+    poll_wake();
+    return n;
+}
+
+/* pipe_write
+ *   Inputs: fd - write end, buf - user data, nbytes - bytes to write
+ *   Return Value: nbytes, fewer if the readers went away or a signal came in part way (or, O_NONBLOCK,
+ *                 the pipe filled up), -1 if nothing was written for those reasons or the buffer is bad
+ *   Function: copies everything in, blocking whenever the pipe is full */
+static int32_t pipe_write(int32_t fd, const void* buf, int32_t nbytes){
+    uint32_t flags, n, first;
+    int32_t written = 0;
+    int32_t nonblock = fd_get(fd)->nonblock;
+    pipe_t* p = fd_pipe(fd);
+
+    if (bad_userspace_addr(buf, nbytes))
+        return -1;
+
+    spin_lock_irqsave(&p->lock, flags);
+    while (written < nbytes) {
+        if (p->readers == 0 || (p->tail - p->head == PIPE_SIZE && (nonblock || signal_pending())))
+            break;
+        if (p->tail - p->head == PIPE_SIZE) {
+            /* a reader may be in poll rather than pipe_read, tell it about what is there */
+            spin_unlock(&p->lock);
+            poll_wake();
+            spin_lock(&p->lock);
+            if (p->tail - p->head == PIPE_SIZE && p->readers != 0)
+                sleep_on(&p->waiters, &p->lock);
+            continue;
+        }
+
+        n = PIPE_SIZE - (p->tail - p->head);
+        if (n > (uint32_t)(nbytes - written))
+            n = nbytes - written;
+        first = PIPE_SIZE - (p->tail & PIPE_MASK);
+        if (first > n)
+            first = n;
+        memcpy(&p->buf[p->tail & PIPE_MASK], (const uint8_t*)buf + written, first);
+        memcpy(p->buf, (const uint8_t*)buf + written + first, n - first);
+        p->tail += n;
+        written += n;
+
+        /* data for blocked readers */
+        wake_up(&p->waiters);
+    }
+    spin_unlock_irqrestore(&p->lock, flags);
+    if (written > 0)
+        poll_wake();
+
+    if (written == 0 && nbytes > 0)
+        return -1;
+    return written;
+}
+
+/* pipe_poll_read
+ *   Inputs: fd - read end
+ *   Return Value: POLLIN if read would not block (data, or end of file), else 0
+ *   Function: poll_func of the read end */
+static int32_t pipe_poll_read(int32_t fd){
+    uint32_t flags;
+    int32_t ready;
+    pipe_t* p = fd_pipe(fd);
+
+    spin_lock_irqsave(&p->lock, flags);
+    ready = (p->tail != p->head || p->writers == 0) ? POLLIN : 0;
+    spin_unlock_irqrestore(&p->lock, flags);
+    return ready;
+}
+
+/* pipe_poll_write
+ *   Inputs: fd - write end
+ *   Return Value: POLLOUT if write would not block (room, or no reader left to fail on), else 0
+ *   Function: poll_func of the write end */
+static int32_t pipe_poll_write(int32_t fd){
+    uint32_t flags;
+    int32_t ready;
+    pipe_t* p = fd_pipe(fd);
+
+    spin_lock_irqsave(&p->lock, flags);
+    ready = (p->tail - p->head != PIPE_SIZE || p->readers == 0) ? POLLOUT : 0;
+    spin_unlock_irqrestore(&p->lock, flags);
+    return ready;
+}
+
+/* pipe_close_read
+ *   Inputs: fd - read end
+ *   Return Value: 0 on success, -1 if fd is not open
+ *   Function: drops the reference, writers blocked on a full pipe fail once the last one is gone */
+static int32_t pipe_close_read(int32_t fd){
+    uint32_t flags;
+    pipe_t* p = fd_pipe(fd);
+
+    spin_lock_irqsave(&p->lock, flags);
+    p->readers--;
+    wake_up(&p->waiters);
+    spin_unlock_irqrestore(&p->lock, flags);
+    poll_wake();
+    return remove_from_file_array(fd);
+}
+
+/* pipe_close_write
+ *   Inputs: fd - write end
+ *   Return Value: 0 on success, -1 if fd is not open
+ *   Function: drops the reference, readers see end of file once the last one is gone */
+static int32_t pipe_close_write(int32_t fd){
+    uint32_t flags;
+    pipe_t* p = fd_pipe(fd);
+
+    spin_lock_irqsave(&p->lock, flags);
+    p->writers--;
+    wake_up(&p->waiters);
+    spin_unlock_irqrestore(&p->lock, flags);
+    poll_wake();
+    return remove_from_file_array(fd);
+}
+
+/* pipe_bad_read
+ *   Inputs: fd, buf, nbytes (not used)
+ *   Return Value: -1
+ *   Function: the write end cannot be read */
+static int32_t pipe_bad_read(int32_t fd, void* buf, int32_t nbytes){
+    return -1;
+}
+
+/* pipe_bad_write
+ *   Inputs: fd, buf, nbytes (not used)
+ *   Return Value: -1
+ *   Function: the read end cannot be written */
+static int32_t pipe_bad_write(int32_t fd, const void* buf, int32_t nbytes){
+    return -1;
+}
@@ -0,0 +1,30 @@
+#ifndef _PIPE_H
+#define _PIPE_H
+
+#include "types.h"
+#include "pcb.h"
+#include "spinlock.h"
+
+/* bytes buffered in each pipe, a power of two */
+#define PIPE_SIZE 4096
+#define PIPE_MASK (PIPE_SIZE - 1)
+/* pipes open at once, system wide */
+#define MAX_PIPES 8
+
+/* a kernel ring buffer with a read end and a write end. The ends' open files hold the pipe index as inode */
+typedef struct pipe_t{
+    uint8_t buf[PIPE_SIZE];
+    uint32_t head;              // bytes read so far, buf[head & PIPE_MASK] is the next one out
+    uint32_t tail;              // bytes written so far
+    uint32_t readers;           // open read ends, the pipe is free once both counts are 0
+    uint32_t writers;           // open write ends
+    volatile uint32_t waiters;  // pids blocked on this pipe, one bit each (see sleep_on)
+    spinlock_t lock;
+}pipe_t;
+
+extern file_op_func_t pipe_read_funcs;
+extern file_op_func_t pipe_write_funcs;
+
+extern int32_t pipe(int32_t* fds);
+
+#endif
@@ -16,25 +16,40 @@
 #include "excepts_s.h"
 #include "i8259.h"
 #include "scheduler.h"
+#include "timer.h"
+#include "smp.h"
+#include "apic.h"
+#include "kinfo.h"
 
 
-#define FREQ 20
 #define LOWER_BYTE_MASK 0xFF
 #define UPPER_BYTE_SHIFT 8
 #define PIT_COMMAND_PORT 0x43
 #define PIT_DATA_PORT 0x40
 
+volatile uint32_t pit_ticks = 0;
+
 void pit_init(){
-    uint32_t divisor = 1193180 / FREQ;
+    uint32_t divisor = 1193180 / PIT_FREQ;
     outb(0x36, PIT_COMMAND_PORT);  /* Set our command byte 0x36 */
     outb(divisor & LOWER_BYTE_MASK, PIT_DATA_PORT);  /* Set low byte of divisor */
-    outb((divisor >> UPPER_BYTE_SHIFT) && LOWER_BYTE_MASK, PIT_DATA_PORT);  /* Set high byte of divisor */
+    outb((divisor >> UPPER_BYTE_SHIFT) & LOWER_BYTE_MASK, PIT_DATA_PORT);  /* Set high byte of divisor */
     init_pit_idt();
     
 }
-void pit_int_handler(){
-    send_eoi(0);
+void pit_int_handler(irq_frame_t* frame){
+    irq_enter();
+    irq_eoi(PIT_IRQ);
     cli();
+    pit_ticks++;
+    kinfo_update();
+    account_tick(frame->cs);
+    timer_tick();
+    if (pit_ticks % PRESENT_TICKS == 0)
+        console_present();
+
+    /* only this cpu sees the PIT, pass the tick on to the others */
+    smp_tick_others();
     
     switch_process();
     
@@ -3,10 +3,26 @@
 
 #include "lib.h"
 #define PIT_IRQ 0
+#define PIT_FREQ 100        // scheduler ticks per second
+#define PIT_TICK_MS (1000 / PIT_FREQ)
 
+/* number of PIT ticks since boot */
+extern volatile uint32_t pit_ticks;
 
 void pit_init();
-void pit_int_handler();
+/* stack left by pit_int_link: pushfl, pushal, then the cpu's interrupt frame.
+ * user_esp/user_ss are only there when the interrupt came from user mode (cs & 3 == 3) */
+typedef struct irq_frame_t{
+    uint32_t flags;
+    uint32_t edi, esi, ebp, esp, ebx, edx, ecx, eax;
+    uint32_t eip;
+    uint32_t cs;
+    uint32_t eflags;
+    uint32_t user_esp;
+    uint32_t user_ss;
+}irq_frame_t;
+
+void pit_int_handler(irq_frame_t* frame);
 void init_pit_idt();
 
 
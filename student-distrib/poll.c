@@ -0,0 +1,105 @@
+/* poll.c - waiting on several file descriptors at once.
+ *
+ * Every file_op_func_t has a poll_func that says, without blocking, which of POLLIN/POLLOUT the fd
+ * is ready for. poll checks each fd under poll_lock and, if none is ready, sleeps on one system
+ * wide wait mask. Anything that can make an fd ready (an rtc tick, Enter, pipe data or space)
+ * calls poll_wake afterwards, and every poller checks its fds again. */
+
+#include "poll.h"
+#include "pcb.h"
+#include "scheduler.h"
+#include "signal.h"
+#include "pit.h"
+#include "lib.h"
+
+/* pids blocked in poll, one bit each (see sleep_on) */
+static volatile uint32_t poll_waiters = 0;
+
+/* held while checking fds and going to sleep, and by poll_wake, so no wakeup falls in between.
+ * Taken before any driver lock a poll_func takes, so drivers call poll_wake without their own */
+static spinlock_t poll_lock = SPINLOCK_INIT;
+
+/* poll_timeout
+ *   Inputs: pid - process whose poll timed out
+ *   Return Value: none
+ *   Function: timer callback, makes the poller runnable so it sees the timer has fired */
+static void poll_timeout(uint32_t pid){
+    pcb_ptr[pid]->sleeping = 0;
+}
+
+/* poll_scan
+ *   Inputs: fds - user pollfd array (already checked), nfds - entries
+ *   Return Value: number of entries with a non-zero revents
+ *   Function: fills in revents from each fd's poll_func */
+static int32_t poll_scan(pollfd_t* fds, uint32_t nfds){
+    file_arr_entry_t* file;
+    int32_t ready = 0;
+    uint32_t i;
+
+    for (i = 0; i < nfds; i++) {
+        file = fd_get(fds[i].fd);
+        if (file == NULL)
+            fds[i].revents = POLLNVAL;
+        else
+            fds[i].revents = file->file_op_tbl_ptr->poll_func(fds[i].fd) & fds[i].events;
+        if (fds[i].revents != 0)
+            ready++;
+    }
+    return ready;
+}
+
+/* poll
+ *   Inputs: fds - fds to wait on and the events wanted for each, nfds - entries,
+ *           timeout_ms - most time to wait, 0 to only check, negative to wait forever
+ *   Return Value: number of ready entries (revents set), 0 on timeout, -1 on bad arguments or if
+ *                 a signal came in first
+ *   Function: poll system call */
+int32_t poll(pollfd_t* fds, uint32_t nfds, int32_t timeout_ms){
+    pcb_entry_t* pcb = pcb_ptr[active_pid];
+    uint32_t flags;
+    int32_t ready;
+
+    if (nfds > POLL_MAX_FDS || bad_userspace_addr(fds, nfds * sizeof(pollfd_t)))
+        return -1;
+
+    if (timeout_ms > 0)
+        timer_add(&pcb->sleep_timer, pit_ticks + ms_to_ticks(timeout_ms), poll_timeout, active_pid);
+
+    spin_lock_irqsave(&poll_lock, flags);
+    while (1) {
+        ready = poll_scan(fds, nfds);
+        if (ready > 0 || timeout_ms == 0)
+            break;
+        if (timeout_ms > 0 && !pcb->sleep_timer.pending)
+            break;
+        if (signal_pending())
+            { ready = -1; break; }
+        sleep_on(&poll_waiters, &poll_lock);
+    }
+    spin_unlock_irqrestore(&poll_lock, flags);
+
+    if (timeout_ms > 0)
+        timer_del(&pcb->sleep_timer);
+    return ready;
+}
+
+/* poll_wake
+ *   Inputs: none
+ *   Return Value: none
+ *   Function: called after something may have become ready, every poller checks its fds again.
+ *             Safe from interrupt handlers; the caller must not hold a lock a poll_func takes */
+void poll_wake(){
+    uint32_t flags;
+
+    spin_lock_irqsave(&poll_lock, flags);
+    wake_up(&poll_waiters);
+    spin_unlock_irqrestore(&poll_lock, flags);
+}
+
+/* poll_always
+ *   Inputs: fd (not used)
+ *   Return Value: POLLIN | POLLOUT
+ *   Function: poll_func of files and directories, which never block */
+int32_t poll_always(int32_t fd){
+    return POLLIN | POLLOUT;
+}
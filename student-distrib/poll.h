@@ -0,0 +1,24 @@
+#ifndef _POLL_H
+#define _POLL_H
+
+#include "types.h"
+
+/* readiness bits, in pollfd_t events/revents and returned by file_op_func_t poll_func */
+#define POLLIN      0x01    // read would not block
+#define POLLOUT     0x04    // write would not block
+#define POLLNVAL    0x20    // fd is not open (revents only)
+
+/* most fds one poll call can wait on */
+#define POLL_MAX_FDS 32
+
+typedef struct pollfd_t{
+    int32_t fd;
+    int16_t events;         // what the caller waits for
+    int16_t revents;        // filled in: what is ready
+}pollfd_t;
+
+extern int32_t poll(pollfd_t* fds, uint32_t nfds, int32_t timeout_ms);
+extern void poll_wake();
+extern int32_t poll_always(int32_t fd);
+
+#endif
@@ -5,6 +5,9 @@
 #include "pcb.h"
 #include "terminal.h"
 #include "scheduler.h"
+#include "apic.h"
+#include "signal.h"
+#include "poll.h"
 
 extern void rtc_link(); 
 
@@ -111,12 +114,31 @@ int32_t rtc_close(int32_t fd){
 
 /* rtc_read
  *   Inputs: fd, buf, nbytes (none of these used)
- *   Return Value: 0 when read
- *    Function: reads from RTC by waiting for interrupt  */
+ *   Return Value: 0 when read, -1 if a signal has to be delivered first or, for an O_NONBLOCK fd,
+ *                 if no interrupt has come in since the last read
+ *    Function: reads from RTC by waiting for interrupt. An interrupt that poll already reported
+ *              on this fd counts, so poll then read does not wait a second time  */
 int32_t rtc_read(int32_t fd, void* buf, int32_t nbytes){
-    terminals[active_tid].INT_FLAG = 0;
+    file_arr_entry_t* entry = fd_get(fd);
+
+    /* O_NONBLOCK: take an interrupt that came in since the last read, if any */
+    if (entry->nonblock) {
+        if (!terminals[active_tid].INT_FLAG)
+            return -1;
+        terminals[active_tid].INT_FLAG = 0;
+        entry->file_pos = 0;
+        return 0;
+    }
+
+    /* a real-time process waiting for its next frame has finished this period's job */
+    rt_job_done();
+
+    if (!entry->file_pos)
+        terminals[active_tid].INT_FLAG = 0;
+    entry->file_pos = 0;
     while(terminals[active_tid].INT_FLAG == 0){
-        ;
+        if (signal_pending())
+            return -1;
     }
     terminals[active_tid].INT_FLAG = 0; 
     return 0;
@@ -143,34 +165,119 @@ int32_t rtc_write(int32_t fd, const void* buf, int32_t nbytes){
     return 0;
 }
 
+/* rtc_poll
+ *   Inputs: fd - rtc descriptor
+ *   Return Value: POLLIN once an interrupt has come in, POLLOUT always (writes never block)
+ *    Function: poll_func of the rtc. Marks the open file (file_pos is otherwise unused) so the next
+ *              read takes the interrupt poll saw instead of waiting for another */
+int32_t rtc_poll(int32_t fd){
+    if (!terminals[active_tid].INT_FLAG)
+        return POLLOUT;
+    fd_get(fd)->file_pos = 1;
+    return POLLIN | POLLOUT;
+}
+
+/* rtc_ack
+ *   Inputs: none
+ *   Return Value: none
+ *    Function: reads register C, without which the RTC raises no further interrupts */
+void rtc_ack(){
+    outb(RTC_C, RTC_CMD_PORT);
+    inb(RTC_DATA_PORT);
+}
+
+/* cmos_read
+ *   Inputs: reg - CMOS register, with the NMI-disable bit
+ *   Return Value: register contents */
+static uint8_t cmos_read(uint8_t reg){
+    outb(reg, RTC_CMD_PORT);
+    return inb(RTC_DATA_PORT);
+}
+
+/* rtc_read_time
+ *   Inputs: none
+ *   Return Value: seconds since 1970-01-01 00:00, taking the CMOS clock as UTC in 20xx
+ *    Function: reads the wall clock, waiting out an update in progress so the fields agree */
+uint32_t rtc_read_time(){
+    static const uint16_t days_before_month[12] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
+    uint32_t flags;
+    uint8_t sec, min, hour, day, mon, year, fmt;
+    uint32_t y, days;
+
+    cli_and_save(flags);
+    while (cmos_read(RTC_A) & RTC_A_UIP)
+        ;
+    sec = cmos_read(CMOS_SECONDS);
+    min = cmos_read(CMOS_MINUTES);
+    hour = cmos_read(CMOS_HOURS);
+    day = cmos_read(CMOS_DAY);
+    mon = cmos_read(CMOS_MONTH);
+    year = cmos_read(CMOS_YEAR);
+    fmt = cmos_read(RTC_B);
+    restore_flags(flags);
+
+    if (!(fmt & RTC_B_BINARY)) {
+        sec = (sec & 0x0F) + (sec >> 4) * 10;
+        min = (min & 0x0F) + (min >> 4) * 10;
+        hour = (hour & 0x0F) + ((hour & 0x70) >> 4) * 10 + (hour & RTC_HOUR_PM);
+        day = (day & 0x0F) + (day >> 4) * 10;
+        mon = (mon & 0x0F) + (mon >> 4) * 10;
+        year = (year & 0x0F) + (year >> 4) * 10;
+    }
+    if (!(fmt & RTC_B_24H) && (hour & RTC_HOUR_PM))
+        hour = ((hour & ~RTC_HOUR_PM) % 12) + 12;
+    else if (!(fmt & RTC_B_24H))
+        hour = hour % 12;
+    if (mon < 1 || mon > 12)
+        return 0;
+
+    y = 2000 + year;
+    days = (y - 1970) * 365
+         + ((y - 1) / 4 - 1969 / 4) - ((y - 1) / 100 - 1969 / 100) + ((y - 1) / 400 - 1969 / 400)
+         + days_before_month[mon - 1] + (day - 1);
+    if (mon > 2 && (y % 4 == 0 && (y % 100 != 0 || y % 400 == 0)))
+        days++;
+
+    return days * 86400 + hour * 3600 + min * 60 + sec;
+}
+
 /* rtc_handler
  *   Inputs: none
  *   Return Value: none
  *    Function: what to do during RTC interrupts */
 void rtc_handler(){
+    int ticked = 0;
+
+    irq_enter();
     cli();
     if(terminals[0].INT_COUNT > terminals[0].V_FREQ_NUM){
+        ticked = 1;
         terminals[0].INT_FLAG = 1;
         terminals[0].INT_COUNT = 0;
     }
     terminals[0].INT_COUNT++; //
 
     if(terminals[1].INT_COUNT > terminals[1].V_FREQ_NUM){
+        ticked = 1;
         terminals[1].INT_FLAG = 1;
         terminals[1].INT_COUNT = 0;
     }
     terminals[1].INT_COUNT++; //
 
     if(terminals[2].INT_COUNT > terminals[2].V_FREQ_NUM){
+        ticked = 1;
         terminals[2].INT_FLAG = 1;
         terminals[2].INT_COUNT = 0;
     }
     terminals[2].INT_COUNT++; //
 
-    outb(RTC_C, RTC_CMD_PORT);
-    inb(RTC_DATA_PORT);
+    /* pollers waiting on an rtc fd */
+    if (ticked)
+        poll_wake();
+
+    rtc_ack();
     // test_interrupts(); 
-    send_eoi(RTC_IRQ);
+    irq_eoi(RTC_IRQ);
     sti();
 
     
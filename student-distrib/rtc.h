@@ -6,6 +6,18 @@
 #define RTC_A 0x8A
 #define RTC_B 0x8B
 #define RTC_C 0x8C
+
+/* CMOS clock registers, NMI left disabled like the ones above */
+#define CMOS_SECONDS 0x80
+#define CMOS_MINUTES 0x82
+#define CMOS_HOURS   0x84
+#define CMOS_DAY     0x87
+#define CMOS_MONTH   0x88
+#define CMOS_YEAR    0x89
+#define RTC_A_UIP    0x80           // update in progress
+#define RTC_B_24H    0x02
+#define RTC_B_BINARY 0x04
+#define RTC_HOUR_PM  0x80
 #define RTC_IRQ 8
 
 #include "types.h"
@@ -13,6 +25,8 @@
 void rtc_init();
 uint8_t freq_to_rate(uint16_t freq);
 void rtc_set_freq(uint16_t freq);
+void rtc_ack();
+uint32_t rtc_read_time();
 
 extern void rtc_handler();
 
@@ -20,5 +34,6 @@ extern int32_t rtc_open(const uint8_t* filename);
 extern int32_t rtc_close(int32_t fd);
 extern int32_t rtc_read(int32_t fd, void* buf, int32_t nbytes);
 extern int32_t rtc_write(int32_t fd, const void* buf, int32_t nbytes);
+extern int32_t rtc_poll(int32_t fd);
 
 #endif
@@ -7,81 +7,490 @@
 #include "lib.h"
 #include "x86_desc.h"
 #include "i8259.h"
+#include "pit.h"
+#include "fpu.h"
+#include "kinfo.h"
+#include "spinlock.h"
 
-/* Current PID for each terminal (what is the highest process for each terminal) */
+/* Current PID for each terminal (what is the highest process for each terminal). Processes
+ * started with spawn run alongside it without ever becoming it */
 int32_t term_cur_pid[3] = {-1,-1,-1};
 
-volatile int32_t active_pid = -1; 
-volatile int32_t active_tid = -1;
 uint8_t base_shells_opened = 0;
 
+/* Each cpu schedules only the processes of the terminals bound to it (cpu_t.terminals), so run
+ * queue, round robin position, real-time admission and the saved boot context all live in cpus[]
+ * (smp.h). term_cur_pid[t] and the pcbs of terminal t are only written by the cpu that owns t. */
 
+static int32_t schedule();
 
 
-/* switch_process
+/* ms_to_ticks
+ *   Inputs: ms - time in milliseconds
+ *   Return Value: number of PIT ticks, rounded up
+ *   Function: converts milliseconds to scheduler ticks */
+uint32_t ms_to_ticks(uint32_t ms) {
+    /* not (ms + PIT_TICK_MS - 1) / PIT_TICK_MS, which wraps for ms near 2^32 */
+    return ms / PIT_TICK_MS + (ms % PIT_TICK_MS != 0);
+}
+
+/* rt_update
  *   Inputs: none
- *   Return Value: none. "return" used to switch into next process
- *   Function: switches to next process in round-robin fashion when pit interrrupt occurs */
-int32_t switch_process() {
-    /* Get next terminal */
-    int next_term = (active_tid+1)%NUM_TERMINALS;
-    remap_vidmem(next_term);
-    
-    /* Save EBP/ESP of the current process */
-    register uint32_t s_esp asm("%esp");
-    register uint32_t s_ebp asm("%ebp");
-
-    /* Set up new process */
-    if (term_cur_pid[next_term] == -1) { // No process currently running on this terminal
-        // First process context does not need to be stored (switching from kernel)
-        if (next_term != 0) {
-            // Store current process context (so that can return later)
-            pcb_ptr[active_pid]->esp = (uint32_t)s_esp;
-            pcb_ptr[active_pid]->ebp = (uint32_t)s_ebp;
+ *   Return Value: none
+ *   Function: Charges the tick that just ended to the running real-time job, then releases a new job
+ *             for every runnable real-time process whose period rolled over. A job that is still active
+ *             when its successor is released has missed its deadline. */
+static void rt_update() {
+    int i;
+    rt_params_t* rt;
+    cpu_t* cpu = this_cpu();
+
+    if (active_pid >= 0) {
+        rt = &pcb_ptr[active_pid]->rt;
+        if (rt->period != 0 && rt->job_active && rt->remaining > 0)
+            rt->remaining--;
+    }
+
+    for (i = 0; i < MAX_PROCESSES; i++) {
+        rt = &pcb_ptr[i]->rt;
+
+        /* parents waiting on a child cannot run and are not charged misses */
+        if (pcb_ptr[i]->pid_in_use == 0 || pcb_ptr[i]->current == 0 || rt->period == 0)
+            continue;
+        if (!cpu_owns(cpu, pcb_ptr[i]->t_id))
+            continue;
+        if ((int32_t)(pit_ticks - rt->next_release) < 0)
+            continue;
+
+        if (rt->job_active)
+            rt->misses++;
+
+        rt->job_active = 1;
+        rt->remaining = rt->budget;
+        rt->releases++;
+        rt->next_release += rt->period;
+
+        /* fell more than a period behind (process was blocked on a child), restart the phase now */
+        if ((int32_t)(pit_ticks - rt->next_release) >= 0)
+            rt->next_release = pit_ticks + rt->period;
+        rt->deadline = rt->next_release;
+    }
+}
+
+/* runnable
+ *   Inputs: pid - process id
+ *   Return Value: 1 if the process can run on this cpu, 0 otherwise
+ *   Function: a process runs unless it is free, waiting on a child (current == 0), sleeping, or on
+ *             a terminal of another cpu */
+static int32_t runnable(int32_t pid) {
+    pcb_entry_t* pcb = pcb_ptr[pid];
+
+    return pcb->pid_in_use && pcb->current && !pcb->sleeping && cpu_owns(this_cpu(), pcb->t_id);
+}
+
+/* unstarted_terminal
+ *   Inputs: none
+ *   Return Value: a terminal of this cpu with no base shell yet, -1 if there is none
+ *   Function: base shells are started in order on the first ticks */
+static int32_t unstarted_terminal() {
+    int32_t t;
+
+    for (t = 0; t < NUM_TERMINALS; t++) {
+        if (cpu_owns(this_cpu(), t) && term_cur_pid[t] == -1)
+            return t;
+    }
+    return -1;
+}
+
+/* pick_next_pid
+ *   Inputs: none
+ *   Return Value: process that should run next, out of this cpu's terminals
+ *   Function: Real-time jobs with budget left run first, earliest deadline first. Otherwise runnable
+ *             processes are served round robin, SCHED_QUANTUM_TICKS at a time. */
+static int32_t pick_next_pid() {
+    int32_t i, pid;
+    int32_t best = -1;
+    rt_params_t* rt;
+    cpu_t* cpu = this_cpu();
+
+    for (pid = 0; pid < MAX_PROCESSES; pid++) {
+        if (!runnable(pid))
+            continue;
+        rt = &pcb_ptr[pid]->rt;
+        if (rt->period == 0 || !rt->job_active || rt->remaining == 0)
+            continue;
+        if (best == -1 || (int32_t)(rt->deadline - pcb_ptr[best]->rt.deadline) < 0)
+            best = pid;
+    }
+    if (best != -1)
+        return best;
+
+    if (cpu->quantum_left == 0 || cpu->be_pid < 0 || !runnable(cpu->be_pid)) {
+        for (i = 1; i <= MAX_PROCESSES; i++) {
+            pid = (cpu->be_pid+i+MAX_PROCESSES)%MAX_PROCESSES;
+            if (runnable(pid))
+                break;
         }
-        
-        // set next active tid/pid and set in use flag
-        active_tid = next_term;
-        active_pid++;
-
-        // Start new process
-        cur_terminal = next_term;
-        printf("Starting shell %d\n", active_pid);
-        execute((const uint8_t*)"shell");
+        /* everyone is asleep (or this cpu has no terminals), stay where we are until a timer fires */
+        if (i > MAX_PROCESSES)
+            return active_pid;
+
+        cpu->be_pid = pid;
+        cpu->quantum_left = SCHED_QUANTUM_TICKS;
+    }
+    cpu->quantum_left--;
+    return cpu->be_pid;
+}
+
+/* rt_clear
+ *   Inputs: pid - process to return to best-effort scheduling
+ *   Return Value: none
+ *   Function: drops the real-time reservation of a process and gives its utilization back */
+void rt_clear(int32_t pid) {
+    rt_params_t* rt = &pcb_ptr[pid]->rt;
+
+    if (rt->period != 0)
+        this_cpu()->rt_util -= rt->util;
+
+    rt->period = 0;
+    rt->budget = 0;
+    rt->util = 0;
+    rt->job_active = 0;
+    rt->remaining = 0;
+}
+
+/* rt_job_done
+ *   Inputs: none
+ *   Return Value: none
+ *   Function: called when a real-time process starts waiting for its next frame (rtc_read).
+ *             Marks the current job complete so it is not counted as a deadline miss. */
+void rt_job_done() {
+    if (active_pid >= 0 && pcb_ptr[active_pid]->rt.period != 0)
+        pcb_ptr[active_pid]->rt.job_active = 0;
+}
+
+/* sched_setrt
+ *   Inputs: period_ms - length of each period, 0 to go back to best-effort
+ *           budget_ms - cpu time needed in each period
+ *   Return Value: 0 on success, -1 if the parameters are invalid or the cpu would be overloaded
+ *   Function: Puts the current process in the real-time class. The first job is released immediately. */
+int32_t sched_setrt(uint32_t period_ms, uint32_t budget_ms) {
+    uint32_t flags;
+    uint32_t period, budget, util;
+    rt_params_t* rt = &pcb_ptr[active_pid]->rt;
+    cpu_t* cpu = this_cpu();
+
+    if (period_ms == 0) {
+        cli_and_save(flags);
+        rt_clear(active_pid);
+        restore_flags(flags);
         return 0;
+    }
+
+    period = ms_to_ticks(period_ms);
+    budget = ms_to_ticks(budget_ms);
+    if (budget == 0 || budget > period)
+        return -1;
+    util = (budget * RT_UTIL_SCALE) / period;
+
+    cli_and_save(flags);
+
+    /* EDF meets every deadline while total utilization stays <= 100%, leave headroom for best-effort work.
+     * Real-time processes stay on their terminal's cpu (partitioned EDF), so admission is per cpu */
+    if (cpu->rt_util - rt->util + util > RT_UTIL_MAX)
+        { restore_flags(flags); return -1; }
+
+    cpu->rt_util = cpu->rt_util - rt->util + util;
+    rt->period = period;
+    rt->budget = budget;
+    rt->util = util;
+    rt->releases = 1;
+    rt->misses = 0;
+    rt->job_active = 1;
+    rt->remaining = budget;
+    rt->next_release = pit_ticks + period;
+    rt->deadline = rt->next_release;
+
+    restore_flags(flags);
+    return 0;
+}
+
+/* sched_getrt
+ *   Inputs: stat - user struct to fill in
+ *   Return Value: 0 on success, -1 on bad pointer
+ *   Function: reports the real-time parameters and deadline-miss count of the current process */
+int32_t sched_getrt(rt_stat_t* stat) {
+    rt_params_t* rt = &pcb_ptr[active_pid]->rt;
+
+    if (bad_userspace_addr(stat, sizeof(rt_stat_t)))
+        return -1;
+
+    stat->period_ms = rt->period * PIT_TICK_MS;
+    stat->budget_ms = rt->budget * PIT_TICK_MS;
+    stat->releases = rt->releases;
+    stat->misses = rt->misses;
+    return 0;
+}
+
+
+/* sleep_wakeup
+ *   Inputs: pid - process whose sleep timer fired
+ *   Return Value: none
+ *   Function: timer callback, makes a sleeping process runnable again */
+static void sleep_wakeup(uint32_t pid) {
+    pcb_ptr[pid]->sleeping = 0;
+}
+
+/* sleep_ticks
+ *   Inputs: ticks - number of pit ticks to sleep for
+ *   Return Value: ticks left if woken early, else 0
+ *   Function: Blocks the current process on its sleep timer. The scheduler skips it until the timer
+ *             fires; if nothing else is runnable the cpu halts until the next interrupt. */
+uint32_t sleep_ticks(uint32_t ticks) {
+    uint32_t flags;
+    uint32_t left = 0;
+    pcb_entry_t* pcb = pcb_ptr[active_pid];
+
+    cli_and_save(flags);
+
+    rt_job_done();
+    pcb->sleeping = 1;
+    timer_add(&pcb->sleep_timer, pit_ticks + ticks, sleep_wakeup, active_pid);
+
+    while (pcb->sleeping) {
+        this_cpu()->quantum_left = 0;
+        schedule();
+        if (pcb->sleeping)
+            asm volatile("sti; hlt; cli" : : : "memory");
+    }
+
+    /* woken by something other than the timer */
+    if (timer_del(&pcb->sleep_timer))
+        left = pcb->sleep_timer.expires - pit_ticks;
+
+    restore_flags(flags);
+    return left;
+}
+
+/* sleep
+ *   Inputs: ms - milliseconds to sleep
+ *   Return Value: 0 on success, -1 if woken early
+ *   Function: sleep system call, rounds up to whole pit ticks */
+int32_t sleep(uint32_t ms) {
+    uint32_t ticks;
+
+    if (ms == 0)
+        return yield();
+
+    /* same cap as nanosleep, so the expiry stays comparable with pit_ticks */
+    ticks = ms_to_ticks(ms);
+    if (ticks > 0x7FFFFFFF)
+        ticks = 0x7FFFFFFF;
+    return (sleep_ticks(ticks) == 0) ? 0 : -1;
+}
+
+/* nanosleep
+ *   Inputs: req - time to sleep, rem - if not NULL, filled with time left when woken early
+ *   Return Value: 0 on success, -1 on bad arguments or if woken early
+ *   Function: nanosleep system call. Resolution is one pit tick */
+int32_t nanosleep(const timespec_t* req, timespec_t* rem) {
+    uint32_t ticks, left;
+    uint32_t ns_per_tick = NS_PER_SEC / PIT_FREQ;
+
+    if (bad_userspace_addr(req, sizeof(timespec_t)) || req->tv_nsec >= NS_PER_SEC)
+        return -1;
+    if (rem != NULL && bad_userspace_addr(rem, sizeof(timespec_t)))
+        return -1;
+
+    /* cap at ~24 days so the tick count cannot wrap */
+    if (req->tv_sec > 0x7FFFFFFF / PIT_FREQ - 1)
+        ticks = 0x7FFFFFFF;
+    else
+        ticks = req->tv_sec * PIT_FREQ + (req->tv_nsec + ns_per_tick - 1) / ns_per_tick;
+
+    if (ticks == 0)
+        return yield();
+
+    left = sleep_ticks(ticks);
+    if (rem != NULL) {
+        rem->tv_sec = left / PIT_FREQ;
+        rem->tv_nsec = (left % PIT_FREQ) * ns_per_tick;
+    }
+    return (left == 0) ? 0 : -1;
+}
+
+/* yield
+ *   Inputs: none
+ *   Return Value: 0
+ *   Function: gives up the rest of the current time slice (and ends a real-time job) */
+int32_t yield() {
+    uint32_t flags;
+    cli_and_save(flags);
+
+    rt_job_done();
+    this_cpu()->quantum_left = 0;
+    schedule();
+
+    restore_flags(flags);
+    return 0;
+}
+
+
+/* switch_process
+ *   Inputs: none
+ *   Return Value: none
+ *   Function: called on every pit interrupt. Charges the tick to real-time jobs and reschedules */
+int32_t switch_process() {
+    rt_update();
+    return schedule();
+}
+
+/* start_base_shell
+ *   Inputs: none
+ *   Return Value: none, never returns
+ *   Function: first code run in a base shell's kernel context, on that shell's own kernel stack */
+static void start_base_shell() {
+    printf("Starting shell %d\n", active_pid);
+    execute((const uint8_t*)"shell");
+}
+
+/* reap_dead
+ *   Inputs: none
+ *   Return Value: none
+ *   Function: frees the pid of a spawned process that exited on this cpu, once something else is
+ *             running and its kernel stack is no longer in use. Called with interrupts off */
+static void reap_dead() {
+    cpu_t* cpu = this_cpu();
+
+    if (cpu->dead_pid < 0 || cpu->dead_pid == active_pid)
+        return;
+
+    spin_lock(&pcb_lock);
+    pcb_ptr[cpu->dead_pid]->pid_in_use = 0;
+    spin_unlock(&pcb_lock);
+    cpu->dead_pid = -1;
+}
+
+/* schedule
+ *   Inputs: none
+ *   Return Value: 0
+ *   Function: Picks the next process (pick_next_pid), or starts a terminal's base shell. When the
+ *             pick changes, points paging and the TSS at the next process and switches kernel
+ *             context with switch_to. Returns once this process is scheduled again. */
+static int32_t schedule() {
+    int next_term, next_pid;
+    uint32_t flags;
+    uint32_t* stack_top;
+    context_t* prev_ctx;
+    context_t* next_ctx;
+
+    cli_and_save(flags);
+    reap_dead();
+
+    /* Get next process */
+    next_term = unstarted_terminal();
+    next_pid = (next_term == -1) ? pick_next_pid() : next_term;
+    if (next_pid == active_pid)
+        { restore_flags(flags); return 0; }
+    if (next_term == -1)
+        next_term = pcb_ptr[next_pid]->t_id;
+
+    /* the boot context is never resumed, it just needs somewhere to be saved */
+    prev_ctx = (active_pid == -1) ? &this_cpu()->boot_context : &pcb_ptr[active_pid]->context;
+
+    active_tid = next_term;
+    active_pid = next_pid;
+
+    if (term_cur_pid[next_term] == -1) {
+        /* No process on this terminal yet: start its base shell in a fresh context at the top of
+         * its own kernel stack (execute sets up paging and the TSS). Base shell pid == terminal id */
+        stack_top = (uint32_t*)(EIGHT_MB - active_pid*EIGHT_KB) - 1;
+        *stack_top = 0;                                 // dummy return address
+        next_ctx = &pcb_ptr[active_pid]->context;
+        next_ctx->esp = (uint32_t)stack_top;
+        next_ctx->ebp = 0;
+        next_ctx->eip = (uint32_t)start_base_shell;
     } else {
-        // Store current process context (so that can return later)
-        pcb_ptr[active_pid]->esp = (uint32_t)s_esp;
-        pcb_ptr[active_pid]->ebp = (uint32_t)s_ebp;
-        
-        // set next active tid/pid and set in use flag
-        active_tid = next_term;
-        active_pid = term_cur_pid[active_tid];
-        
+        next_ctx = &pcb_ptr[active_pid]->context;
+
+        // change PID page base address, and the vidmap page (kernel output needs no remapping)
+        page_dir[32].page_dir_entry_4mb_t.page_base_address = ((EIGHT_MB + (active_pid*FOUR_MB)) >> 22); // align the page_table address to 4MB boundary
+        vidmap_sync(active_pid);
+        flush_tlb();
+
+        /* Set TSS entries */
+        set_kernel_stack(EIGHT_MB - (active_pid)*EIGHT_KB);
     }
+    kinfo_update();
 
-    // change PID page base address
-    page_dir[32].page_dir_entry_4mb_t.page_base_address = ((EIGHT_MB + (active_pid*FOUR_MB)) >> 22); // align the page_table address to 4MB boundary
-    flush_tlb();
-
-    
-    /* Set TSS entries */
-    tss.ss0 = KERNEL_DS;
-    tss.esp0 = (EIGHT_MB - (active_pid)*EIGHT_KB);
-
-    // get esp, ebp, and eip of next process
-    register uint32_t new_esp = pcb_ptr[active_pid]->esp;
-    register uint32_t new_ebp = pcb_ptr[active_pid]->ebp;
-
-    // do context switch
-    asm volatile(
-        "movl %0, %%esp; \n"            // switch to new esp
-        "movl %1, %%ebp; \n"            // switch to new ebp
-
-        :                                       
-        : "g" (new_esp), "g" (new_ebp)
-        : "memory", "cc", "ecx"
-    );
-    send_eoi(0);
+    /* trap the next fpu instruction unless this process still owns the fpu */
+    fpu_switch(active_pid);
+
+    switch_to(prev_ctx, next_ctx);
+
+    /* scheduled again */
+    restore_flags(flags);
     return 0;
 }
+
+/* proc_exit
+ *   Inputs: none
+ *   Return Value: none, never returns
+ *   Function: end of a process started with spawn, which has no execute of its parent to return
+ *             to. halt has already released everything but the pid and this kernel stack; the
+ *             stack is still in use here, so the pid is freed by the next schedule on this cpu
+ *             that runs something else (reap_dead) */
+void proc_exit() {
+    pcb_entry_t* pcb = pcb_ptr[active_pid];
+
+    cli();
+    reap_dead();
+    pcb->current = 0;
+    pcb->sleeping = 1;
+    this_cpu()->dead_pid = active_pid;
+
+    while (1) {
+        this_cpu()->quantum_left = 0;
+        schedule();
+        asm volatile("sti; hlt; cli" : : : "memory");
+    }
+}
+
+/* sleep_on
+ *   Inputs: waiters - wait mask to add the current process to, lock - held by the caller with
+ *                     interrupts off; dropped while blocked and taken again before returning
+ *   Return Value: none
+ *   Function: Blocks until wake_up(waiters) or a signal. The caller checks its condition under
+ *             lock before calling and again after, so a wake_up in between is never lost */
+void sleep_on(volatile uint32_t* waiters, spinlock_t* lock) {
+    pcb_entry_t* pcb = pcb_ptr[active_pid];
+
+    pcb->sleeping = 1;
+    asm volatile("lock orl %1, %0" : "+m"(*waiters) : "r"(1 << active_pid) : "memory");
+    spin_unlock(lock);
+
+    while (pcb->sleeping) {
+        this_cpu()->quantum_left = 0;
+        schedule();
+        if (pcb->sleeping)
+            asm volatile("sti; hlt; cli" : : : "memory");
+    }
+
+    /* woken by a signal, stop listening */
+    asm volatile("lock andl %1, %0" : "+m"(*waiters) : "r"(~(1 << active_pid)) : "memory");
+    spin_lock(lock);
+}
+
+/* wake_up
+ *   Inputs: waiters - wait mask
+ *   Return Value: none
+ *   Function: makes every process blocked in sleep_on(waiters) runnable again */
+void wake_up(volatile uint32_t* waiters) {
+    int32_t pid;
+    uint32_t mask = xchg(waiters, 0);
+
+    for (pid = 0; pid < MAX_PROCESSES; pid++) {
+        if (mask & (1 << pid))
+            pcb_ptr[pid]->sleeping = 0;
+    }
+}
@@ -2,13 +2,48 @@
 #define _SCHEDULER_H
 
 #include "lib.h"
+#include "timer.h"
+#include "smp.h"
+#include "spinlock.h"
 
-extern volatile int32_t active_pid;
-extern volatile int32_t active_tid;
+/* best-effort time slice, in PIT ticks */
+#define SCHED_QUANTUM_TICKS 5
+
+/* real-time utilization is fixed point, RT_UTIL_SCALE == 100% of one cpu.
+ * Admission stops at ~90% so the base shells always get some time */
+#define RT_UTIL_SCALE 1024
+#define RT_UTIL_MAX 922
+
+/* real-time status reported to user programs by sched_getrt */
+typedef struct rt_stat_t{
+    uint32_t period_ms;
+    uint32_t budget_ms;
+    uint32_t releases;
+    uint32_t misses;
+}rt_stat_t;
+
+/* process and terminal running on the executing cpu */
+#define active_pid (this_cpu()->pid)
+#define active_tid (this_cpu()->tid)
 extern int32_t term_cur_pid[3];
 
 extern int32_t switch_process();
 
+extern int32_t sched_setrt(uint32_t period_ms, uint32_t budget_ms);
+extern int32_t sched_getrt(rt_stat_t* stat);
+extern void rt_clear(int32_t pid);
+extern void rt_job_done();
+
+extern uint32_t ms_to_ticks(uint32_t ms);
+extern uint32_t sleep_ticks(uint32_t ticks);
+extern int32_t sleep(uint32_t ms);
+extern int32_t nanosleep(const timespec_t* req, timespec_t* rem);
+extern int32_t yield();
+
+extern void proc_exit();
+extern void sleep_on(volatile uint32_t* waiters, spinlock_t* lock);
+extern void wake_up(volatile uint32_t* waiters);
+
 extern uint8_t base_shells_opened;
 
 #endif
@@ -0,0 +1,307 @@
+/* serial.c - the 16550 UART on COM1, as the "ttyS0" device.
+ *
+ * Bytes go out through a SERIAL_TX_SIZE ring: write queues them and, if the transmitter is
+ * idle, starts it with one FIFO's worth; each transmit interrupt (FIFO empty) then sends the
+ * next UART_FIFO_SIZE bytes, and turns itself off once the ring is drained. Received bytes are
+ * moved from the FIFO into a SERIAL_RX_SIZE ring by the interrupt and dropped when it is full.
+ * Blocking and poll work like pipes. The kernel log is copied here as well (see klog.c), so a
+ * headless run (qemu -serial stdio, or file:) keeps its log and whatever programs write here. */
+
+#include "serial.h"
+#include "x86_desc.h"
+#include "lib.h"
+#include "i8259.h"
+#include "apic.h"
+#include "scheduler.h"
+#include "signal.h"
+#include "poll.h"
+#include "spinlock.h"
+
+extern void serial_link();
+
+static int32_t serial_read(int32_t fd, void* buf, int32_t nbytes);
+static int32_t serial_write(int32_t fd, const void* buf, int32_t nbytes);
+static int32_t serial_close(int32_t fd);
+static int32_t serial_poll(int32_t fd);
+
+file_op_func_t serial_funcs = { serial_close, serial_read, serial_write, serial_poll };
+
+static uint8_t tx_buf[SERIAL_TX_SIZE];
+static uint8_t rx_buf[SERIAL_RX_SIZE];
+static volatile uint32_t tx_head, tx_tail;     // bytes sent to the UART / queued so far
+static volatile uint32_t rx_head, rx_tail;     // bytes read / received so far
+
+static uint8_t ier;                     // what the interrupt enable register is set to
+static int32_t serial_present = 0;      // set once the UART is found and programmed
+
+/* pids blocked on a full transmit ring or an empty receive ring (see sleep_on) */
+static volatile uint32_t serial_waiters = 0;
+/* protects the rings and the UART registers */
+static spinlock_t serial_lock = SPINLOCK_INIT;
+
+/* serial_init
+ *   Inputs: none
+ *   Return Value: none
+ *   Function: programs COM1 for 115200 8N1 with FIFOs and the receive interrupt, if there is a
+ *             UART there (its scratch register keeps what is written to it) */
+void serial_init() {
+    outb(0xAE, COM1_PORT + UART_SCR);
+    if (inb(COM1_PORT + UART_SCR) != 0xAE)
+        return;
+
+    outb(0, COM1_PORT + UART_IER);
+    outb(LCR_DLAB, COM1_PORT + UART_LCR);
+    outb(SERIAL_DIVISOR & 0xFF, COM1_PORT + UART_DLL);
+    outb(SERIAL_DIVISOR >> 8, COM1_PORT + UART_DLM);
+    outb(LCR_8N1, COM1_PORT + UART_LCR);
+    outb(FCR_ENABLE, COM1_PORT + UART_IIR);
+    outb(MCR_IRQ, COM1_PORT + UART_MCR);
+
+    // put interrupt gate in idt, the same kind as the keyboard's
+    idt[SERIAL_VECTOR].present = 1;
+    idt[SERIAL_VECTOR].dpl = 0;
+    idt[SERIAL_VECTOR].reserved0 = 0;
+    idt[SERIAL_VECTOR].size = 1;
+    idt[SERIAL_VECTOR].reserved1 = 1;
+    idt[SERIAL_VECTOR].reserved2 = 1;
+    idt[SERIAL_VECTOR].reserved3 = 0;
+    idt[SERIAL_VECTOR].reserved4 = 0;
+    idt[SERIAL_VECTOR].seg_selector = KERNEL_CS;
+    SET_IDT_ENTRY(idt[SERIAL_VECTOR], serial_link);
+
+    /* nothing stale pending */
+    inb(COM1_PORT + UART_LSR);
+    inb(COM1_PORT + UART_DATA);
+    inb(COM1_PORT + UART_IIR);
+    inb(COM1_PORT + UART_MSR);
+
+    ier = IER_RX;
+    outb(ier, COM1_PORT + UART_IER);
+    serial_present = 1;
+}
+
+/* tx_burst
+ *   Inputs: none
+ *   Return Value: none
+ *   Function: with serial_lock held and the transmit FIFO empty, moves up to a FIFO's worth of
+ *             the ring into it. The transmit interrupt stays on while anything was sent, so the
+ *             next burst follows when the FIFO runs dry */
+static void tx_burst() {
+    int32_t i;
+
+    if (tx_head == tx_tail) {
+        ier &= ~IER_TX;
+    } else {
+        for (i = 0; i < UART_FIFO_SIZE && tx_head != tx_tail; i++) {
+            outb(tx_buf[tx_head % SERIAL_TX_SIZE], COM1_PORT + UART_DATA);
+            tx_head++;
+        }
+        ier |= IER_TX;
+    }
+    outb(ier, COM1_PORT + UART_IER);
+}
+
+/* tx_start
+ *   Inputs: none
+ *   Return Value: none
+ *   Function: with serial_lock held, after queueing: starts the transmitter if it is idle. While
+ *             it is running the next transmit interrupt picks the new bytes up */
+static void tx_start() {
+    if (!(ier & IER_TX))
+        tx_burst();
+}
+
+/* serial_service
+ *   Inputs: none
+ *   Return Value: 1 if a ring changed (a reader, writer or poller may want to know), else 0
+ *   Function: with serial_lock held, handles everything the UART has pending */
+static int32_t serial_service() {
+    int32_t changed = 0;
+    uint8_t iir, c;
+
+    while (!((iir = inb(COM1_PORT + UART_IIR)) & IIR_NONE)) {
+        switch (iir & IIR_ID) {
+            case IIR_RX:
+            case IIR_TIMEOUT:
+                while (inb(COM1_PORT + UART_LSR) & LSR_DR) {
+                    c = inb(COM1_PORT + UART_DATA);
+                    if (rx_tail - rx_head < SERIAL_RX_SIZE) {
+                        rx_buf[rx_tail % SERIAL_RX_SIZE] = c;
+                        rx_tail++;
+                    }
+                }
+                changed = 1;
+                break;
+            case IIR_THRE:
+                tx_burst();
+                changed = 1;
+                break;
+            case IIR_LSR:
+                inb(COM1_PORT + UART_LSR);
+                break;
+            default:
+                inb(COM1_PORT + UART_MSR);
+                break;
+        }
+    }
+    return changed;
+}
+
+/* serial_handler
+ *   Inputs: none
+ *   Return Value: none
+ *   Function: COM1 interrupt, moves received bytes in and the next burst out */
+void serial_handler() {
+    int32_t changed;
+
+    irq_enter();
+    spin_lock(&serial_lock);
+    changed = serial_service();
+    if (changed)
+        wake_up(&serial_waiters);
+    spin_unlock(&serial_lock);
+    if (changed)
+        poll_wake();
+    irq_eoi(SERIAL_IRQ);
+}
+
+/* serial_ack
+ *   Inputs: none
+ *   Return Value: none
+ *   Function: after apic_route_irq moves IRQ4, handles whatever came in while it was masked */
+void serial_ack() {
+    uint32_t flags;
+    int32_t changed;
+
+    if (!serial_present)
+        return;
+    spin_lock_irqsave(&serial_lock, flags);
+    changed = serial_service();
+    if ((ier & IER_TX) && (inb(COM1_PORT + UART_LSR) & LSR_THRE))
+        { tx_burst(); changed = 1; }
+    if (changed)
+        wake_up(&serial_waiters);
+    spin_unlock_irqrestore(&serial_lock, flags);
+    if (changed)
+        poll_wake();
+}
+
+/* serial_open
+ *   Inputs: filename (not used)
+ *   Return Value: fd, -1 if there is no UART or no free fd
+ *   Function: open of "ttyS0", which has no file system entry */
+int32_t serial_open(const uint8_t* filename) {
+    if (!serial_present)
+        return -1;
+    return insert_into_file_array(&serial_funcs, -1);
+}
+
+/* serial_close
+ *   Inputs: fd
+ *   Return Value: 0 on success, -1 if fd is not open
+ *   Function: close of the device, queued output is still sent */
+static int32_t serial_close(int32_t fd) {
+    return remove_from_file_array(fd);
+}
+
+/* serial_read
+ *   Inputs: fd, buf - user buffer, nbytes - most bytes to read
+ *   Return Value: bytes read, -1 on a bad buffer or a signal (or, O_NONBLOCK, if nothing came in)
+ *   Function: blocks until something has been received, then returns what is there */
+static int32_t serial_read(int32_t fd, void* buf, int32_t nbytes) {
+    uint32_t flags;
+    int32_t n = 0;
+
+    if (bad_userspace_addr(buf, nbytes))
+        return -1;
+    if (nbytes == 0)
+        return 0;
+
+    spin_lock_irqsave(&serial_lock, flags);
+    while (rx_tail == rx_head) {
+        if (fd_get(fd)->nonblock || signal_pending())
+            { spin_unlock_irqrestore(&serial_lock, flags); return -1; }
+        sleep_on(&serial_waiters, &serial_lock);
+    }
+    while (n < nbytes && rx_head != rx_tail) {
+        ((uint8_t*)buf)[n++] = rx_buf[rx_head % SERIAL_RX_SIZE];
+        rx_head++;
+    }
+    spin_unlock_irqrestore(&serial_lock, flags);
+    return n;
+}
+
+/* serial_write
+ *   Inputs: fd, buf - user data, nbytes - bytes to write
+ *   Return Value: nbytes, fewer if a signal came in part way (or, O_NONBLOCK, the ring filled
+ *                 up), -1 if nothing was queued for those reasons or the buffer is bad
+ *   Function: queues everything for sending, blocking whenever the transmit ring is full */
+static int32_t serial_write(int32_t fd, const void* buf, int32_t nbytes) {
+    uint32_t flags, n, first;
+    int32_t written = 0;
+    int32_t nonblock = fd_get(fd)->nonblock;
+
+    if (bad_userspace_addr(buf, nbytes))
+        return -1;
+
+    spin_lock_irqsave(&serial_lock, flags);
+    while (written < nbytes) {
+        if (tx_tail - tx_head == SERIAL_TX_SIZE) {
+            if (nonblock || signal_pending())
+                break;
+            sleep_on(&serial_waiters, &serial_lock);
+            continue;
+        }
+
+        n = SERIAL_TX_SIZE - (tx_tail - tx_head);
+        if (n > (uint32_t)(nbytes - written))
+            n = nbytes - written;
+        first = SERIAL_TX_SIZE - (tx_tail % SERIAL_TX_SIZE);
+        if (first > n)
+            first = n;
+        memcpy(&tx_buf[tx_tail % SERIAL_TX_SIZE], (const uint8_t*)buf + written, first);
+        memcpy(tx_buf, (const uint8_t*)buf + written + first, n - first);
+        tx_tail += n;
+        written += n;
+        tx_start();
+    }
+    spin_unlock_irqrestore(&serial_lock, flags);
+
+    if (written == 0 && nbytes > 0)
+        return -1;
+    return written;
+}
+
+/* serial_poll
+ *   Inputs: fd (not used)
+ *   Return Value: POLLIN once something has been received, POLLOUT while the transmit ring has room
+ *   Function: poll_func of the device */
+static int32_t serial_poll(int32_t fd) {
+    int32_t ready = 0;
+
+    if (rx_tail != rx_head)
+        ready |= POLLIN;
+    if (tx_tail - tx_head != SERIAL_TX_SIZE)
+        ready |= POLLOUT;
+    return ready;
+}
+
+/* serial_log
+ *   Inputs: buf - text, n - its length
+ *   Return Value: none
+ *   Function: queues kernel log text without ever blocking, what does not fit is dropped. Safe
+ *             from any context that does not hold serial_lock */
+void serial_log(const int8_t* buf, int32_t n) {
+    uint32_t flags;
+    int32_t i;
+
+    if (!serial_present)
+        return;
+    spin_lock_irqsave(&serial_lock, flags);
+    for (i = 0; i < n && tx_tail - tx_head < SERIAL_TX_SIZE; i++) {
+        tx_buf[tx_tail % SERIAL_TX_SIZE] = buf[i];
+        tx_tail++;
+    }
+    tx_start();
+    spin_unlock_irqrestore(&serial_lock, flags);
+}
@@ -0,0 +1,59 @@
+/* serial.h - 16550 UART on COM1
+ */
+
+#ifndef _SERIAL_H
+#define _SERIAL_H
+
+#include "types.h"
+#include "pcb.h"
+
+#define SERIAL_IRQ 4
+#define SERIAL_VECTOR 0x24
+/* name open finds the device under */
+#define SERIAL_NAME "ttyS0"
+
+/* COM1 registers, offsets from COM1_PORT (DLL/DLM while LCR_DLAB is set) */
+#define COM1_PORT   0x3F8
+#define UART_DATA   0           // RBR on read, THR on write
+#define UART_IER    1
+#define UART_IIR    2           // FCR on write
+#define UART_LCR    3
+#define UART_MCR    4
+#define UART_LSR    5
+#define UART_MSR    6
+#define UART_SCR    7
+#define UART_DLL    0
+#define UART_DLM    1
+
+#define IER_RX      0x01        // received data available
+#define IER_TX      0x02        // transmit holding register empty
+#define IIR_NONE    0x01        // no interrupt pending
+#define IIR_ID      0x0E
+#define IIR_MSR     0x00
+#define IIR_THRE    0x02
+#define IIR_RX      0x04
+#define IIR_LSR     0x06
+#define IIR_TIMEOUT 0x0C        // data has sat in the receive FIFO
+#define FCR_ENABLE  0xC7        // FIFOs on and cleared, receive interrupt at 14 bytes
+#define LCR_8N1     0x03
+#define LCR_DLAB    0x80
+#define MCR_IRQ     0x0B        // DTR, RTS, and OUT2, which connects the interrupt line
+#define LSR_DR      0x01        // a byte has been received
+#define LSR_THRE    0x20        // transmit FIFO empty
+
+#define UART_FIFO_SIZE 16       // bytes written per transmit interrupt
+#define SERIAL_DIVISOR 1        // 115200 baud
+
+/* bytes buffered each way, powers of two */
+#define SERIAL_TX_SIZE 8192
+#define SERIAL_RX_SIZE 1024
+
+extern file_op_func_t serial_funcs;
+
+extern void serial_init();
+extern void serial_handler();
+extern void serial_ack();
+extern int32_t serial_open(const uint8_t* filename);
+extern void serial_log(const int8_t* buf, int32_t n);
+
+#endif
@@ -0,0 +1,315 @@
+/* signal.c - signals for user programs.
+ *
+ * A signal is a pending bit in the pcb, set by a fault, ctrl+c or the alarm timer. Nothing else
+ * happens until the process is about to go back to user mode: every interrupt, exception and
+ * system call path runs DO_SIGNAL before its iret/sysexit, and do_signal either applies the
+ * default action or rewrites the saved frame so the cpu lands in the handler with a sig_frame_t
+ * pushed on the user stack. The handler returns into the trampoline in that frame, which calls
+ * sigreturn to put the interrupted registers back. */
+
+#include "signal.h"
+#include "pcb.h"
+#include "systemcall.h"
+#include "scheduler.h"
+#include "terminal.h"
+#include "excepts.h"
+#include "x86_desc.h"
+#include "lib.h"
+
+/* movl $SYS_SIGRETURN, %eax; int $0x80; nop. Not sysenter: sysexit would clobber ecx/edx */
+static const uint8_t sig_tramp[SIG_TRAMP_LEN] = {0xB8, SYS_SIGRETURN, 0x00, 0x00, 0x00, 0xCD, 0x80, 0x90};
+
+/* eflags bits sigreturn takes from the saved context: CF PF AF ZF SF TF DF OF */
+#define EFLAGS_USER 0x0DD5
+#define EFLAGS_IF   0x200
+
+/* sig_kills
+ *   Inputs: signum - signal number
+ *   Return Value: 1 if the default action kills the process, 0 if it ignores the signal
+ *   Function: faults and ctrl+c kill, ALARM and USER1 are ignored */
+static int32_t sig_kills(uint32_t signum){
+    return signum <= SIG_INTERRUPT;
+}
+
+/* sig_wanted
+ *   Inputs: pid - process, signum - signal number
+ *   Return Value: 1 if delivering signum would do something right now
+ *   Function: true for an installed handler the process is not already running, and for a default
+ *             that kills (base shells cannot be killed). Anything else stays pending or is dropped */
+static int32_t sig_wanted(int32_t pid, uint32_t signum){
+    pcb_entry_t* pcb = pcb_ptr[pid];
+
+    if (pcb->sig_handler[signum] != NULL)
+        return !pcb->sig_in_handler;
+    return sig_kills(signum) && pid >= NUM_TERMINALS;
+}
+
+/* sig_kill
+ *   Inputs: none
+ *   Return Value: none
+ *   Function: ends the current process the way a fault does, execute returns 256 to the parent */
+static void sig_kill(){
+    cli();
+    exception_flag = 1;
+    halt(0);
+}
+
+/* setup_frame
+ *   Inputs: frame - saved user registers, signum - signal, handler - user handler
+ *   Return Value: 0 on success, -1 if the frame does not fit on the user stack
+ *   Function: pushes a sig_frame_t below the user esp and points the frame at the handler */
+static int32_t setup_frame(irq_frame_t* frame, uint32_t signum, void* handler){
+    sig_frame_t* sf = (sig_frame_t*)(frame->user_esp - sizeof(sig_frame_t));
+    sig_context_t* ctx = &sf->context;
+
+    if (bad_userspace_addr(sf, sizeof(sig_frame_t)))
+        return -1;
+
+    memcpy(sf->tramp, sig_tramp, SIG_TRAMP_LEN);
+    sf->ret_addr = (uint32_t)sf->tramp;
+    sf->signum = signum;
+
+    ctx->ebx = frame->ebx;
+    ctx->ecx = frame->ecx;
+    ctx->edx = frame->edx;
+    ctx->esi = frame->esi;
+    ctx->edi = frame->edi;
+    ctx->ebp = frame->ebp;
+    ctx->eax = frame->eax;
+    ctx->ds = ctx->es = ctx->fs = USER_DS;
+    ctx->irq_exc = signum;
+    ctx->err = 0;
+    ctx->eip = frame->eip;
+    ctx->cs = frame->cs;
+    ctx->eflags = frame->eflags;
+    ctx->esp = frame->user_esp;
+    ctx->ss = frame->user_ss;
+
+    frame->eip = (uint32_t)handler;
+    frame->user_esp = (uint32_t)sf;
+    return 0;
+}
+
+/* do_signal
+ *   Inputs: frame - registers about to be restored by iret/sysexit
+ *   Return Value: none
+ *   Function: called on the way out of every interrupt and system call. If the frame goes back to
+ *             user mode, takes the lowest pending signal that can be acted on: the default action,
+ *             or one handler frame. Signals with a handler wait while a handler is running */
+void do_signal(irq_frame_t* frame){
+    pcb_entry_t* pcb;
+    uint32_t flags, signum;
+    void* handler;
+
+    if ((frame->cs & 3) != 3 || active_pid < 0)
+        return;
+    pcb = pcb_ptr[active_pid];
+    if (pcb->sig_pending == 0)
+        return;
+
+    cli_and_save(flags);
+    for (signum = 0; signum < NUM_SIGNALS; signum++) {
+        if (!(pcb->sig_pending & (1 << signum)))
+            continue;
+        handler = pcb->sig_handler[signum];
+        if (handler != NULL && pcb->sig_in_handler)
+            continue;
+
+        /* other cpus may be setting bits at the same time */
+        asm volatile("lock andl %1, %0" : "+m"(pcb->sig_pending) : "r"(~(1 << signum)) : "memory");
+
+        if (handler == NULL) {
+            if (sig_kills(signum) && active_pid >= NUM_TERMINALS)
+                sig_kill();
+            continue;
+        }
+
+        if (setup_frame(frame, signum, handler) == -1)
+            sig_kill();
+        pcb->sig_in_handler = 1;
+        break;
+    }
+    restore_flags(flags);
+}
+
+/* send_signal
+ *   Inputs: pid - target process, signum - signal number
+ *   Return Value: none
+ *   Function: marks the signal pending. A process blocked in sleep is woken so it gets back to
+ *             user mode and takes it. Safe from interrupt handlers and other cpus */
+void send_signal(int32_t pid, uint32_t signum){
+    pcb_entry_t* pcb;
+
+    if (pid < 0 || pid >= MAX_PROCESSES || signum >= NUM_SIGNALS)
+        return;
+    pcb = pcb_ptr[pid];
+    if (!pcb->pid_in_use)
+        return;
+
+    asm volatile("lock orl %1, %0" : "+m"(pcb->sig_pending) : "r"(1 << signum) : "memory");
+    if (sig_wanted(pid, signum))
+        pcb->sleeping = 0;
+}
+
+/* signal_terminal
+ *   Inputs: t - terminal id, signum - signal number
+ *   Return Value: none
+ *   Function: sends the signal to the terminal's foreground: every process on it that is not
+ *             waiting on a child, i.e. the running program or all stages of a pipeline */
+void signal_terminal(int32_t t, uint32_t signum){
+    int32_t pid;
+
+    for (pid = 0; pid < MAX_PROCESSES; pid++) {
+        if (pcb_ptr[pid]->pid_in_use && pcb_ptr[pid]->current && pcb_ptr[pid]->t_id == t)
+            send_signal(pid, signum);
+    }
+}
+
+/* raise_fault
+ *   Inputs: frame - registers at the fault, signum - SIG_DIV_ZERO or SIG_SEGFAULT
+ *   Return Value: 1 if the fault becomes a signal, 0 if the caller should kill as before
+ *   Function: a user-mode fault goes to the process's handler. Faults in the kernel, with no handler,
+ *             or inside a handler take the old path */
+int32_t raise_fault(irq_frame_t* frame, uint32_t signum){
+    if ((frame->cs & 3) != 3 || active_pid < 0)
+        return 0;
+    if (pcb_ptr[active_pid]->sig_handler[signum] == NULL || pcb_ptr[active_pid]->sig_in_handler)
+        return 0;
+
+    send_signal(active_pid, signum);
+    return 1;
+}
+
+/* signal_pending
+ *   Inputs: none
+ *   Return Value: 1 if the current process has a signal to take
+ *   Function: lets blocking reads give up early so the signal is delivered */
+int32_t signal_pending(){
+    uint32_t signum, pending;
+
+    if (active_pid < 0)
+        return 0;
+    pending = pcb_ptr[active_pid]->sig_pending;
+    for (signum = 0; signum < NUM_SIGNALS; signum++) {
+        if ((pending & (1 << signum)) && sig_wanted(active_pid, signum))
+            return 1;
+    }
+    return 0;
+}
+
+/* alarm_fire
+ *   Inputs: pid - process whose alarm timer expired
+ *   Return Value: none
+ *   Function: timer callback, sends ALARM and re-arms for the next period */
+static void alarm_fire(uint32_t pid){
+    pcb_entry_t* pcb = pcb_ptr[pid];
+
+    /* turned off while this was on its way */
+    if (pcb->alarm_period == 0)
+        return;
+
+    send_signal(pid, SIG_ALARM);
+    timer_add(&pcb->alarm_timer, pit_ticks + pcb->alarm_period, alarm_fire, pid);
+}
+
+/* alarm_stop
+ *   Inputs: pid - process
+ *   Return Value: none
+ *   Function: turns off the process's alarm */
+static void alarm_stop(int32_t pid){
+    pcb_ptr[pid]->alarm_period = 0;
+    timer_del(&pcb_ptr[pid]->alarm_timer);
+}
+
+/* signal_reset
+ *   Inputs: pid - process being started by execute
+ *   Return Value: none
+ *   Function: default actions, nothing pending, no alarm */
+void signal_reset(int32_t pid){
+    int i;
+
+    alarm_stop(pid);
+    for (i = 0; i < NUM_SIGNALS; i++)
+        pcb_ptr[pid]->sig_handler[i] = NULL;
+    pcb_ptr[pid]->sig_pending = 0;
+    pcb_ptr[pid]->sig_in_handler = 0;
+}
+
+/* signal_exit
+ *   Inputs: pid - process being halted
+ *   Return Value: none
+ *   Function: stops the alarm so it does not fire for a dead process */
+void signal_exit(int32_t pid){
+    alarm_stop(pid);
+    pcb_ptr[pid]->sig_pending = 0;
+}
+
+/* set_handler
+ *   Inputs: signum - signal number, handler_address - user function, NULL for the default action
+ *   Return Value: 0 on success, -1 on a bad signal number or handler address
+ *   Function: set_handler system call */
+int32_t set_handler(int32_t signum, void* handler_address){
+    if (signum < 0 || signum >= NUM_SIGNALS)
+        return -1;
+    if (handler_address != NULL && bad_userspace_addr(handler_address, 1))
+        return -1;
+
+    pcb_ptr[active_pid]->sig_handler[signum] = handler_address;
+    return 0;
+}
+
+/* sigreturn
+ *   Inputs: none
+ *   Return Value: the interrupted eax, which the system call path puts back in the frame
+ *   Function: sigreturn system call, reached from the trampoline once a handler returns. Copies the
+ *             saved context from the user stack into the kernel frame that int 0x80 left at the
+ *             top of this process's kernel stack. Segments and IF cannot be changed this way */
+int32_t sigreturn(void){
+    pcb_entry_t* pcb = pcb_ptr[active_pid];
+    irq_frame_t* frame = (irq_frame_t*)(EIGHT_MB - active_pid*EIGHT_KB - sizeof(irq_frame_t));
+    sig_context_t* ctx;
+
+    if (!pcb->sig_in_handler)
+        return -1;
+
+    /* the handler's ret took the return address, esp is at signum */
+    ctx = (sig_context_t*)(frame->user_esp + sizeof(uint32_t));
+    if (bad_userspace_addr(ctx, sizeof(sig_context_t)))
+        return -1;
+
+    frame->ebx = ctx->ebx;
+    frame->ecx = ctx->ecx;
+    frame->edx = ctx->edx;
+    frame->esi = ctx->esi;
+    frame->edi = ctx->edi;
+    frame->ebp = ctx->ebp;
+    frame->eip = ctx->eip;
+    frame->cs = USER_CS;
+    frame->eflags = (frame->eflags & ~EFLAGS_USER) | (ctx->eflags & EFLAGS_USER) | EFLAGS_IF;
+    frame->user_esp = ctx->esp;
+    frame->user_ss = USER_DS;
+
+    pcb->sig_in_handler = 0;
+    return ctx->eax;
+}
+
+/* alarm
+ *   Inputs: ms - interval in milliseconds, 0 to turn the alarm off
+ *   Return Value: the previous interval in milliseconds, 0 if there was none
+ *   Function: alarm system call. ALARM is sent every ms milliseconds (rounded up to pit ticks)
+ *             until turned off, from the timer wheel, so a program can block in sleep or read
+ *             between events instead of polling */
+int32_t alarm(uint32_t ms){
+    pcb_entry_t* pcb = pcb_ptr[active_pid];
+    int32_t old = pcb->alarm_period * PIT_TICK_MS;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    alarm_stop(active_pid);
+    if (ms != 0) {
+        pcb->alarm_period = ms_to_ticks(ms);
+        timer_add(&pcb->alarm_timer, pit_ticks + pcb->alarm_period, alarm_fire, active_pid);
+    }
+    restore_flags(flags);
+    return old;
+}
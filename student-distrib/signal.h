@@ -0,0 +1,63 @@
+#ifndef _SIGNAL_H
+#define _SIGNAL_H
+
+/* signal numbers, same as enum signums in the user library */
+#define SIG_DIV_ZERO    0       // divide error in user mode, default kills
+#define SIG_SEGFAULT    1       // any other fault in user mode, default kills
+#define SIG_INTERRUPT   2       // ctrl+c on the process's terminal, default kills
+#define SIG_ALARM       3       // alarm() timer, default ignored
+#define SIG_USER1       4       // default ignored
+#define NUM_SIGNALS     5
+
+/* bytes of sigreturn code copied above the saved context on the user stack */
+#define SIG_TRAMP_LEN   8
+
+#ifdef ASM
+
+/* DO_SIGNAL
+ *   Function: run before popfl/popal/iret on every path back to user mode. %esp must point at
+ *             the irq_frame_t left by pushal/pushfl; do_signal rewrites it to enter a handler */
+#define DO_SIGNAL       \
+    pushl %esp         ;\
+    call do_signal     ;\
+    addl $4, %esp
+
+#else
+
+#include "types.h"
+#include "pit.h"
+
+/* registers saved on the user stack while a handler runs, in the order of the ECE391
+ * hw_context. The handler is called as handler(signum) with this right above its argument,
+ * so &signum + 7 is the saved eax. sigreturn copies it back into the kernel frame */
+typedef struct sig_context_t{
+    uint32_t ebx, ecx, edx, esi, edi, ebp, eax;
+    uint32_t ds, es, fs;
+    uint32_t irq_exc;       // signal number, where the hw_context keeps the vector
+    uint32_t err;
+    uint32_t eip, cs, eflags, esp, ss;
+}sig_context_t;
+
+/* user stack while a handler runs, from its esp up */
+typedef struct sig_frame_t{
+    uint32_t ret_addr;      // points at tramp
+    uint32_t signum;
+    sig_context_t context;
+    uint8_t tramp[SIG_TRAMP_LEN];
+}sig_frame_t;
+
+extern void do_signal(irq_frame_t* frame);
+extern void send_signal(int32_t pid, uint32_t signum);
+extern void signal_terminal(int32_t t, uint32_t signum);
+extern int32_t raise_fault(irq_frame_t* frame, uint32_t signum);
+extern int32_t signal_pending();
+extern void signal_reset(int32_t pid);
+extern void signal_exit(int32_t pid);
+
+extern int32_t set_handler(int32_t signum, void* handler_address);
+extern int32_t sigreturn(void);
+extern int32_t alarm(uint32_t ms);
+
+#endif /* ASM */
+
+#endif
@@ -0,0 +1,464 @@
+/* smp.c - starts the secondary cpus through the local APIC and holds per-cpu state.
+ *
+ * Cpus are found through the Intel MP configuration table (QEMU provides one for -smp N). Each
+ * terminal is bound to one cpu for good, so a terminal's processes, their kernel contexts and
+ * their fpu state never move between cpus. Only the boot cpu gets PIT interrupts; it forwards
+ * every tick to the others with an IPI. */
+
+#include "smp.h"
+#include "smp_s.h"
+#include "lib.h"
+#include "x86_desc.h"
+#include "paging.h"
+#include "page.h"
+#include "pit.h"
+#include "pcb.h"
+#include "scheduler.h"
+#include "terminal.h"
+#include "fpu.h"
+#include "apic.h"
+#include "systemcall.h"
+#include "kinfo.h"
+#include "klog.h"
+
+#define AP_STACK_SIZE 0x1000
+#define AP_START_TIMEOUT 100            // pit ticks to wait for a cpu to come up
+
+/* MP floating pointer and configuration table (Intel MP spec 1.4, chapter 4) */
+#define MP_FP_SIG 0x5F504D5F            // "_MP_"
+#define MP_CT_SIG 0x504D4350            // "PCMP"
+#define MP_ENTRY_CPU 0
+#define MP_ENTRY_BUS 1
+#define MP_ENTRY_IOAPIC 2
+#define MP_ENTRY_IOINT 3
+#define MP_INT_VECTORED 0
+#define MP_CPU_ENABLED 0x01
+#define MP_CPU_BSP 0x02
+#define BDA_EBDA_SEG 0x40E
+#define BASE_MEM_TOP 0xA0000
+#define BIOS_ROM 0xF0000
+#define LOW_MEM_PAGES 256               // first 1MB
+
+typedef struct mp_fp_t{
+    uint32_t signature;
+    uint32_t config;
+    uint8_t length;
+    uint8_t spec_rev;
+    uint8_t checksum;
+    uint8_t features[5];
+}__attribute__((packed)) mp_fp_t;
+
+typedef struct mp_config_t{
+    uint32_t signature;
+    uint16_t length;
+    uint8_t spec_rev;
+    uint8_t checksum;
+    uint8_t oem_id[8];
+    uint8_t product_id[12];
+    uint32_t oem_table;
+    uint16_t oem_table_size;
+    uint16_t entry_count;
+    uint32_t lapic_addr;
+    uint16_t ext_length;
+    uint8_t ext_checksum;
+    uint8_t reserved;
+}__attribute__((packed)) mp_config_t;
+
+typedef struct mp_cpu_t{
+    uint8_t type;
+    uint8_t apic_id;
+    uint8_t apic_ver;
+    uint8_t flags;
+    uint32_t signature;
+    uint32_t features;
+    uint32_t reserved[2];
+}__attribute__((packed)) mp_cpu_t;
+
+typedef struct mp_bus_t{
+    uint8_t type;
+    uint8_t id;
+    uint8_t bus_type[6];
+}__attribute__((packed)) mp_bus_t;
+
+typedef struct mp_ioint_t{
+    uint8_t type;
+    uint8_t int_type;
+    uint16_t flags;
+    uint8_t src_bus;
+    uint8_t src_irq;
+    uint8_t dst_ioapic;
+    uint8_t dst_pin;
+}__attribute__((packed)) mp_ioint_t;
+
+typedef struct mp_ioapic_t{
+    uint8_t type;
+    uint8_t id;
+    uint8_t version;
+    uint8_t flags;
+    uint32_t addr;
+}__attribute__((packed)) mp_ioapic_t;
+
+cpu_t cpus[MAX_CPUS] = {
+    [0 ... MAX_CPUS-1] = { .pid = -1, .tid = -1, .be_pid = -1, .dead_pid = -1, .echo_tid = -1 }
+};
+uint32_t num_cpus = 1;
+uint32_t ioapic_base = 0;
+
+uint32_t lapic_base = 0;
+uint8_t isa_irq_pin[NUM_ISA_IRQS] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15
+};
+static volatile uint32_t smp_ready = 0;
+
+/* boot stacks of the secondary cpus, used until they first run a process */
+static uint8_t ap_stacks[MAX_CPUS][AP_STACK_SIZE] __attribute__((aligned(16)));
+
+volatile uint32_t ap_boot_pgdir;
+volatile uint32_t ap_boot_stack;
+volatile uint32_t ap_boot_cpu;
+
+/* tss_init
+ *   Inputs: cpu - index of the executing cpu
+ *   Return Value: none
+ *   Function: Builds the cpu's TSS descriptor in the GDT and loads it into the task register,
+ *             which is also how smp_cpu_id tells cpus apart. */
+void tss_init(uint32_t cpu) {
+    seg_desc_t the_tss_desc;
+    the_tss_desc.granularity   = 0x0;
+    the_tss_desc.opsize        = 0x0;
+    the_tss_desc.reserved      = 0x0;
+    the_tss_desc.avail         = 0x0;
+    the_tss_desc.seg_lim_19_16 = TSS_SIZE & 0x000F0000;
+    the_tss_desc.present       = 0x1;
+    the_tss_desc.dpl           = 0x0;
+    the_tss_desc.sys           = 0x0;
+    the_tss_desc.type          = 0x9;
+    the_tss_desc.seg_lim_15_00 = TSS_SIZE & 0x0000FFFF;
+
+    SET_TSS_PARAMS(the_tss_desc, &cpu_tss[cpu], tss_size);
+
+    tss_desc_ptr[cpu] = the_tss_desc;
+
+    cpu_tss[cpu].ldt_segment_selector = KERNEL_LDT;
+    cpu_tss[cpu].ss0 = KERNEL_DS;
+    cpu_tss[cpu].esp0 = (cpu == 0) ? 0x800000 : (uint32_t)&ap_stacks[cpu][AP_STACK_SIZE];
+    ltr(TSS_SEL(cpu));
+}
+
+/* lapic_eoi
+ *   Inputs: none
+ *   Return Value: none
+ *   Function: acknowledges the interrupt being serviced by the local APIC */
+void lapic_eoi() {
+    lapic_write(LAPIC_EOI, 0);
+}
+
+/* lapic_enable
+ *   Inputs: bsp - 1 on the boot cpu
+ *   Return Value: none
+ *   Function: Software-enables the local APIC. The boot cpu keeps taking 8259 interrupts through
+ *             LINT0 (virtual wire mode); the other cpus mask LINT0/LINT1 and only take IPIs. */
+static void lapic_enable(uint32_t bsp) {
+    lapic_write(LAPIC_TPR, 0);
+    lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | SPURIOUS_VECTOR);
+    if (bsp) {
+        lapic_write(LAPIC_LVT_LINT0, LAPIC_LVT_EXTINT);
+        lapic_write(LAPIC_LVT_LINT1, LAPIC_LVT_NMI);
+    } else {
+        lapic_write(LAPIC_LVT_LINT0, LAPIC_LVT_MASKED);
+        lapic_write(LAPIC_LVT_LINT1, LAPIC_LVT_MASKED);
+    }
+}
+
+/* lapic_send_ipi
+ *   Inputs: apic_id - destination, icr - low word of the interrupt command register
+ *   Return Value: none
+ *   Function: sends an IPI once the previous one has been accepted */
+static void lapic_send_ipi(uint32_t apic_id, uint32_t icr) {
+    uint32_t flags;
+    cli_and_save(flags);
+    while (lapic_read(LAPIC_ICR_LO) & LAPIC_ICR_PENDING)
+        asm volatile ("pause");
+    lapic_write(LAPIC_ICR_HI, apic_id << 24);
+    lapic_write(LAPIC_ICR_LO, icr);
+    restore_flags(flags);
+}
+
+/* smp_send_ipi_others
+ *   Inputs: vector - interrupt vector to raise
+ *   Return Value: none
+ *   Function: sends a fixed IPI to every cpu but this one */
+void smp_send_ipi_others(uint32_t vector) {
+    uint32_t flags;
+
+    if (num_cpus < 2 || !smp_ready)
+        return;
+
+    cli_and_save(flags);
+    while (lapic_read(LAPIC_ICR_LO) & LAPIC_ICR_PENDING)
+        asm volatile ("pause");
+    lapic_write(LAPIC_ICR_LO, LAPIC_ICR_ALL_BUT_SELF | LAPIC_ICR_FIXED | vector);
+    restore_flags(flags);
+}
+
+/* smp_tick_others
+ *   Inputs: none
+ *   Return Value: none
+ *   Function: called from the boot cpu's PIT interrupt, passes the scheduler tick on */
+void smp_tick_others() {
+    smp_send_ipi_others(IPI_TICK_VECTOR);
+}
+
+/* ipi_tick_handler
+ *   Inputs: frame - registers saved by ipi_tick_link
+ *   Return Value: none
+ *   Function: scheduler tick on a secondary cpu, does what pit_int_handler does minus the clock */
+void ipi_tick_handler(irq_frame_t* frame) {
+    lapic_eoi();
+    cli();
+    kinfo_update();
+    account_tick(frame->cs);
+
+    switch_process();
+
+    sti();
+}
+
+/* set_ipi_gate
+ *   Inputs: vec - IDT vector, handler - assembly linkage
+ *   Return Value: none
+ *   Function: installs a 32-bit interrupt gate, same layout as the device interrupts */
+static void set_ipi_gate(uint32_t vec, void (*handler)()) {
+    idt[vec].present = 1;
+    idt[vec].dpl = 0;
+    idt[vec].reserved0 = 0;
+    idt[vec].size = 1;
+    idt[vec].reserved1 = 1;
+    idt[vec].reserved2 = 1;
+    idt[vec].reserved3 = 0;
+    idt[vec].reserved4 = 0;
+    idt[vec].seg_selector = KERNEL_CS;
+    SET_IDT_ENTRY(idt[vec], handler);
+}
+
+/* map_low_memory
+ *   Inputs: present - 1 to map the first 1MB, 0 to unmap it again
+ *   Return Value: none
+ *   Function: the MP tables and the startup code live below 1MB, which is normally unmapped apart
+ *             from video memory. Only touches the boot cpu's page table, before the others start. */
+/* every terminal's region must be one of the pages kept below */
+typedef char term_regions_mapped[(TERM1_VIDMEM >= VGA_TEXT_START && TERM3_VIDMEM + TERM_REGION_SIZE <= VGA_TEXT_END) ? 1 : -1];
+
+static void map_low_memory(uint32_t present) {
+    uint32_t i;
+    for (i = 0; i < LOW_MEM_PAGES; i++) {
+        if (i >= (VGA_TEXT_START >> 12) && i < (VGA_TEXT_END >> 12))
+            continue;               // video memory, with every terminal's region, stays mapped
+        page_table[i].present = present;
+    }
+    flush_tlb();
+}
+
+static uint8_t checksum(uint8_t* p, uint32_t len) {
+    uint8_t sum = 0;
+    while (len--)
+        sum += *p++;
+    return sum;
+}
+
+/* mp_search
+ *   Inputs: start, len - physical range to scan
+ *   Return Value: MP floating pointer, or NULL
+ *   Function: the floating pointer sits on a 16 byte boundary and its 16 bytes sum to 0 */
+static mp_fp_t* mp_search(uint32_t start, uint32_t len) {
+    uint32_t addr;
+    for (addr = start; addr + sizeof(mp_fp_t) <= start + len; addr += 16) {
+        mp_fp_t* fp = (mp_fp_t*)addr;
+        if (fp->signature == MP_FP_SIG && checksum((uint8_t*)fp, sizeof(mp_fp_t)) == 0)
+            return fp;
+    }
+    return NULL;
+}
+
+/* mp_parse
+ *   Inputs: none
+ *   Return Value: number of usable cpus found, boot cpu included. 1 if there is no MP table
+ *   Function: Reads the local APIC and IOAPIC addresses, the enabled cpus and the ISA interrupt
+ *             wiring from the MP table. The boot cpu stays cpus[0], the others are numbered in
+ *             table order. Bus entries come before interrupt entries in the table. */
+static uint32_t mp_parse() {
+    mp_fp_t* fp;
+    mp_config_t* conf;
+    uint8_t* entry;
+    uint32_t ebda, i, n = 1;
+    int32_t isa_bus = -1;
+
+    ebda = (uint32_t)(*(uint16_t*)BDA_EBDA_SEG) << 4;
+    fp = NULL;
+    if (ebda != 0)
+        fp = mp_search(ebda, 1024);
+    if (fp == NULL)
+        fp = mp_search(BASE_MEM_TOP - 1024, 1024);
+    if (fp == NULL)
+        fp = mp_search(BIOS_ROM, 0x10000);
+
+    /* no table, or one of the default configurations: run on the boot cpu only */
+    if (fp == NULL || fp->config == 0 || fp->config >= (LOW_MEM_PAGES << 12))
+        return 1;
+
+    conf = (mp_config_t*)fp->config;
+    if (conf->signature != MP_CT_SIG || checksum((uint8_t*)conf, conf->length) != 0)
+        return 1;
+    if ((conf->lapic_addr >> 22) != (APIC_MMIO_BASE >> 22))
+        return 1;
+
+    lapic_base = conf->lapic_addr;
+    cpus[0].apic_id = lapic_read(LAPIC_ID) >> 24;
+
+    entry = (uint8_t*)conf + sizeof(mp_config_t);
+    for (i = 0; i < conf->entry_count; i++) {
+        if (*entry == MP_ENTRY_CPU) {
+            mp_cpu_t* cpu = (mp_cpu_t*)entry;
+            if ((cpu->flags & MP_CPU_ENABLED) && cpu->apic_id != cpus[0].apic_id && n < MAX_CPUS)
+                cpus[n++].apic_id = cpu->apic_id;
+            entry += sizeof(mp_cpu_t);
+        } else {
+            /* every other entry type is 8 bytes */
+            if (*entry == MP_ENTRY_BUS) {
+                mp_bus_t* bus = (mp_bus_t*)entry;
+                if (strncmp((int8_t*)bus->bus_type, "ISA", 3) == 0)
+                    isa_bus = bus->id;
+            } else if (*entry == MP_ENTRY_IOAPIC && ioapic_base == 0) {
+                ioapic_base = ((mp_ioapic_t*)entry)->addr;
+            } else if (*entry == MP_ENTRY_IOINT) {
+                mp_ioint_t* irq = (mp_ioint_t*)entry;
+                if (irq->int_type == MP_INT_VECTORED && irq->src_bus == isa_bus && irq->src_irq < NUM_ISA_IRQS)
+                    isa_irq_pin[irq->src_irq] = irq->dst_pin;
+            }
+            entry += 8;
+        }
+    }
+    return n;
+}
+
+/* wait_ticks
+ *   Inputs: n - pit ticks to wait
+ *   Return Value: none
+ *   Function: halts until n more PIT interrupts have arrived (interrupts must be on) */
+static void wait_ticks(uint32_t n) {
+    uint32_t start = pit_ticks;
+    while (pit_ticks - start < n)
+        asm volatile ("hlt");
+}
+
+/* start_ap
+ *   Inputs: cpu - index to give the new cpu
+ *   Return Value: 0 once the cpu is running, -1 if it did not answer
+ *   Function: INIT, then start-up IPIs pointing at the trampoline (Intel MP spec B.4) */
+static int32_t start_ap(uint32_t cpu) {
+    uint32_t start;
+
+    page_init_cpu(cpu);
+    ap_boot_pgdir = (uint32_t)cpu_page_dir[cpu];
+    ap_boot_stack = (uint32_t)&ap_stacks[cpu][AP_STACK_SIZE];
+    ap_boot_cpu = cpu;
+
+    lapic_send_ipi(cpus[cpu].apic_id, LAPIC_ICR_INIT);
+    wait_ticks(2);      // >= 10ms
+    lapic_send_ipi(cpus[cpu].apic_id, LAPIC_ICR_STARTUP | (AP_TRAMPOLINE >> 12));
+    wait_ticks(1);
+    if (!cpus[cpu].online)
+        lapic_send_ipi(cpus[cpu].apic_id, LAPIC_ICR_STARTUP | (AP_TRAMPOLINE >> 12));
+
+    start = pit_ticks;
+    while (!cpus[cpu].online && pit_ticks - start < AP_START_TIMEOUT)
+        asm volatile ("hlt");
+
+    return cpus[cpu].online ? 0 : -1;
+}
+
+/* smp_init
+ *   Inputs: none
+ *   Return Value: none
+ *   Function: Called by the boot cpu with interrupts on, before any process exists. Starts every
+ *             cpu in the MP table and switches to APIC interrupts where possible. With no MP table
+ *             (or -smp 1) everything stays on the boot cpu, as before. */
+void smp_init() {
+    uint32_t found, cpu;
+
+    cpus[0].online = 1;
+
+    map_low_memory(1);
+    found = mp_parse();
+    if (found > 1) {
+        memcpy((void*)AP_TRAMPOLINE, ap_trampoline, ap_trampoline_end - ap_trampoline);
+        asm volatile ("sgdt (%0)"
+                :
+                : "r"(AP_TRAMPOLINE + (ap_gdt_desc - ap_trampoline))
+                : "memory");
+    }
+    map_low_memory(0);
+
+    /* masking a line at run time (apic_init, apic_route_irq) can make an 8259 raise a spurious
+     * IRQ 7 or 15; spurious_link returns without an EOI, as the 8259 wants too */
+    set_ipi_gate(PIC_SPURIOUS_VECTOR, spurious_link);
+    set_ipi_gate(PIC_SPURIOUS_SLAVE_VECTOR, pic_spurious_slave_link);
+
+    if (lapic_base != 0) {
+        set_ipi_gate(IPI_TICK_VECTOR, ipi_tick_link);
+        set_ipi_gate(SPURIOUS_VECTOR, spurious_link);
+        lapic_enable(1);
+        lapic_timer_calibrate();
+    }
+
+    /* stop at the first cpu that does not come up so cpu indices stay dense */
+    for (cpu = 1; cpu < found; cpu++) {
+        if (start_ap(cpu) != 0) {
+            printk(KLOG_WARN, "smp: cpu with apic id %d did not start\n", cpus[cpu].apic_id);
+            break;
+        }
+        num_cpus++;
+    }
+
+    /* move the tick and device interrupts off the 8259 before anything is scheduled */
+    apic_init();
+
+    smp_ready = 1;
+    printf("smp: %d cpu(s) online\n", num_cpus);
+}
+
+/* smp_start_terminals
+ *   Inputs: none
+ *   Return Value: none
+ *   Function: Binds terminal t to cpu t % num_cpus. Until then no cpu has anything to schedule and
+ *             the boot context keeps running (launch_tests); the base shells start on the next ticks */
+void smp_start_terminals() {
+    uint32_t flags, t;
+
+    cli_and_save(flags);
+    for (t = 0; t < NUM_TERMINALS; t++)
+        cpus[t % num_cpus].terminals |= (1 << t);
+    restore_flags(flags);
+}
+
+/* ap_main
+ *   Inputs: cpu - index of this cpu
+ *   Return Value: none, does not return
+ *   Function: C entry of a secondary cpu (from ap_start32), paging is already on. Loads the shared
+ *             IDT and LDT and its own TSS, enables its fpu and local APIC, then idles until a
+ *             forwarded tick gives it a terminal to run. */
+void ap_main(uint32_t cpu) {
+    lidt(idt_desc_ptr);
+    lldt(KERNEL_LDT);
+    tss_init(cpu);
+    fpu_init();
+    sysenter_init();
+    lapic_enable(0);
+    lapic_timer_start();
+
+    cpus[cpu].online = 1;
+    sti();
+
+    while (1)
+        asm volatile ("hlt");
+}
@@ -0,0 +1,109 @@
+#ifndef _SMP_H
+#define _SMP_H
+
+#include "types.h"
+#include "x86_desc.h"
+#include "switch_s.h"
+#include "spinlock.h"
+
+/* local APIC registers, as byte offsets from lapic_base */
+#define LAPIC_DEFAULT_BASE 0xFEE00000
+#define LAPIC_ID        0x020
+#define LAPIC_TPR       0x080
+#define LAPIC_EOI       0x0B0
+#define LAPIC_SVR       0x0F0
+#define LAPIC_ICR_LO    0x300
+#define LAPIC_ICR_HI    0x310
+#define LAPIC_LVT_TIMER 0x320
+#define LAPIC_LVT_LINT0 0x350
+#define LAPIC_LVT_LINT1 0x360
+#define LAPIC_TIMER_INIT 0x380
+#define LAPIC_TIMER_CUR 0x390
+#define LAPIC_TIMER_DIV 0x3E0
+
+#define LAPIC_SVR_ENABLE    0x100
+#define LAPIC_LVT_MASKED    0x10000
+#define LAPIC_LVT_EXTINT    0x700
+#define LAPIC_LVT_NMI       0x400
+#define LAPIC_ICR_PENDING   0x1000
+#define LAPIC_ICR_INIT      0x4500      // INIT, level assert
+#define LAPIC_ICR_STARTUP   0x4600      // start-up IPI, low byte is the start page
+#define LAPIC_ICR_FIXED     0x4000      // fixed delivery, level assert
+#define LAPIC_ICR_ALL_BUT_SELF 0xC0000
+#define LAPIC_TIMER_PERIODIC 0x20000
+#define LAPIC_TIMER_DIV16   0x3
+
+/* vectors used between cpus */
+#define IPI_TICK_VECTOR     0xF0        // scheduler tick forwarded from the boot cpu's PIT interrupt
+#define LAPIC_TIMER_VECTOR  0xF2        // per-cpu scheduler tick from the local APIC timer
+#define SPURIOUS_VECTOR     0xFF
+
+/* per-cpu state. The boot cpu is cpus[0] */
+typedef struct cpu_t{
+    uint32_t apic_id;
+    volatile uint32_t online;
+
+    /* process and terminal running on this cpu (active_pid/active_tid), -1 when idle */
+    volatile int32_t pid;
+    volatile int32_t tid;
+
+    /* run queue: bitmask of the terminals whose processes run on this cpu */
+    uint32_t terminals;
+
+    /* best-effort round robin position (a pid) and ticks left in the slice */
+    int32_t be_pid;
+    uint32_t quantum_left;
+
+    /* spawned process that exited here and still has its pid, see proc_exit */
+    int32_t dead_pid;
+
+    /* real-time utilization admitted on this cpu, scaled by RT_UTIL_SCALE */
+    uint32_t rt_util;
+
+    /* terminal kernel output goes to instead of active_tid's, -1 for none (see echo_to) */
+    int32_t echo_tid;
+
+    /* ticks this cpu had nothing to run */
+    uint32_t idle_ticks;
+
+    /* time stamp taken when the interrupt being serviced came in, see irq_enter */
+    uint64_t irq_tsc;
+
+    /* where the cpu's boot thread is saved when it starts running processes */
+    context_t boot_context;
+}cpu_t;
+
+extern cpu_t cpus[MAX_CPUS];
+extern uint32_t num_cpus;
+extern uint32_t lapic_base;
+extern uint32_t ioapic_base;
+
+/* IOAPIC input pin each ISA IRQ is wired to, from the MP table (identity unless overridden) */
+#define NUM_ISA_IRQS 16
+extern uint8_t isa_irq_pin[NUM_ISA_IRQS];
+
+/* state of the executing cpu */
+#define this_cpu() (&cpus[smp_cpu_id()])
+
+/* cpu_owns
+ *   Inputs: cpu - cpu state, t - terminal id
+ *   Return Value: nonzero if terminal t's processes run on this cpu */
+#define cpu_owns(cpu, t) ((cpu)->terminals & (1 << (t)))
+
+static inline uint32_t lapic_read(uint32_t reg) {
+    return *(volatile uint32_t*)(lapic_base + reg);
+}
+
+static inline void lapic_write(uint32_t reg, uint32_t val) {
+    *(volatile uint32_t*)(lapic_base + reg) = val;
+}
+
+extern void tss_init(uint32_t cpu);
+extern void smp_init();
+extern void smp_start_terminals();
+extern void ap_main(uint32_t cpu);
+extern void lapic_eoi();
+extern void smp_send_ipi_others(uint32_t vector);
+extern void smp_tick_others();
+
+#endif
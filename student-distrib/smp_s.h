@@ -0,0 +1,34 @@
+#ifndef _SMP_S_H
+#define _SMP_S_H
+
+/*
+    This is the header file for the .S file that holds the real-mode startup code for secondary cpus
+    and the assembly linkage for the inter-processor interrupts.
+*/
+
+/* physical page the startup code is copied to, the start-up IPI vector is this >> 12 */
+#define AP_TRAMPOLINE 0x7000
+
+#ifndef ASM
+
+#include "types.h"
+
+/* startup code, copied to AP_TRAMPOLINE. ap_gdt_desc is filled in by the boot cpu */
+extern uint8_t ap_trampoline[];
+extern uint8_t ap_gdt_desc[];
+extern uint8_t ap_trampoline_end[];
+
+/* handed from the boot cpu to the cpu being started */
+extern volatile uint32_t ap_boot_pgdir;
+extern volatile uint32_t ap_boot_stack;
+extern volatile uint32_t ap_boot_cpu;
+
+/* assembly-linked functions for inter-processor interrupts */
+extern void ipi_tick_link();
+extern void spurious_link();
+extern void pic_spurious_slave_link();
+extern void apic_timer_link();
+
+#endif /* ASM */
+
+#endif
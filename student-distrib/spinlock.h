@@ -0,0 +1,55 @@
+#ifndef _SPINLOCK_H
+#define _SPINLOCK_H
+
+#include "types.h"
+#include "lib.h"
+
+/* Test-and-test-and-set spinlock. cli only keeps other code on the same cpu out; anything shared
+ * between cpus also needs one of these. Locks are not recursive, and a lock that is also taken from
+ * an interrupt handler must be taken with spin_lock_irqsave. */
+typedef struct spinlock_t{
+    volatile uint32_t locked;
+}spinlock_t;
+
+#define SPINLOCK_INIT { 0 }
+
+/* xchg
+ *   Inputs: addr - word to swap, val - value to store
+ *   Return Value: old value at addr
+ *   Function: atomic exchange (xchg with memory is implicitly locked) */
+static inline uint32_t xchg(volatile uint32_t* addr, uint32_t val) {
+    asm volatile ("xchgl %0, %1"
+            : "+r"(val), "+m"(*addr)
+            :
+            : "memory");
+    return val;
+}
+
+static inline void spin_lock(spinlock_t* lock) {
+    while (xchg(&lock->locked, 1) != 0) {
+        /* spin on a plain read so the cache line stays shared until the holder lets go */
+        while (lock->locked)
+            asm volatile ("pause" : : : "memory");
+    }
+}
+
+static inline void spin_unlock(spinlock_t* lock) {
+    /* x86 does not reorder stores with older loads/stores, a compiler barrier is enough */
+    asm volatile ("" : : : "memory");
+    lock->locked = 0;
+}
+
+/* disable interrupts on this cpu, then take the lock */
+#define spin_lock_irqsave(lock, flags)  \
+do {                                    \
+    cli_and_save(flags);                \
+    spin_lock(lock);                    \
+} while (0)
+
+#define spin_unlock_irqrestore(lock, flags) \
+do {                                        \
+    spin_unlock(lock);                      \
+    restore_flags(flags);                   \
+} while (0)
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef _SWITCH_S_H
+#define _SWITCH_S_H
+
+/*
+    This is the header file for the .S file that holds the kernel context switch. The offsets below
+    must match the layout of context_t.
+*/
+
+#define CTX_ESP 0
+#define CTX_EBP 4
+#define CTX_EBX 8
+#define CTX_ESI 12
+#define CTX_EDI 16
+#define CTX_EIP 20
+
+#ifndef ASM
+
+#include "types.h"
+
+/* kernel context of a process that is switched out. Only callee-saved registers are kept,
+ * everything else is already dead across the call to switch_to */
+typedef struct context_t{
+    uint32_t esp;
+    uint32_t ebp;
+    uint32_t ebx;
+    uint32_t esi;
+    uint32_t edi;
+    uint32_t eip;
+}context_t;
+
+// save the current kernel context into prev and resume next
+extern void switch_to(context_t* prev, context_t* next);
+
+// first code of a process started by spawn: its context's esp points at an iret frame
+extern void user_start();
+
+#endif /* ASM */
+
+#endif
@@ -10,6 +10,9 @@
 // assembly linked function for systemcall handler. 
 extern void systemcall_link();
 
+// fast entry through SYSENTER, see sysenter_init
+extern void sysenter_link();
+
 #endif
 
 
@@ -15,6 +15,17 @@
 #include "x86_desc.h"
 #include "excepts.h"
 #include "scheduler.h"
+#include "timer.h"
+#include "fpu.h"
+#include "kinfo.h"
+#include "ioring.h"
+#include "systrace.h"
+#include "signal.h"
+#include "pipe.h"
+#include "poll.h"
+#include "switch_s.h"
+#include "klog.h"
+#include "serial.h"
 
 /* This link function is defined externally, in system_s.S. This function will call the defined .c systemcall_handler below */
 extern void systemcall_link(); 
@@ -44,12 +55,70 @@ void init_syscall_idt(){
     
 }
 
-/* systemcall_handler
+static int32_t do_systemcall(int32_t syscall, int32_t arg1, int32_t arg2, int32_t arg3);
+
+/* set when the cpu has SYSENTER/SYSEXIT and the MSRs are programmed, published in the kinfo page */
+uint32_t has_sep = 0;
+
+/* sysenter_init
  *   Inputs: none
  *   Return Value: none
- *   Function: Handler for any systemcall */
+ *   Function: Points the SYSENTER MSRs at sysenter_link. SYSENTER loads cs from SYSENTER_CS and
+ *             ss from the next descriptor, and SYSEXIT uses the two after that, which is the
+ *             KERNEL_CS, KERNEL_DS, USER_CS, USER_DS order of the GDT. Run once on every cpu. */
+void sysenter_init(){
+    uint32_t eax, ebx, ecx, edx;
+
+    eax = 1;
+    asm volatile ("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+    if (!(edx & CPUID_SEP))
+        return;
+
+    wrmsr(MSR_SYSENTER_CS, KERNEL_CS, 0);
+    wrmsr(MSR_SYSENTER_ESP, tss.esp0, 0);
+    wrmsr(MSR_SYSENTER_EIP, (uint32_t)sysenter_link, 0);
+    has_sep = 1;
+}
+
+/* set_kernel_stack
+ *   Inputs: esp0 - top of the kernel stack of the process about to run
+ *   Return Value: none
+ *   Function: where both int 0x80 (through the TSS) and SYSENTER (through its MSR) land */
+void set_kernel_stack(uint32_t esp0){
+    tss.ss0 = KERNEL_DS;
+    tss.esp0 = esp0;
+    if (has_sep)
+        wrmsr(MSR_SYSENTER_ESP, esp0, 0);
+}
+
+/* systemcall_handler
+ *   Inputs: syscall - number, arg1-3 - arguments
+ *   Return Value: whatever the system call returns
+ *   Function: Handler for any systemcall, timed and counted for systrace */
 int32_t systemcall_handler(int32_t syscall, int32_t arg1, int32_t arg2, int32_t arg3){
+    uint64_t start;
+    int32_t ret;
+
+    if (active_pid >= 0)
+        pcb_ptr[active_pid]->nsyscalls++;
+
+    /* halt does not come back here, count it on the way in */
+    if (syscall == SYS_HALT) {
+        systrace_record(syscall, arg1, arg2, arg3, arg1 & 0xFF, 0);
+        return do_systemcall(syscall, arg1, arg2, arg3);
+    }
+
+    start = rdtsc();
+    ret = do_systemcall(syscall, arg1, arg2, arg3);
+    systrace_record(syscall, arg1, arg2, arg3, ret, rdtsc() - start);
+    return ret;
+}
 
+/* do_systemcall
+ *   Inputs: syscall - number, arg1-3 - arguments
+ *   Return Value: whatever the system call returns, -1 for an unknown number
+ *   Function: dispatches to the system call */
+static int32_t do_systemcall(int32_t syscall, int32_t arg1, int32_t arg2, int32_t arg3){
     switch(syscall){
         case SYS_HALT:
             return halt((uint8_t)arg1);
@@ -75,6 +144,63 @@ int32_t systemcall_handler(int32_t syscall, int32_t arg1, int32_t arg2, int32_t
         case SYS_VIDMAP:    
             return vidmap((uint8_t**)arg1);
             break; 
+        case SYS_SET_HANDLER:
+            return set_handler(arg1, (void*)arg2);
+            break;
+        case SYS_SIGRETURN:
+            return sigreturn();
+            break;
+        case SYS_SCHED_SETRT:
+            return sched_setrt((uint32_t)arg1, (uint32_t)arg2);
+            break;
+        case SYS_SCHED_GETRT:
+            return sched_getrt((rt_stat_t*)arg1);
+            break;
+        case SYS_SLEEP:
+            return sleep((uint32_t)arg1);
+            break;
+        case SYS_NANOSLEEP:
+            return nanosleep((const timespec_t*)arg1, (timespec_t*)arg2);
+            break;
+        case SYS_YIELD:
+            return yield();
+            break;
+        case SYS_CPUSTATS:
+            return cpustats((cpu_stats_t*)arg1);
+            break;
+        case SYS_IORING_SETUP:
+            return ioring_setup((io_ring_t*)arg1);
+            break;
+        case SYS_IORING_ENTER:
+            return ioring_enter((uint32_t)arg1);
+            break;
+        case SYS_SYSTRACE:
+            return systrace(arg1, arg2, (void*)arg3);
+            break;
+        case SYS_ALARM:
+            return alarm((uint32_t)arg1);
+            break;
+        case SYS_PIPE:
+            return pipe((int32_t*)arg1);
+            break;
+        case SYS_SPAWN:
+            return spawn((const uint8_t*)arg1, (const int32_t*)arg2, (uint32_t)arg3);
+            break;
+        case SYS_POLL:
+            return poll((pollfd_t*)arg1, (uint32_t)arg2, arg3);
+            break;
+        case SYS_FCNTL:
+            return fcntl(arg1, arg2, arg3);
+            break;
+        case SYS_DUP:
+            return dup(arg1);
+            break;
+        case SYS_DUP2:
+            return dup2(arg1, arg2);
+            break;
+        case SYS_DMESG:
+            return dmesg((uint32_t*)arg1, (uint8_t*)arg2, arg3);
+            break;
         default:
             return -1; //not a valid syscall
     }
@@ -95,8 +221,6 @@ int32_t halt(uint8_t status) {
     uint32_t flags;
     cli_and_save(flags);
     
-    int i;
-    
     /* Some useful vars */
     int term_id = pcb_ptr[active_pid]->t_id;
     int parent_pid = pcb_ptr[active_pid]->parent_pid;
@@ -104,20 +228,38 @@ int32_t halt(uint8_t status) {
 
     /* If current PID is base shell, then do nothing (base shell cannot be exited) */
     if (active_pid >= 0 && active_pid <=2) { 
-        printf("Cannot halt base shell!");
+        printk(KLOG_WARN, "Cannot halt base shell!\n");
         return 0;
     }
 
-    /* Close relevant FDs */
-    for(i=0; i<8; i++)
-        pcb_ptr[active_pid]->fd_array[i].in_use = 0;
+    /* Drop any real-time reservation and pending sleep */
+    rt_clear(active_pid);
+    timer_del(&pcb_ptr[active_pid]->sleep_timer);
+    pcb_ptr[active_pid]->sleeping = 0;
+    signal_exit(active_pid);
+    terminal_release(active_pid);
+
+    /* Throw away fpu state, parent gets the fpu back through #NM */
+    fpu_release(active_pid);
+
+    /* Close relevant FDs (open files shared with other processes stay open) */
+    fd_close_all();
+
+    /* a spawned process has no execute to return to, nor anyone to see that it died by exception */
+    if (pcb_ptr[active_pid]->detached) {
+        exception_flag = 0;
+        proc_exit();
+    }
 
     /* mark process as not current, set highest current process for terminal */
     pcb_ptr[active_pid]->current = 0;
-    term_cur_pid[term_id] = parent_pid;
+    if (term_cur_pid[term_id] == active_pid)
+        term_cur_pid[term_id] = parent_pid;
 
     /* set PCB as not in use, set parent as current */
+    spin_lock(&pcb_lock);
     pcb_ptr[active_pid]->pid_in_use = 0;
+    spin_unlock(&pcb_lock);
 
     /* Set new active_pid, set parent as current highest process */
     active_pid = parent_pid;
@@ -140,15 +282,15 @@ int32_t halt(uint8_t status) {
     page_dir[32].page_dir_entry_4mb_t.reserved = 0;
     page_dir[32].page_dir_entry_4mb_t.page_base_address = ((EIGHT_MB + (active_pid*FOUR_MB)) >> 22); // align the page_table address to 4MB boundary
 
-    /* mark vidmem page as not present*/
-    video_page_table[0].present = 0;
+    /* vidmem page as the parent had it */
+    vidmap_sync(active_pid);
 
     /* Flush TLB */
     flush_tlb();
 
     /* Restore TSS */
-    tss.ss0 = KERNEL_DS;
-    tss.esp0 = (EIGHT_MB - (active_pid)*EIGHT_KB);
+    set_kernel_stack(EIGHT_MB - (active_pid)*EIGHT_KB);
+    kinfo_update();
 
     /* restore stack */
     register uint32_t s_esp = pcb_ptr[old_pid]->esp_exec;
@@ -183,6 +325,72 @@ int32_t halt(uint8_t status) {
 uint8_t ELF[] = {0177, 'E', 'L', 'F'};
 
 int32_t execute(const uint8_t* command) {
+    return execute_io(command, NULL, 0);
+}
+
+/* spawn
+    *   Inputs: command - as for execute
+    *           io - the caller's fds that become the program's stdin (io[0]) and stdout (io[1]), NULL for the caller's own
+    *           flags - SPAWN_NOWAIT to return as soon as the program is loaded
+    *   Return Value: -1 on failure; with SPAWN_NOWAIT the new pid, otherwise what execute returns
+    *   Function: spawn system call. Runs a program with its stdin/stdout redirected, either in place of the caller
+    *             like execute, or alongside it on the same terminal (pipelines). A program started with SPAWN_NOWAIT
+    *             frees itself when it halts, nobody collects its status.
+ */
+int32_t spawn(const uint8_t* command, const int32_t* io, uint32_t flags) {
+    int32_t fds[2] = {0, 1};
+    int i;
+
+    if (io != NULL) {
+        if (bad_userspace_addr(io, 2*sizeof(int32_t)))
+            return -1;
+        for (i = 0; i < 2; i++) {
+            fds[i] = io[i];
+            if (fd_get(fds[i]) == NULL)
+                return -1;
+        }
+    }
+    return execute_io(command, fds, flags & SPAWN_NOWAIT);
+}
+
+/* start_detached
+    *   Inputs: parent_pid - process that called spawn, entry_point/user_esp - where the new program starts,
+    *           flags - interrupt state the caller saved
+    *   Return Value: pid of the new process
+    *   Function: Called by execute_io with the new process's paging and TSS loaded. Instead of entering the program
+    *             now, leaves an iret frame at the top of its kernel stack for the scheduler to switch to (user_start),
+    *             then puts the caller's paging and TSS back.
+ */
+static int32_t start_detached(int32_t parent_pid, uint32_t entry_point, uint32_t user_esp, uint32_t flags) {
+    int32_t pid = active_pid;
+    uint32_t* frame = (uint32_t*)(EIGHT_MB - pid*EIGHT_KB) - 5;
+
+    frame[0] = entry_point;
+    frame[1] = USER_CS;
+    frame[2] = 0x202;                   // IF set
+    frame[3] = user_esp;
+    frame[4] = USER_DS;
+    pcb_ptr[pid]->context.esp = (uint32_t)frame;
+    pcb_ptr[pid]->context.ebp = 0;
+    pcb_ptr[pid]->context.eip = (uint32_t)user_start;
+
+    active_pid = parent_pid;
+    page_dir[32].page_dir_entry_4mb_t.page_base_address = ((EIGHT_MB + (active_pid*FOUR_MB)) >> 22);
+    vidmap_sync(active_pid);
+    flush_tlb();
+    set_kernel_stack(EIGHT_MB - (active_pid)*EIGHT_KB);
+    kinfo_update();
+
+    restore_flags(flags);
+    return pid;
+}
+
+/* execute_io
+    *   Inputs: command - as for execute, io - parent's fds for stdin/stdout (NULL for 0 and 1), detached - run
+    *           alongside the parent instead of in its place
+    *   Return Value: as for execute, or the new pid when detached
+    *   Function: execute and spawn */
+int32_t execute_io(const uint8_t* command, const int32_t* io, int32_t detached) {
     uint8_t args[128];
     uint32_t flags;
 
@@ -205,11 +413,11 @@ int32_t execute(const uint8_t* command) {
     /* Parse filename/arguments */
     j=0;
     for (i = 0; i < strlen((const int8_t*)command); i++) {
-        if (command[i] == ' ') // check if space is found
+        if (space_found == 0 && command[i] == ' ') // check if space is found
             space_found = 1;
         else if (space_found == 0) // if no space found, add to filename
             filename[i] = command[i];
-        else {                      // if space found, add to args
+        else if ((j > 0 || command[i] != ' ') && j < MAX_BUFFER_SIZE-1) { // if space found, add to args (without leading spaces)
             args[j] = command[i];
             j++;
         }
@@ -217,7 +425,7 @@ int32_t execute(const uint8_t* command) {
     
     /* get inode if valid file to use for read data */
     if(read_dentry_by_name(filename, &new_dentry) == -1)
-        { printf("execute: File doesn't exist \n"); return -1; }
+        { printk(KLOG_WARN, "execute: File doesn't exist \n"); return -1; }
 
     /* read first 4 bytes (check for del and ELF const)*/
     read_data(new_dentry.inode_id, 0, read_buffer, 4);
@@ -225,43 +433,48 @@ int32_t execute(const uint8_t* command) {
     /* Check that file is executable */
     for (i=0; i<ELF_SIZE; i++) {
         if (ELF[i] != read_buffer[i])
-            { printf("execute: Not an executable \n"); return -1; }
+            { printk(KLOG_WARN, "execute: Not an executable \n"); return -1; }
     }
     
-    /* Set parent pid */  
-    parent_pid = term_cur_pid[cur_terminal]; 
-
-    /* Find/set active PID */
-    if(base_shells_opened==3){
-        /* If all base shells have been opened, iterate through processes to one not in use */
-        for(i=0; i<=MAX_PROCESSES; i++){
+    /* Set parent pid (the process runs on the terminal this cpu is serving, not necessarily the visible one) */  
+    parent_pid = (term_cur_pid[active_tid] == -1) ? -1 : active_pid; 
+
+    /* Find/set active PID. Other cpus allocate pids too */
+    spin_lock(&pcb_lock);
+    if(parent_pid != -1){
+        /* Terminal already has its base shell, iterate through processes to one not in use (0-2 are the base shells) */
+        for(i=NUM_TERMINALS; i<=MAX_PROCESSES; i++){
             /* reached max processes */
             if(i==MAX_PROCESSES)
-                { printf("execute: Six processes already open \n"); return -1; }
+                { spin_unlock(&pcb_lock); printk(KLOG_WARN, "execute: Six processes already open \n"); return -1; }
 
             /* check if process in use, if not then set as active_pid, set in use */
             if (pcb_ptr[i]->pid_in_use==0) {
                 active_pid = i; 
                 pcb_ptr[active_pid]->pid_in_use=1;
-                term_cur_pid[cur_terminal] = active_pid; // set new highest process for cur terminal
                 break;
             }
         }
-    } else { /* Base shells have not all been opened, open base shells */
-        active_pid = base_shells_opened;
+    } else { /* Base shell of this terminal, its pid is the terminal id */
+        active_pid = active_tid;
         pcb_ptr[active_pid]->pid_in_use=1;
         base_shells_opened++;
-        term_cur_pid[cur_terminal] = active_pid; // set new highest process for cur terminal
-        if (base_shells_opened==3) // set the current terminal back to terminal 0 (when all terminals finished opening)
-            cur_terminal = 0;
     }
+    spin_unlock(&pcb_lock);
+
+    /* set new highest process for this terminal, unless the program runs alongside its parent or the parent
+       itself is not the highest (one stage of a pipeline running another program) */
+    if (parent_pid == -1 || (!detached && term_cur_pid[active_tid] == parent_pid))
+        term_cur_pid[active_tid] = active_pid;
    
     // add pid to scheduler
     pcb_ptr[active_pid]->current = 1;
+    pcb_ptr[active_pid]->detached = detached;
 
     if (active_pid >= 3){ // process 3 and above have a parent process
         pcb_ptr[active_pid]->parent_pid = parent_pid;
-        pcb_ptr[parent_pid]->current = 0; 
+        if (!detached)
+            pcb_ptr[parent_pid]->current = 0; 
         pcb_ptr[active_pid]->t_id = pcb_ptr[parent_pid]->t_id;
     } 
     else{ // process 0, 1, 2 (base shells) have no parent process
@@ -277,8 +490,32 @@ int32_t execute(const uint8_t* command) {
 
 
     //initialize file array entries to not in use
-    for(i=0; i<8; i++)
-        pcb_ptr[active_pid]->fd_array[i].in_use = 0;
+    fd_table_init(active_pid);
+
+    /* stdin/stdout are shared with the parent (or are the fds it passed to spawn), a base shell opens the terminal */
+    if (parent_pid != -1) {
+        for (i=0; i<2; i++) {
+            file_arr_entry_t* file = pcb_ptr[parent_pid]->fd_table[(io != NULL) ? io[i] : i];
+            if (file != NULL) {
+                file_get(file);
+                pcb_ptr[active_pid]->fd_table[i] = file;
+            }
+        }
+    }
+
+    /* new program starts with a clean fpu on first use */
+    fpu_release(active_pid);
+
+    /* reset cpu accounting */
+    memcpy(pcb_ptr[active_pid]->name, filename, PROC_NAME_LEN);
+    pcb_ptr[active_pid]->name[PROC_NAME_LEN-1] = '\0';
+    pcb_ptr[active_pid]->utime = 0;
+    pcb_ptr[active_pid]->stime = 0;
+    pcb_ptr[active_pid]->nsyscalls = 0;
+    pcb_ptr[active_pid]->ring = NULL;
+    pcb_ptr[active_pid]->vidmapped = 0;
+    signal_reset(active_pid);
+    systrace_exec(active_pid, (active_pid >= 3) ? parent_pid : -1);
 
     /* Add PID page */
     page_dir[32].page_dir_entry_4mb_t.present = 1;
@@ -295,6 +532,9 @@ int32_t execute(const uint8_t* command) {
     page_dir[32].page_dir_entry_4mb_t.reserved = 0;
     page_dir[32].page_dir_entry_4mb_t.page_base_address = ((EIGHT_MB + (active_pid*FOUR_MB)) >> 22); // align the page_table address to 4MB boundary
 
+    /* no vidmap page until the new program asks for one */
+    vidmap_sync(active_pid);
+
     /* Flush TLB */
     flush_tlb();
 
@@ -307,11 +547,15 @@ int32_t execute(const uint8_t* command) {
     read_data(new_dentry.inode_id, 24, (uint8_t*) &entry_point, 4); // 24 is the offset of the entry point in the file, read 4 bytes
     
     /* Set up stdin and stdout */
-    terminal_open((const uint8_t*)"");
+    if (parent_pid == -1)
+        terminal_open((const uint8_t*)"");
 
 
     uint32_t user_esp = KERNEL_BASE + FOUR_MB - 4;
     register uint32_t ret;
+
+    if (detached)
+        return start_detached(parent_pid, entry_point, user_esp, flags);
     
     /* Save EBP/ESP*/
     register uint32_t s_esp asm("%esp"); 
@@ -321,8 +565,8 @@ int32_t execute(const uint8_t* command) {
 
 
     /* Set TSS entries */
-    tss.ss0 = KERNEL_DS;
-    tss.esp0 = (EIGHT_MB - (active_pid)*EIGHT_KB);
+    set_kernel_stack(EIGHT_MB - (active_pid)*EIGHT_KB);
+    kinfo_update();
     
     /* Enable interrupts (interrupt switch) */
     restore_flags(flags);
@@ -366,22 +610,19 @@ int32_t execute(const uint8_t* command) {
  *   Function: reads from indicated file
 */
 int32_t read(int32_t fd, void* buf, int32_t nbytes){
-
-    if(fd<0 || fd>7){
-        return -1; 
-    }
+    file_arr_entry_t* file = fd_get(fd);
 
     if(fd==1){
         //cannot read from stdout, is write-only
         return -1; 
     }
 
-    if(pcb_ptr[active_pid]->fd_array[fd].in_use!=1){
+    if(file==NULL){
         //printf("ERR in read: trying to read from fd %d which is not in use \n", fd);
         return -1; 
     }
 
-    return pcb_ptr[active_pid]->fd_array[fd].file_op_tbl_ptr->read_func(fd, buf, nbytes);
+    return file->file_op_tbl_ptr->read_func(fd, buf, nbytes);
 
 }
 
@@ -394,10 +635,7 @@ int32_t read(int32_t fd, void* buf, int32_t nbytes){
  *   Function: writes to inidicated file
 */
 int32_t write(int32_t fd, const void* buf, int32_t nbytes){
-    
-    if(fd<0 || fd>7){
-        return -1; 
-    }
+    file_arr_entry_t* file = fd_get(fd);
 
     if(fd==0){
         // cannot write to stdin -- is read-only
@@ -405,12 +643,12 @@ int32_t write(int32_t fd, const void* buf, int32_t nbytes){
     }
 
 
-    if(pcb_ptr[active_pid]->fd_array[fd].in_use!=1){
+    if(file==NULL){
         //printf("ERR in write: trying to write to fd %d which is not in use \n", fd);
         return -1; 
     }
 
-    return pcb_ptr[active_pid]->fd_array[fd].file_op_tbl_ptr->write_func(fd, buf, nbytes);
+    return file->file_op_tbl_ptr->write_func(fd, buf, nbytes);
 }
 
 
@@ -425,6 +663,10 @@ int32_t open(const uint8_t* filename){
     // create array of function pointers with int32_t type (since all these functions return int32_t). all functions have one arg of type const uint8_t*
     int32_t (*func_open_table[])(const uint8_t*) = {rtc_open, dir_open, file_open};
 
+    /* devices with no file system entry */
+    if (strncmp((const int8_t*)filename, SERIAL_NAME, sizeof(SERIAL_NAME)) == 0)
+        return serial_open(filename);
+
     // call correct open function depending on file type
     // get dentry to know file type
     int32_t i = read_dentry_by_name(filename, dentry);
@@ -446,25 +688,51 @@ int32_t open(const uint8_t* filename){
 */
 int32_t close(int32_t fd){
 
-    // check that fd is valid
-    if(fd<0 || fd >7){
-        //printf("ERR in close: invalid fd given in close function \n");
-        return -1; 
-    }
-
     // cannot close stdin or stdout
     if(fd==0 || fd==1){
         return -1; 
     }
 
-    if(pcb_ptr[active_pid]->fd_array[fd].in_use!=1){
-       // printf("ERR in close: trying to perform close on fd that's not in use \n");
-        return -1; 
-    }
+    // call close func (for the last fd of the open file) -- should remove from fd array
+    return fd_close(fd);
+
+}
+
 
-    // call close func -- should remove from fd array
-    return pcb_ptr[active_pid]->fd_array[fd].file_op_tbl_ptr->close_func(fd);
+/* fcntl
+ *   Inputs: fd:    file descriptor
+ *           cmd:   F_GETFL or F_SETFL
+ *           arg:   for F_SETFL, the new flags (O_NONBLOCK, and O_RAW on a terminal)
+ *   Return Value: F_GETFL the flags, F_SETFL 0; -1 on a bad fd, command or flag
+ *   Function: reads or changes the flags of an open fd. O_RAW changes the whole terminal (for every
+ *             fd on it) until cleared or until the process that set it halts
+*/
+int32_t fcntl(int32_t fd, int32_t cmd, int32_t arg){
+    file_arr_entry_t* entry = fd_get(fd);
+    int32_t is_term;
 
+    if(entry==NULL){
+        return -1; 
+    }
+    is_term = (entry->file_op_tbl_ptr == &term_funcs);
+
+    switch(cmd){
+        case F_GETFL:
+            return (entry->nonblock ? O_NONBLOCK : 0) | ((is_term && terminals[active_tid].raw_pid >= 0) ? O_RAW : 0)
+                    | ((is_term && terminals[active_tid].sync_pid >= 0) ? O_SYNC : 0);
+        case F_SETFL:
+            if((arg & ~(O_NONBLOCK | O_RAW | O_SYNC)) || ((arg & (O_RAW | O_SYNC)) && !is_term)){
+                return -1; 
+            }
+            if(is_term){
+                terminal_set_raw((arg & O_RAW) != 0);
+                terminal_set_sync((arg & O_SYNC) != 0);
+            }
+            entry->nonblock = ((arg & O_NONBLOCK) != 0);
+            return 0;
+        default:
+            return -1; 
+    }
 }
 
 
@@ -480,7 +748,7 @@ int32_t getargs(uint8_t* buf, int32_t nbytes){
     cli();
     /* Check buffer is valid */
     if (buf==NULL || nbytes<0)
-        { printf("Invalid Argument to getargs"); return -1; }
+        { printk(KLOG_WARN, "Invalid Argument to getargs\n"); return -1; }
     
     /* Get the current PCB */
     pcb_entry_t * cur_pcb = (pcb_entry_t*) pcb_ptr[active_pid];
@@ -502,6 +770,17 @@ int32_t getargs(uint8_t* buf, int32_t nbytes){
 }
 
 
+/* vidmap_sync
+ *   Inputs: pid - process about to run on this cpu
+ *   Return Value: none
+ *   Function: points this cpu's vidmap page at the first VGA page of pid's terminal if pid has
+ *             called vidmap, else makes it absent. The only mapping that changes with the
+ *             process; the caller flushes the TLB, which it does for the program page anyway */
+void vidmap_sync(int32_t pid){
+    video_page_table[0].present = pcb_ptr[pid]->vidmapped;
+    video_page_table[0].page_base_address = TERMINAL_VIDMEM_PTR[pcb_ptr[pid]->t_id] >> 12;
+}
+
 /* vidmap
  *   Inputs: screen_start: points to start of video memory
  *   Return Value: 132MB address on success (from *screen_start), -1 on failure 
@@ -515,9 +794,6 @@ int32_t vidmap(uint8_t** screen_start){
         return -1;
     }
 
-    /* Set the physical address */
-    uint32_t video_page_addr = 0xB8000;  //page base address for entry (videomem)
-
     /* add 4kb video page (132MB/4MB = 33 for pd index) */ 
     page_dir[33].page_dir_entry_4kb_t.present = 1;
     page_dir[33].page_dir_entry_4kb_t.read_write = 1;
@@ -526,16 +802,14 @@ int32_t vidmap(uint8_t** screen_start){
     page_dir[33].page_dir_entry_4kb_t.page_table_base_address =  ((unsigned int)video_page_table) >> 12; // align the page_table address to 4KB boundary
 
     /* entry into page table */
-    video_page_table[0].present = 1;
     video_page_table[0].page_cache_disable = 0;      
     video_page_table[0].read_write = 1;
     video_page_table[0].user_supervisor = 1;
 
-    if(active_tid == cur_terminal){
-        video_page_table[0].page_base_address = (video_page_addr) >> 12;
-    }else{
-        video_page_table[0].page_base_address = (TERMINAL_VIDMEM_PTR[active_tid]) >> 12;
-    }
+    /* the terminal's first page, where its screen is moved back to if it has scrolled on */
+    screen_home();
+    pcb_ptr[active_pid]->vidmapped = 1;
+    vidmap_sync(active_pid);
  
 
     /* Flush TLB */
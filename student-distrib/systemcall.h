@@ -14,6 +14,39 @@
 #define SYS_VIDMAP  8
 #define SYS_SET_HANDLER  9
 #define SYS_SIGRETURN  10
+#define SYS_SCHED_SETRT 11
+#define SYS_SCHED_GETRT 12
+#define SYS_SLEEP 13
+#define SYS_NANOSLEEP 14
+#define SYS_YIELD 15
+#define SYS_CPUSTATS 16
+#define SYS_IORING_SETUP 17
+#define SYS_IORING_ENTER 18
+#define SYS_SYSTRACE 19
+#define SYS_ALARM 20
+#define SYS_PIPE 21
+#define SYS_SPAWN 22
+#define SYS_POLL 23
+#define SYS_FCNTL 24
+#define SYS_DUP 25
+#define SYS_DUP2 26
+#define SYS_DMESG 27
+
+/* SYSENTER model-specific registers */
+#define MSR_SYSENTER_CS  0x174
+#define MSR_SYSENTER_ESP 0x175
+#define MSR_SYSENTER_EIP 0x176
+#define CPUID_SEP (1 << 11)
+
+/* spawn flags */
+#define SPAWN_NOWAIT 0x1
+
+/* fcntl commands and fd flags */
+#define F_GETFL 3
+#define F_SETFL 4
+#define O_NONBLOCK 0x800    // read/write return -1 instead of waiting
+#define O_RAW 0x1000        // terminal fds only: keys are read one at a time as typed, unechoed
+#define O_SYNC 0x2000       // terminal fds only: each write is on screen when it returns
 
 #define ELF_SIZE 4
 #define EIGHT_MB 0x800000
@@ -25,20 +58,29 @@
 #define VIDEO       0xB8000
 
 
+#ifndef ASM
+
 extern int32_t systemcall_handler(int32_t syscall, int32_t arg1, int32_t arg2, int32_t arg_3);
 extern void init_syscall_idt();
+extern void sysenter_init();
+extern uint32_t has_sep;
+extern void set_kernel_stack(uint32_t esp0);
 extern int cur_pid; 
 extern int parent_pid; 
 
 int32_t halt(uint8_t status);
 int32_t execute(const uint8_t* command);
+int32_t execute_io(const uint8_t* command, const int32_t* io, int32_t detached);
+int32_t spawn(const uint8_t* command, const int32_t* io, uint32_t flags);
 int32_t read(int32_t fd, void* buf, int32_t nbytes);
 int32_t write(int32_t fd, const void* buf, int32_t nbytes);
 int32_t open(const uint8_t* filename);
 int32_t close(int32_t fd);
+int32_t fcntl(int32_t fd, int32_t cmd, int32_t arg);
 int32_t getargs(uint8_t* buf, int32_t nbytes);
 int32_t vidmap(uint8_t** screen_start);
-//int32_t set_handler(int32_t signum, void* handler_address);
-//int32_t sigreturn(void);
+void vidmap_sync(int32_t pid);
+
+#endif /* ASM */
 
 #endif
@@ -0,0 +1,163 @@
+/* systrace.c - system call counters, latency histograms and per-process call logs.
+ *
+ * systemcall_handler times every call with rdtsc and hands it to systrace_record. The system-wide
+ * counters always run. A process can also ask for the programs it executes to be traced: their
+ * calls (and those of anything they execute) are logged into the asking process's buffer, which
+ * it reads back once they are done. That is all an strace-like tool needs. */
+
+#include "systrace.h"
+#include "systemcall.h"
+#include "lib.h"
+#include "pcb.h"
+#include "scheduler.h"
+#include "spinlock.h"
+
+/* calls logged on behalf of one tracing process, indexed by the tracer's pid */
+typedef struct trace_buf_t{
+    uint32_t head;                  // next entry to read
+    uint32_t tail;                  // next entry to write, runs freely
+    sc_stat_t sum[SYSTRACE_NR];
+    sc_trace_t log[SYSTRACE_LOG];
+}trace_buf_t;
+
+static sc_stat_t stats[SYSTRACE_NR];
+static trace_buf_t trace_bufs[MAX_PROCESSES];
+
+/* stats and trace_bufs are written from every cpu */
+static spinlock_t trace_lock = SPINLOCK_INIT;
+
+/* stat_add
+ *   Inputs: stat - counters to update, ret/cycles - outcome of the call
+ *   Return Value: none */
+static void stat_add(sc_stat_t* stat, int32_t ret, uint64_t cycles){
+    uint32_t bucket = 0;
+
+    if (cycles >> 32)
+        bucket = SYSTRACE_BUCKETS - 1;
+    else if ((uint32_t)cycles != 0)
+        asm ("bsrl %1, %0" : "=r"(bucket) : "r"((uint32_t)cycles));
+
+    stat->count++;
+    if (ret == -1)
+        stat->errors++;
+    stat->cycles += cycles;
+    stat->hist[bucket]++;
+}
+
+/* systrace_record
+ *   Inputs: nr - system call number, arg1-3 - its arguments, ret - its return value,
+ *           cycles - time from entry to return
+ *   Return Value: none
+ *   Function: counts a finished call and logs it if the calling process is traced */
+void systrace_record(int32_t nr, int32_t arg1, int32_t arg2, int32_t arg3, int32_t ret, uint64_t cycles){
+    uint32_t flags;
+    int32_t tracer;
+    trace_buf_t* tb;
+    sc_trace_t* entry;
+
+    if (nr < 0 || nr >= SYSTRACE_NR)
+        nr = 0;
+    tracer = (active_pid >= 0) ? pcb_ptr[active_pid]->tracer : -1;
+
+    spin_lock_irqsave(&trace_lock, flags);
+    stat_add(&stats[nr], ret, cycles);
+
+    if (tracer >= 0) {
+        tb = &trace_bufs[tracer];
+        stat_add(&tb->sum[nr], ret, cycles);
+
+        /* the log keeps the newest SYSTRACE_LOG calls */
+        if (tb->tail - tb->head == SYSTRACE_LOG)
+            tb->head++;
+        entry = &tb->log[tb->tail % SYSTRACE_LOG];
+        entry->pid = active_pid;
+        entry->nr = nr;
+        entry->reserved = 0;
+        entry->args[0] = arg1;
+        entry->args[1] = arg2;
+        entry->args[2] = arg3;
+        entry->ret = ret;
+        entry->cycles = (cycles >> 32) ? 0xFFFFFFFF : (uint32_t)cycles;
+        tb->tail++;
+    }
+    spin_unlock_irqrestore(&trace_lock, flags);
+}
+
+/* systrace_exec
+ *   Inputs: pid - process being started, parent_pid - its parent, -1 for a base shell
+ *   Return Value: none
+ *   Function: a new program is traced for its parent if the parent traces its children, and
+ *             stays traced for whoever traces the parent otherwise */
+void systrace_exec(int32_t pid, int32_t parent_pid){
+    pcb_ptr[pid]->trace_children = 0;
+    if (parent_pid < 0)
+        pcb_ptr[pid]->tracer = -1;
+    else if (pcb_ptr[parent_pid]->trace_children)
+        pcb_ptr[pid]->tracer = parent_pid;
+    else
+        pcb_ptr[pid]->tracer = pcb_ptr[parent_pid]->tracer;
+}
+
+/* systrace
+ *   Inputs: op - SYSTRACE_*, arg - depends on op, buf - user buffer for the results
+ *   Return Value: number of log entries for SYSTRACE_READ_LOG, 0 for the others, -1 on failure
+ *   Function: system call interface to the counters and the trace log */
+int32_t systrace(int32_t op, int32_t arg, void* buf){
+    uint32_t flags;
+    trace_buf_t* tb = &trace_bufs[active_pid];
+    sc_trace_t* out = (sc_trace_t*)buf;
+    int32_t n = 0;
+
+    switch (op) {
+        case SYSTRACE_STATS:
+            if (bad_userspace_addr(buf, sizeof(stats)))
+                return -1;
+            spin_lock_irqsave(&trace_lock, flags);
+            memcpy(buf, stats, sizeof(stats));
+            spin_unlock_irqrestore(&trace_lock, flags);
+            return 0;
+
+        case SYSTRACE_RESET:
+            spin_lock_irqsave(&trace_lock, flags);
+            memset(stats, 0, sizeof(stats));
+            spin_unlock_irqrestore(&trace_lock, flags);
+            return 0;
+
+        case SYSTRACE_CHILDREN:
+            spin_lock_irqsave(&trace_lock, flags);
+            if (arg) {
+                tb->head = tb->tail = 0;
+                memset(tb->sum, 0, sizeof(tb->sum));
+            }
+            pcb_ptr[active_pid]->trace_children = (arg != 0);
+            spin_unlock_irqrestore(&trace_lock, flags);
+            return 0;
+
+        case SYSTRACE_READ_LOG:
+            if (arg < 0)
+                return -1;
+            /* no more than the log holds, and arg * sizeof below cannot wrap */
+            if (arg > SYSTRACE_LOG)
+                arg = SYSTRACE_LOG;
+            if (bad_userspace_addr(buf, arg * sizeof(sc_trace_t)))
+                return -1;
+            spin_lock_irqsave(&trace_lock, flags);
+            while (n < arg && tb->head != tb->tail) {
+                out[n++] = tb->log[tb->head % SYSTRACE_LOG];
+                tb->head++;
+            }
+            spin_unlock_irqrestore(&trace_lock, flags);
+            return n;
+
+        case SYSTRACE_SUMMARY:
+            if (bad_userspace_addr(buf, sizeof(tb->sum)))
+                return -1;
+            spin_lock_irqsave(&trace_lock, flags);
+            memcpy(buf, tb->sum, sizeof(tb->sum));
+            spin_unlock_irqrestore(&trace_lock, flags);
+            return 0;
+
+        default:
+            return -1;
+    }
+}
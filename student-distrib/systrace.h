@@ -0,0 +1,42 @@
+#ifndef _SYSTRACE_H
+#define _SYSTRACE_H
+
+#include "types.h"
+
+/* system call numbers with their own counters, anything above is counted as 0 (invalid) */
+#define SYSTRACE_NR 32
+/* latency histogram: bucket b counts calls that took [2^b, 2^(b+1)) cycles */
+#define SYSTRACE_BUCKETS 32
+/* entries kept in each tracer's log */
+#define SYSTRACE_LOG 256
+
+/* systrace operations */
+#define SYSTRACE_STATS      0       // copy the system-wide sc_stat_t[SYSTRACE_NR] to buf
+#define SYSTRACE_RESET      1       // clear the system-wide statistics
+#define SYSTRACE_CHILDREN   2       // arg != 0: trace the programs this process executes (and theirs)
+#define SYSTRACE_READ_LOG   3       // move up to arg sc_trace_t entries, oldest first, to buf
+#define SYSTRACE_SUMMARY    4       // copy the traced programs' sc_stat_t[SYSTRACE_NR] to buf
+
+/* counters of one system call. cycles run from entry to return, preemption included */
+typedef struct sc_stat_t{
+    uint32_t count;
+    uint32_t errors;                // returned -1
+    uint64_t cycles;
+    uint32_t hist[SYSTRACE_BUCKETS];
+}sc_stat_t;
+
+/* one traced call */
+typedef struct sc_trace_t{
+    uint8_t pid;
+    uint8_t nr;
+    uint16_t reserved;
+    int32_t args[3];
+    int32_t ret;
+    uint32_t cycles;                // saturates at 0xFFFFFFFF
+}sc_trace_t;
+
+extern void systrace_record(int32_t nr, int32_t arg1, int32_t arg2, int32_t arg3, int32_t ret, uint64_t cycles);
+extern void systrace_exec(int32_t pid, int32_t parent_pid);
+extern int32_t systrace(int32_t op, int32_t arg, void* buf);
+
+#endif
@@ -4,11 +4,15 @@
 #include "scheduler.h"
 #include "paging.h"
 #include "page.h"
+#include "smp.h"
+#include "poll.h"
+#include "klog.h"
 
 int32_t TERMINAL_VIDMEM_PTR[] = { TERM1_VIDMEM, TERM2_VIDMEM, TERM3_VIDMEM};
-static char* video_mem = (char *)VIDEO;
 int cur_terminal = 0; 
 
+spinlock_t console_lock = SPINLOCK_INIT;
+
 
 /* terminal_open
  *   Inputs: filename (ignore)
@@ -18,26 +22,22 @@ int32_t terminal_open(const uint8_t* filename) {
 
    
     // create stdin entry in file array at index 0
-    if(pcb_ptr[active_pid]->fd_array[0].in_use==1){
-        printf("stdin already exists \n");
+    if(fd_get(0)!=NULL){
+        printk(KLOG_WARN, "stdin already exists \n");
         return -1;
     }
 
-    cli();
-    pcb_ptr[active_pid]->fd_array[0].file_op_tbl_ptr = &term_funcs; 
-    pcb_ptr[active_pid]->fd_array[0].in_use=1; 
-    sti();
+    if(fd_install(file_alloc(&term_funcs, -1), 0)!=0)
+        return -1;
 
     // create stdout entry in file array at index 1
-    if(pcb_ptr[active_pid]->fd_array[1].in_use==1){
-        printf("stdout already exists");
+    if(fd_get(1)!=NULL){
+        printk(KLOG_WARN, "stdout already exists\n");
         return -1; 
     }
 
-    cli();
-    pcb_ptr[active_pid]->fd_array[1].file_op_tbl_ptr =&term_funcs;
-    pcb_ptr[active_pid]->fd_array[1].in_use=1; 
-    sti();
+    if(fd_install(file_alloc(&term_funcs, -1), 1)!=1)
+        return -1;
 
     return 0;
 }
@@ -51,118 +51,124 @@ int32_t terminal_close(int32_t fd) {
 }
 
 /* terminal_read
- *   Inputs: fd, buf (buffer to read into), nbytes (number of bytes to read)
+ *   Return Value: Number of bytes written, -1 if interrupted by a signal or, for an O_NONBLOCK fd, if nothing is ready
  *   Return Value: Number of bytes written
- *   Function: Reads specified number of bytes from line buffer when return is pressed, and then prints to screen */
+ *   Function: Reads the oldest line entered on the terminal, waiting for Enter if none is queued (lines typed ahead wait their turn).
+ *             In raw mode returns the keys typed so far as soon as there is one */
 int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes) {
     int num_bytes_read;
+    int nonblock = fd_get(fd)->nonblock;
 
     /* Cast the void* pointer to char* (pointer to head of array) */
     char *char_buf = (char*)buf;
-        
-    /* Copy the keyboard buffer into the terminal buffer and get number of bytes read */
-    num_bytes_read = read_line_buffer(char_buf, nbytes);
+
+    if (terminals[active_tid].raw_pid >= 0)
+        return read_raw_buffer(char_buf, nbytes, nonblock);
+
+    /* Take the next line typed and get number of bytes read */
+    num_bytes_read = read_line_buffer(char_buf, nbytes, nonblock);
+    if (num_bytes_read < 0)
+        return -1;
 
     /* Set last character as newline */
-    char_buf[num_bytes_read] = '\n';
+    if (num_bytes_read < nbytes)
+        char_buf[num_bytes_read] = '\n';
 
     if(strncmp(char_buf, "exit\n",5)==0 && term_cur_pid[cur_terminal]<3){
-        printf("cannot exit base shell \n");
+        puts("cannot exit base shell \n");
         return 0; 
     }
-  
-    /* Clear the keyboard buffer */
-    clear_line_buffer();
 
     /* return number of bytes read */
     return num_bytes_read;
 }
 
+/* terminal_poll
+ *   Inputs: fd (not used)
+ *   Return Value: POLLIN once a line has been entered on this process's terminal, POLLOUT always
+ *   Function: poll_func of the terminal */
+int32_t terminal_poll(int32_t fd) {
+    terminal_t* term = &terminals[active_tid];
+
+    if (term->raw_pid >= 0 ? term->raw_head != term->raw_tail : term->kbd_head != term->line_start)
+        return POLLIN | POLLOUT;
+    return POLLOUT;
+}
+
+/* terminal_set_raw
+ *   Inputs: raw - 1 for raw mode, 0 for line mode
+ *   Return Value: none
+ *   Function: switches the current process's terminal. Keys typed in one mode are not seen in the other */
+void terminal_set_raw(int32_t raw) {
+    terminal_t* term = &terminals[active_tid];
+
+    if (raw && term->raw_pid < 0) {
+        term->raw_head = term->raw_tail;
+        term->raw_pid = active_pid;
+    } else if (!raw) {
+        term->raw_pid = -1;
+    }
+}
+
+/* terminal_set_sync
+ *   Inputs: sync - 1 to present each write before it returns, 0 to leave it to the timer
+ *   Return Value: none
+ *   Function: sets O_SYNC on the current process's terminal */
+void terminal_set_sync(int32_t sync) {
+    terminals[active_tid].sync_pid = sync ? active_pid : -1;
+}
+
+/* terminal_release
+ *   Inputs: pid - process being halted
+ *   Return Value: none
+ *   Function: puts its terminal back in line mode if it left it raw, so the shell can read again,
+ *             and takes O_SYNC off if it set it */
+void terminal_release(int32_t pid) {
+    terminal_t* term = &terminals[pcb_ptr[pid]->t_id];
+
+    if (term->raw_pid == pid)
+        term->raw_pid = -1;
+    if (term->sync_pid == pid)
+        term->sync_pid = -1;
+}
+
 /* terminal_write
  *   Inputs: fd, buf (buffer to write to screen), nbytes (number of bytes to write)
  *   Return Value: Number of bytes written
  *   Function: Write specified number of bytes from buffer to screen */
 int32_t terminal_write(int fd, const void* buf, int32_t nbytes) {
-    int i;
-    int bytes_written=0;
-    char *char_buf = (char*)buf;
-    
-    /* Print each character in the buffer */
-    for (i=0; i < nbytes; i++) {
-        if (char_buf[i]=='\0')
-            continue;
-        putc(char_buf[i]); 
-        bytes_written++;
-    }
-    
-    /* Return number of bytes written */
-    return bytes_written;
+    /* one pass over the buffer, '\0' is skipped, cursor moved once at the end */
+    return putbuf((const uint8_t*)buf, nbytes);
 }
 
-/* remap_vidmem
+/* terminal_switch
  *   Inputs: id (0-2) of new terminal
  *   Return Value: none
- *   Function: Switches terminal being viewed. */
+ *   Function: Switches terminal being viewed. Every terminal keeps drawing into its own region of
+ *             VGA memory, so this only points the display and the cursor at another region */
 int32_t terminal_switch(int new_term_idx) {
-    
     uint32_t flags;
-    cli_and_save(flags);
+
+    spin_lock_irqsave(&console_lock, flags);
 
     /* Check if new terminal is the same as the terminal that is currently being viewed (if so do nothing)*/
     if (new_term_idx == cur_terminal)
-        { restore_flags(flags); return 0; }
-    
-    /* Set screenX/Y to point to the one for the new structure. Set new cursor */
-    update_screen_ptr(&terminals[new_term_idx].cursor_x, &terminals[new_term_idx].cursor_y);
-    set_cursor(terminals[new_term_idx].cursor_x, terminals[new_term_idx].cursor_y);
-
-    /* Save old terminal video mem */
-    remap_vidmem(cur_terminal);
-    memcpy((void*)TERMINAL_VIDMEM_PTR[cur_terminal], (void*)video_mem, FOUR_KB);
-    
-    /* Set new terminal video mem */
-    memcpy((void*)video_mem, (void*)TERMINAL_VIDMEM_PTR[new_term_idx], FOUR_KB);
-    remap_vidmem(new_term_idx);
+        { spin_unlock_irqrestore(&console_lock, flags); return 0; }
 
     cur_terminal = new_term_idx;
+    screen_show(new_term_idx);
 
-    restore_flags(flags);
+    spin_unlock_irqrestore(&console_lock, flags);
     return 0;
 }
 
 
-/* remap_vidmem
- *   Inputs: id (0-2) of new terminal
+/* echo_to
+ *   Inputs: tid - terminal, or -1
  *   Return Value: none
- *   Function: allows for servicing different terminals by remapping video memory.
- *              If new terminal to service is being viewed, virt. vidmem address xb8000 points directly
- *              to physical addresss xb8000, else points to terminal's background page */
-void remap_vidmem(int new_term) {
-    
-    /* Set screenX/Y ptr to point to new terminal cursorx/y */
-    update_screen_ptr(&terminals[new_term].cursor_x, &terminals[new_term].cursor_y);
-    
-    /* is the new terminal the currently viewed terminal */
-    if (new_term == cur_terminal) {
-        /*if so, remap vidmem to currently viewing video memory at xb8000*/
-        page_table[184].page_base_address = 184;
-
-        //similarly remap vidmem used for fish
-        video_page_table[0].page_base_address = (VIDEO) >> 12;
-
-        // update cursor
-        set_cursor(terminals[new_term].cursor_x, terminals[new_term].cursor_y);
-    } else {
-        //if not, remap vidmem to the vidmem of the new terminal (0 indexed)
-
-        /*map virt. addr xb8000 to terminal's backup page, stored in order directly under 
-         * 4kb page at xb8000, +1 for 0-indexed*/
-        page_table[184].page_base_address = 184 + 1 + new_term;
-
-        // similarly map video page used for fish
-        video_page_table[0].page_base_address = (TERMINAL_VIDMEM_PTR[new_term]) >> 12;
-    }
-
-    
-    flush_tlb();
+ *   Function: sends this cpu's kernel output to terminal tid instead of the running process's
+ *             one (the keyboard interrupt echoes to the terminal being viewed), -1 goes back.
+ *             Every terminal renders into its own VGA region, so this is only a per-cpu index */
+void echo_to(int32_t tid) {
+    this_cpu()->echo_tid = tid;
 }
@@ -5,14 +5,29 @@
 #include "types.h"
 #include "keyboard.h"
 #include "lib.h"
+#include "spinlock.h"
 
 #define NUM_TERMINALS 3
 
-#define TERM1_VIDMEM 0xB9000
+/* each terminal owns TERM_REGION_SIZE of VGA text memory, the screen scrolls through it (see
+ * scroll) and the visible one is whichever the VGA start address points into */
+#define TERM1_VIDMEM 0xB8000
 #define TERM2_VIDMEM 0xBA000
-#define TERM3_VIDMEM 0xBB000
+#define TERM3_VIDMEM 0xBC000
+#define TERM_REGION_SIZE 0x2000
+/* terminals render into a RAM back buffer, a ring of BACK_ROWS rows (a power of two, at least
+ * a screen), which console_present copies to VGA memory every PRESENT_TICKS timer ticks. The
+ * rows above the screen are the scrollback, Shift+PgUp/PgDn move SCROLLBACK_STEP rows through it */
+#define SCREEN_COLS 80
+#define BACK_ROWS 4096
+#define PRESENT_TICKS 2
+#define SCROLLBACK_STEP 24
 #define FOUR_KB 0x1000
 #define MAX_BUFFER_SIZE 128
+/* keystrokes queued for a raw mode reader, a power of two */
+#define RAW_BUF_SIZE 64
+/* line mode type-ahead: typed lines waiting to be read plus the one being edited, a power of two */
+#define KBD_BUF_SIZE 1024
 
 extern int32_t TERMINAL_VIDMEM_PTR[3];
 
@@ -20,11 +35,36 @@ extern int32_t TERMINAL_VIDMEM_PTR[3];
 int32_t terminal_switch();
 
 typedef struct terminal {
-    char keyboard_buffer[MAX_BUFFER_SIZE];
-    int buf_ptr;
-    volatile int enter_pressed;
+    /* line mode input (see keyboard.c), kbd_buf indexed by free-running counters. From kbd_head
+     * to line_start are whole lines, each ending in '\n', that terminal_read has not taken yet;
+     * from line_start to kbd_tail is the line still being typed, which Backspace can take back */
+    char kbd_buf[KBD_BUF_SIZE];
+    volatile uint32_t kbd_head;     // only the reader moves it
+    volatile uint32_t kbd_tail;     // only the keyboard interrupt moves it
+    volatile uint32_t line_start;   // only the keyboard interrupt moves it
     int cursor_x, cursor_y;
 
+    /* console output (see lib.c). Line n is back row n % BACK_ROWS and screen row y is line
+     * top_line + y; the lines before it, as far as the ring goes back, are the scrollback. The
+     * cells of back row r from dirty_lo[r] up to dirty_hi[r] are not in VGA memory yet (clean
+     * when dirty_hi[r] is 0). The display shows from line top_line - view_back; as of the last
+     * present VGA memory shows it from line vga_line, starting at cell screen_top of the
+     * terminal's region */
+    uint16_t back[BACK_ROWS][SCREEN_COLS];
+    uint8_t dirty_lo[BACK_ROWS];
+    uint8_t dirty_hi[BACK_ROWS];
+    uint32_t top_line;          // rows scrolled off the top so far
+    uint32_t view_back;         // rows the display is scrolled back, 0 for the live screen
+    uint32_t vga_line;
+    int screen_top;
+    volatile int sync_pid;      // process that set O_SYNC: each write is presented before it returns, -1 if none
+
+    /* raw mode (fcntl O_RAW): keys queue in raw_buf unechoed instead of in kbd_buf */
+    volatile int raw_pid;       // process that turned raw mode on, -1 in line mode
+    char raw_buf[RAW_BUF_SIZE];
+    volatile uint32_t raw_head; // keys read so far, only the reader moves it
+    volatile uint32_t raw_tail; // keys typed so far, only the keyboard interrupt moves it
+
     /*for RTC virtualization*/
     volatile int INT_FLAG;
     volatile int INT_COUNT;
@@ -44,10 +84,17 @@ int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes);
 int32_t terminal_write(int32_t fd, const void* buf, int32_t nbytes);
 int32_t terminal_open(const uint8_t* filename);
 int32_t terminal_close(int32_t fd);
+int32_t terminal_poll(int32_t fd);
+void terminal_set_raw(int32_t raw);
+void terminal_set_sync(int32_t sync);
+void terminal_release(int32_t pid);
 
 int32_t terminal_switch(int new_term_idx);
 
-void remap_vidmem(int new_term);
+void echo_to(int32_t tid);
+
+/* serializes writes to video memory and terminal switches between cpus */
+extern spinlock_t console_lock;
 
 
 #endif
@@ -11,6 +11,11 @@
 #include "terminal.h"
 #include "systemcall.h"
 #include "pcb.h"
+#include "switch_s.h"
+#include "apic.h"
+#include "pit.h"
+#include "signal.h"
+#include "klog.h"
 
 #define PASS 1
 #define FAIL 0
@@ -142,6 +147,11 @@ void rtc_test(){
 	int32_t fd;
 	fd = open((const uint8_t*)"rtc");
 
+	/* launch_tests runs before any process exists, so there is no fd table to open it in */
+	if (fd == -1) {
+		printf("rtc_test: cannot open rtc without a process\n");
+		return;
+	}
 
 
 	enable_irq(RTC_IRQ);
@@ -304,10 +314,10 @@ void test_paging_inaccess(){
 	// char i = *p; 
 	// printf("dereferencing video mem byte -1, read: %c \n", i);
 
-	// read a byte right after video mem location
-	char* p = (char*)(VIDEO+4096);
+	// read a byte right after video mem (all of VGA text memory, 8 pages, is mapped)
+	char* p = (char*)(VIDEO+0x8000);
 	char i = *p; 
-	printf("dereferencing mem physcial address 0xb9000, read: %c \n", i);
+	printf("dereferencing mem physcial address 0xc0000, read: %c \n", i);
 
 	// //read a byte right before kernel mem location
 	// char* p = (char*)(KERNEL_START-1);
@@ -322,6 +332,26 @@ void test_paging_inaccess(){
 }
 
 
+/* term_vidmem_test
+ *   Inputs: none
+ *   Return Value: PASS, or a page fault if a region is not mapped
+ * 	 Coverage: paging, map_low_memory, terminal regions
+ *   Function: Writes the first and last byte of every terminal's VGA region, putting back what
+ *             was there. Run after smp_init, which unmaps the rest of low memory */
+int term_vidmem_test(){
+	TEST_HEADER;
+
+	int t;
+	volatile uint8_t* p;
+
+	for (t = 0; t < NUM_TERMINALS; t++) {
+		p = (volatile uint8_t*)TERMINAL_VIDMEM_PTR[t];
+		p[0] = p[0];
+		p[TERM_REGION_SIZE - 1] = p[TERM_REGION_SIZE - 1];
+	}
+	return PASS;
+}
+
 /* test_paging_access
  *   Inputs: none
  *	 Outputs: Prints test progress to the screen. Test should finish without any page faults occurring.
@@ -574,10 +604,124 @@ int term_driver_test(){
 /* Checkpoint 4 tests */
 /* Checkpoint 5 tests */
 
+#define PINGPONG_ROUNDS 100000
+#define PINGPONG_STACK_SIZE 1024
+
+static context_t pingpong_main_ctx;
+static context_t pingpong_peer_ctx;
+static uint32_t pingpong_stack[PINGPONG_STACK_SIZE];
+
+/* pingpong_peer
+ *   Inputs: none
+ *   Return Value: none, never returns
+ *   Function: second kernel context for context_switch_test, switches straight back every time */
+static void pingpong_peer(){
+	while (1)
+		switch_to(&pingpong_peer_ctx, &pingpong_main_ctx);
+}
+
+/* context_switch_test
+ *   Inputs: none
+ *	 Outputs: average cycles per switch_to
+ *   Return Value: none
+ * 	 Coverage: switch_to
+ *   Function: Ping-pongs between two kernel contexts PINGPONG_ROUNDS times with interrupts off and
+ *             reports the cost of one switch. Does not include the scheduler or paging updates. */
+void context_switch_test(){
+	TEST_HEADER;
+
+	int i;
+	uint32_t flags;
+	uint32_t cycles;
+	uint64_t start, end;
+
+	/* peer starts at the top of its own stack with a dummy return address */
+	pingpong_stack[PINGPONG_STACK_SIZE-1] = 0;
+	pingpong_peer_ctx.esp = (uint32_t)&pingpong_stack[PINGPONG_STACK_SIZE-1];
+	pingpong_peer_ctx.ebp = 0;
+	pingpong_peer_ctx.eip = (uint32_t)pingpong_peer;
+
+	cli_and_save(flags);
+	start = rdtsc();
+	for (i = 0; i < PINGPONG_ROUNDS; i++)
+		switch_to(&pingpong_main_ctx, &pingpong_peer_ctx);
+	end = rdtsc();
+	restore_flags(flags);
+
+	cycles = (uint32_t)(end - start);
+	printf("switch_to: %u cycles per switch (%u round trips)\n", cycles / (2*PINGPONG_ROUNDS), PINGPONG_ROUNDS);
+}
+
+
+#define IRQ_COST_TICKS 100
+
+/* irq_cost_wait
+ *   Inputs: n - PIT ticks
+ *   Return Value: none
+ *   Function: lets interrupts come in for n ticks */
+static void irq_cost_wait(uint32_t n){
+	uint32_t start = pit_ticks;
+	while (pit_ticks - start < n)
+		asm volatile ("hlt");
+}
+
+/* irq_eoi_cost_test
+ *   Inputs: none
+ *	 Outputs: average and worst entry-to-EOI cycles per interrupt source and controller
+ *   Return Value: none
+ * 	 Coverage: irq_eoi, apic_route_irq
+ *   Function: Runs the RTC through the 8259 and then through the IOAPIC for IRQ_COST_TICKS each
+ *             and reports both, along with whichever timer is driving the scheduler. Boot with
+ *             USE_APIC 0 to see the PIT on the 8259. */
+void irq_eoi_cost_test(){
+	TEST_HEADER;
+
+	uint32_t routed = irq_routed & (1 << RTC_IRQ);
+
+	irq_cost_reset();
+
+	apic_route_irq(RTC_IRQ, 0);
+	rtc_ack();
+	irq_cost_wait(IRQ_COST_TICKS);
+
+	apic_route_irq(RTC_IRQ, 1);
+	rtc_ack();
+	irq_cost_wait(IRQ_COST_TICKS);
+
+	apic_route_irq(RTC_IRQ, routed != 0);
+	rtc_ack();
+	irq_cost_report();
+}
+
+/* signal_frame_test
+ *   Inputs: none
+ *	 Outputs: PASS/FAIL
+ *   Return Value: PASS if the user signal frame has the ECE391 layout
+ * 	 Coverage: sig_frame_t, sig_tramp
+ *   Function: handlers (sigtest) find the saved eax at &signum + 7 and return into the
+ *             trampoline right above the saved context */
+int signal_frame_test(){
+	TEST_HEADER;
+
+	sig_frame_t sf;
+	int result = PASS;
+
+	if ((uint32_t*)&sf.context.eax != &sf.signum + 7)
+		result = FAIL;
+	if (sizeof(sig_context_t) != 17 * sizeof(uint32_t))
+		result = FAIL;
+	if ((uint8_t*)sf.tramp != (uint8_t*)&sf.context + sizeof(sig_context_t))
+		result = FAIL;
+	return result;
+}
+
 
 /* Test suite entry point */
 void launch_tests(){
 	
+	/* tests report with printf, show everything on the console while they run */
+	klog_console_level = KLOG_DEBUG;
+
 	// launch your tests here
 
 	/* checkpoint 2 */
@@ -628,5 +772,14 @@ void launch_tests(){
 
 	//test_paging_access(); 
 
+	/* checkpoint 5 */
+	context_switch_test();
+
+	TEST_OUTPUT("term_vidmem_test", term_vidmem_test());
+
+	irq_eoi_cost_test();
+
+	TEST_OUTPUT("signal_frame_test", signal_frame_test());
 
+	klog_console_level = KLOG_CONSOLE_DEFAULT;
 }
@@ -0,0 +1,186 @@
+#include "timer.h"
+#include "lib.h"
+#include "pit.h"
+#include "spinlock.h"
+
+/* wheel levels. tv1 holds timers due in the next 256 ticks, each later level covers 64x the range */
+static timer_t* tv1[TVR_SIZE];
+static timer_t* tv2[TVN_SIZE];
+static timer_t* tv3[TVN_SIZE];
+static timer_t* tv4[TVN_SIZE];
+static timer_t* tv5[TVN_SIZE];
+
+/* next tick the wheel will process */
+static uint32_t wheel_clock = 0;
+
+/* timers are added from any cpu, the wheel is run by the boot cpu */
+static spinlock_t timer_lock = SPINLOCK_INIT;
+
+
+/* timer_init
+ *   Inputs: none
+ *   Return Value: none
+ *   Function: empties every wheel slot and starts the wheel at the current tick */
+void timer_init() {
+    int i;
+
+    for (i = 0; i < TVR_SIZE; i++)
+        tv1[i] = NULL;
+    for (i = 0; i < TVN_SIZE; i++) {
+        tv2[i] = NULL;
+        tv3[i] = NULL;
+        tv4[i] = NULL;
+        tv5[i] = NULL;
+    }
+    wheel_clock = pit_ticks;
+}
+
+/* list_add
+ *   Inputs: head - slot to add to, timer - timer to link in
+ *   Return Value: none
+ *   Function: pushes timer onto the front of a slot list */
+static void list_add(timer_t** head, timer_t* timer) {
+    timer->next = *head;
+    if (*head != NULL)
+        (*head)->pprev = &timer->next;
+    *head = timer;
+    timer->pprev = head;
+}
+
+/* internal_add
+ *   Inputs: timer - timer to place in the wheel
+ *   Return Value: none
+ *   Function: hashes timer into the slot of the level that covers its expiry */
+static void internal_add(timer_t* timer) {
+    uint32_t expires = timer->expires;
+    uint32_t idx = expires - wheel_clock;
+    timer_t** slot;
+
+    if ((int32_t)idx < 0) {
+        /* already due, run on the next tick */
+        slot = &tv1[wheel_clock & TVR_MASK];
+    } else if (idx < TVR_SIZE) {
+        slot = &tv1[expires & TVR_MASK];
+    } else if (idx < (1 << (TVR_BITS + TVN_BITS))) {
+        slot = &tv2[(expires >> TVR_BITS) & TVN_MASK];
+    } else if (idx < (1 << (TVR_BITS + 2*TVN_BITS))) {
+        slot = &tv3[(expires >> (TVR_BITS + TVN_BITS)) & TVN_MASK];
+    } else if (idx < (1 << (TVR_BITS + 3*TVN_BITS))) {
+        slot = &tv4[(expires >> (TVR_BITS + 2*TVN_BITS)) & TVN_MASK];
+    } else {
+        slot = &tv5[(expires >> (TVR_BITS + 3*TVN_BITS)) & TVN_MASK];
+    }
+
+    list_add(slot, timer);
+}
+
+/* detach
+ *   Inputs: timer - pending timer
+ *   Return Value: none
+ *   Function: unlinks a timer from its slot, caller holds timer_lock */
+static void detach(timer_t* timer) {
+    *timer->pprev = timer->next;
+    if (timer->next != NULL)
+        timer->next->pprev = timer->pprev;
+    timer->pending = 0;
+}
+
+/* timer_add
+ *   Inputs: timer   - caller-owned timer struct
+ *           expires - absolute pit tick to fire on
+ *           func    - callback, runs in the pit interrupt
+ *           data    - argument passed to func
+ *   Return Value: none
+ *   Function: arms a timer. Re-adding a pending timer moves it to the new expiry */
+void timer_add(timer_t* timer, uint32_t expires, timer_func_t func, uint32_t data) {
+    uint32_t flags;
+    spin_lock_irqsave(&timer_lock, flags);
+
+    if (timer->pending)
+        detach(timer);
+
+    timer->expires = expires;
+    timer->func = func;
+    timer->data = data;
+    timer->pending = 1;
+    internal_add(timer);
+
+    spin_unlock_irqrestore(&timer_lock, flags);
+}
+
+/* timer_del
+ *   Inputs: timer - timer to cancel
+ *   Return Value: 1 if the timer was pending, 0 if it already fired or was never armed
+ *   Function: unlinks a timer from the wheel */
+int32_t timer_del(timer_t* timer) {
+    uint32_t flags;
+    spin_lock_irqsave(&timer_lock, flags);
+
+    if (!timer->pending)
+        { spin_unlock_irqrestore(&timer_lock, flags); return 0; }
+
+    detach(timer);
+
+    spin_unlock_irqrestore(&timer_lock, flags);
+    return 1;
+}
+
+/* cascade
+ *   Inputs: tv - wheel level, index - slot in that level
+ *   Return Value: index, so the caller knows whether the next level up wrapped too
+ *   Function: moves every timer in a slot down into the finer levels */
+static uint32_t cascade(timer_t** tv, uint32_t index) {
+    timer_t* timer = tv[index];
+    timer_t* next;
+
+    tv[index] = NULL;
+    while (timer != NULL) {
+        next = timer->next;
+        internal_add(timer);
+        timer = next;
+    }
+    return index;
+}
+
+#define TV_INDEX(n) ((wheel_clock >> (TVR_BITS + (n)*TVN_BITS)) & TVN_MASK)
+
+/* timer_tick
+ *   Inputs: none
+ *   Return Value: none
+ *   Function: called from the pit interrupt. Advances the wheel up to pit_ticks and runs every
+ *             timer that came due. Work per tick is one slot, plus a cascade every 256 ticks. */
+void timer_tick() {
+    timer_t* timer;
+    uint32_t index;
+    timer_func_t func;
+    uint32_t data;
+
+    spin_lock(&timer_lock);
+    while ((int32_t)(pit_ticks - wheel_clock) >= 0) {
+        index = wheel_clock & TVR_MASK;
+
+        /* tv1 wrapped, refill it from the level above (and so on up) */
+        if (index == 0 &&
+            cascade(tv2, TV_INDEX(0)) == 0 &&
+            cascade(tv3, TV_INDEX(1)) == 0 &&
+            cascade(tv4, TV_INDEX(2)) == 0)
+            cascade(tv5, TV_INDEX(3));
+
+        wheel_clock++;
+
+        while ((timer = tv1[index]) != NULL) {
+            tv1[index] = timer->next;
+            if (timer->next != NULL)
+                timer->next->pprev = &tv1[index];
+            timer->pending = 0;
+
+            /* callbacks may re-arm timers, run them unlocked */
+            func = timer->func;
+            data = timer->data;
+            spin_unlock(&timer_lock);
+            func(data);
+            spin_lock(&timer_lock);
+        }
+    }
+    spin_unlock(&timer_lock);
+}
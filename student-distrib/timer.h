@@ -0,0 +1,40 @@
+#ifndef _TIMER_H
+#define _TIMER_H
+
+#include "types.h"
+
+/* Timer wheel: 256 one-tick slots, then four levels of 64 slots that cascade down as the
+ * wheel turns (same layout as the classic Linux timer wheel). Adding, removing and
+ * advancing one tick are all O(1) amortized regardless of the number of pending timers. */
+#define TVR_BITS 8
+#define TVN_BITS 6
+#define TVR_SIZE (1 << TVR_BITS)
+#define TVN_SIZE (1 << TVN_BITS)
+#define TVR_MASK (TVR_SIZE - 1)
+#define TVN_MASK (TVN_SIZE - 1)
+
+#define NS_PER_SEC 1000000000
+
+typedef void (*timer_func_t)(uint32_t data);
+
+/* a timer is embedded in whatever owns it (e.g. the pcb), the wheel never allocates */
+typedef struct timer_t{
+    struct timer_t* next;
+    struct timer_t** pprev;     // points at whatever points at us, for O(1) removal
+    uint32_t expires;           // absolute pit tick to fire on
+    timer_func_t func;          // called from the pit interrupt with interrupts off
+    uint32_t data;
+    uint8_t pending;
+}timer_t;
+
+typedef struct timespec_t{
+    uint32_t tv_sec;
+    uint32_t tv_nsec;
+}timespec_t;
+
+extern void timer_init();
+extern void timer_add(timer_t* timer, uint32_t expires, timer_func_t func, uint32_t data);
+extern int32_t timer_del(timer_t* timer);
+extern void timer_tick();
+
+#endif
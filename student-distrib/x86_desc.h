@@ -14,7 +14,11 @@
 #define USER_CS     0x0023
 #define USER_DS     0x002B
 #define KERNEL_TSS  0x0030
-#define KERNEL_LDT  0x0038
+
+/* Every cpu has its own TSS descriptor, starting at KERNEL_TSS. The LDT descriptor follows them */
+#define MAX_CPUS    4
+#define TSS_SEL(cpu) (KERNEL_TSS + ((cpu) << 3))
+#define KERNEL_LDT  (KERNEL_TSS + (MAX_CPUS << 3))
 
 /* Size of the task state segment (TSS) */
 #define TSS_SIZE    104
@@ -121,8 +125,24 @@ extern seg_desc_t gdt_ptr;
 extern uint32_t ldt;
 
 extern uint32_t tss_size;
-extern seg_desc_t tss_desc_ptr;
-extern tss_t tss;
+extern seg_desc_t tss_desc_ptr[MAX_CPUS];
+extern tss_t cpu_tss[MAX_CPUS];
+
+/* smp_cpu_id
+ *   Inputs: none
+ *   Return Value: index of the executing cpu (0 is the boot cpu)
+ *   Function: Each cpu loads its own TSS selector into the task register (tss_init in smp.c), so
+ *             str identifies the cpu without a trip to the local APIC. Returns 0 before ltr.
+ *             Kernel contexts never move between cpus, so the asm is left non-volatile and gcc may
+ *             reuse the result within a function. */
+static inline uint32_t smp_cpu_id(void) {
+    uint16_t sel;
+    asm ("str %0" : "=r"(sel));
+    return (sel < KERNEL_TSS) ? 0 : (uint32_t)(sel - KERNEL_TSS) >> 3;
+}
+
+/* TSS of the executing cpu */
+#define tss (cpu_tss[smp_cpu_id()])
 
 /* Sets runtime-settable parameters in the GDT entry for the LDT */
 #define SET_LDT_PARAMS(str, addr, lim)                          \
@@ -0,0 +1,70 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 1024
+#define DEFAULT_MS 500
+#define NALARMS 10
+#define FOREVER 0x7FFFFFFF
+
+static volatile uint32_t alarms;
+static struct cpu_stats st;
+
+void alarm_sighandler (int signum);
+
+/* Periodic work without polling: ALARM every [ms] milliseconds, sleeping
+   in between. Prints when each alarm arrived and, at the end, how little
+   cpu time the process used */
+int main ()
+{
+    uint8_t buf[BUFSIZE];
+    uint32_t ms = DEFAULT_MS;
+    uint32_t i, seen = 0;
+    int32_t pid = ece391_getpid ();
+
+    if (0 == ece391_getargs (buf, BUFSIZE) && buf[0] != '\0') {
+        ms = 0;
+        for (i = 0; buf[i] >= '0' && buf[i] <= '9'; i++)
+            ms = ms * 10 + (buf[i] - '0');
+        if (0 == ms || buf[i] != '\0') {
+            ece391_fdputs (1, (uint8_t*)"usage: alarm [ms]\n");
+            return 3;
+        }
+    }
+
+    ece391_set_handler (ALARM, alarm_sighandler);
+    ece391_alarm (ms);
+
+    while (seen < NALARMS) {
+        /* returns early when the alarm comes in */
+        ece391_sleep (FOREVER);
+        if (alarms == seen)
+            continue;
+        seen = alarms;
+        ece391_fdputs (1, (uint8_t*)"alarm ");
+        ece391_fdputs (1, ece391_itoa (seen, buf, 10));
+        ece391_fdputs (1, (uint8_t*)" at tick ");
+        ece391_fdputs (1, ece391_itoa (ece391_ticks (), buf, 10));
+        ece391_fdputs (1, (uint8_t*)"\n");
+    }
+    ece391_alarm (0);
+
+    if (-1 == ece391_cpustats (&st))
+        return 0;
+    for (i = 0; i < st.nprocs; i++) {
+        if (st.procs[i].pid != pid)
+            continue;
+        ece391_fdputs (1, (uint8_t*)"cpu used: ");
+        ece391_fdputs (1, ece391_itoa (st.procs[i].utime + st.procs[i].stime, buf, 10));
+        ece391_fdputs (1, (uint8_t*)" ticks\n");
+    }
+
+    return 0;
+}
+
+void
+alarm_sighandler (int signum)
+{
+    alarms++;
+}
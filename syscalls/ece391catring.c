@@ -0,0 +1,60 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define CHUNK 1024
+#define PAIRS 8                 /* read+write pairs per ioring_enter */
+
+static struct io_ring ring;
+static uint8_t name[CHUNK];
+static uint8_t bufs[PAIRS][CHUNK];
+
+/* cat through the submission ring: each trap reads and prints PAIRS chunks,
+   where plain cat takes two traps per chunk */
+int main ()
+{
+    struct io_cqe* cqe;
+    int32_t fd, i, eof = 0;
+
+    if (0 != ece391_getargs (name, CHUNK)) {
+        ece391_fdputs (1, (uint8_t*)"could not read arguments\n");
+	return 3;
+    }
+    if (-1 == ece391_ioring_setup (&ring)) {
+        ece391_fdputs (1, (uint8_t*)"ioring setup failed\n");
+	return 3;
+    }
+
+    ece391_sqe_push (&ring, IORING_OP_OPEN, 0, 0, name, 0, 0);
+    ece391_ioring_enter (1);
+    fd = ring.cq[ring.cq_head++ & IORING_MASK].res;
+    if (-1 == fd) {
+        ece391_fdputs (1, (uint8_t*)"file not found\n");
+	return 2;
+    }
+
+    while (!eof) {
+        for (i = 0; i < PAIRS; i++) {
+	    ece391_sqe_push (&ring, IORING_OP_READ, 0, fd, bufs[i], CHUNK, 2 * i);
+	    ece391_sqe_push (&ring, IORING_OP_WRITE, IOSQE_LEN_FROM_PREV, 1, bufs[i], 0, 2 * i + 1);
+	}
+	ece391_ioring_enter (2 * PAIRS);
+
+	/* even user_data is a read, odd its write */
+	while (ring.cq_head != ring.cq_tail) {
+	    cqe = &ring.cq[ring.cq_head++ & IORING_MASK];
+	    if (-1 == cqe->res) {
+	        if (0 == (cqe->user_data & 1))
+		    ece391_fdputs (1, (uint8_t*)"file read failed\n");
+		return 3;
+	    }
+	    if (0 == (cqe->user_data & 1) && 0 == cqe->res)
+	        eof = 1;
+	}
+    }
+
+    ece391_sqe_push (&ring, IORING_OP_CLOSE, 0, fd, 0, 0, 0);
+    ece391_ioring_enter (1);
+    return 0;
+}
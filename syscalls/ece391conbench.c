@@ -0,0 +1,100 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define LINE_LEN 64             /* 63 characters and a newline */
+#define LINES 2000
+#define BULK 4096
+
+static uint8_t text[BULK];
+
+static void
+put_num (uint32_t n)
+{
+    uint8_t buf[16];
+
+    ece391_fdputs (1, ece391_itoa (n, buf, 10));
+}
+
+/* LINES lines of text to stdout, chunk bytes per write call; returns
+   the characters written */
+static uint32_t
+blast (uint32_t chunk)
+{
+    uint32_t left = LINES * LINE_LEN, done = 0, n, off = 0;
+
+    while (left > 0) {
+        n = left < chunk ? left : chunk;
+        if (off + n > BULK)
+            off = 0;
+        if (-1 == ece391_write (1, text + off, n))
+            break;
+        off += n;
+        done += n;
+        left -= n;
+    }
+    return done;
+}
+
+#define RUNS 6
+
+static uint32_t chars[RUNS], ticks[RUNS];
+
+static void
+run (int32_t i, uint32_t chunk)
+{
+    uint32_t start = ece391_ticks ();
+
+    chars[i] = blast (chunk);
+    ticks[i] = ece391_ticks () - start;
+}
+
+static void
+report (const char* what, int32_t i)
+{
+    ece391_fdputs (1, (uint8_t*)what);
+    put_num (chars[i]);
+    ece391_fdputs (1, (uint8_t*)" chars, ");
+    put_num (ticks[i]);
+    ece391_fdputs (1, (uint8_t*)" ticks");
+    if (ticks[i] != 0) {
+        ece391_fdputs (1, (uint8_t*)", ");
+        put_num (chars[i] / ticks[i] * ece391_hz ());
+        ece391_fdputs (1, (uint8_t*)" chars/s");
+    }
+    ece391_fdputs (1, (uint8_t*)"\n");
+}
+
+/* Console output throughput, like cat of a large file: the same text
+   written one character per call, one line per call and 4 KB per call,
+   first drawn in RAM and presented by the timer, then with O_SYNC so
+   every write is copied to video memory before it returns. The results
+   are printed at the end, after the text has scrolled by */
+int main ()
+{
+    int32_t i;
+
+    for (i = 0; i < BULK; i++)
+        text[i] = (LINE_LEN - 1 == i % LINE_LEN) ? '\n' : 'a' + (i / LINE_LEN + i) % 26;
+
+    run (0, 1);
+    run (1, LINE_LEN);
+    run (2, BULK);
+    if (-1 == ece391_fcntl (1, F_SETFL, O_SYNC)) {
+        ece391_fdputs (1, (uint8_t*)"stdout is not a terminal\n");
+        return 3;
+    }
+    run (3, 1);
+    run (4, LINE_LEN);
+    run (5, BULK);
+    ece391_fcntl (1, F_SETFL, 0);
+
+    report ("timer char: ", 0);
+    report ("timer line: ", 1);
+    report ("timer bulk: ", 2);
+    report ("sync  char: ", 3);
+    report ("sync  line: ", 4);
+    report ("sync  bulk: ", 5);
+    return 0;
+}
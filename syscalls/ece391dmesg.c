@@ -0,0 +1,36 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 1024
+#define ALL_LEVELS 7
+
+/* Prints the kernel log, oldest first: "[seconds.hundredths] message".
+   With a level (3 errors, 4 warnings too, 6 info, 7 everything) only the
+   messages at that level or more severe */
+int main ()
+{
+    uint8_t buf[BUFSIZE];
+    uint32_t seq = 0;
+    int32_t cnt, i, start, max_level = ALL_LEVELS;
+
+    if (0 == ece391_getargs (buf, BUFSIZE) && buf[0] != '\0') {
+        if (buf[0] < '0' || buf[0] > '9' || buf[1] != '\0') {
+            ece391_fdputs (1, (uint8_t*)"usage: dmesg [level]\n");
+            return 3;
+        }
+        max_level = buf[0] - '0';
+    }
+
+    while (0 < (cnt = ece391_dmesg (&seq, buf, BUFSIZE))) {
+        /* whole lines only, each starting "<l>" */
+        for (start = 0; start < cnt; start = i + 1) {
+            for (i = start; '\n' != buf[i]; i++)
+                ;
+            if (buf[start + 1] - '0' <= max_level)
+                ece391_write (1, buf + start + 3, i + 1 - (start + 3));
+        }
+    }
+    return (-1 == cnt) ? 2 : 0;
+}
@@ -0,0 +1,93 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define CHUNK 10
+#define MANY_FDS 20
+
+static const uint8_t fname[] = "frame0.txt";
+
+static int32_t
+report (const char* name, int32_t ok)
+{
+    ece391_fdputs (1, (uint8_t*)name);
+    ece391_fdputs (1, (uint8_t*)(ok ? ": PASS\n" : ": FAIL\n"));
+    return ok ? 0 : 2;
+}
+
+/* dup'd fds share one position: reading CHUNK bytes through each gives
+   the first and second CHUNK of the file */
+static int32_t
+shared_offset (void)
+{
+    uint8_t a[CHUNK], b[CHUNK], ref[2 * CHUNK];
+    int32_t fd, d, ref_fd, ok;
+
+    fd = ece391_open (fname);
+    ref_fd = ece391_open (fname);
+    d = ece391_dup (fd);
+    ok = (fd != -1 && ref_fd != -1 && d != -1 && d != fd);
+    ok = ok && CHUNK == ece391_read (fd, a, CHUNK) && CHUNK == ece391_read (d, b, CHUNK);
+    ok = ok && 2 * CHUNK == ece391_read (ref_fd, ref, 2 * CHUNK);
+    ok = ok && 0 == ece391_strncmp (a, ref, CHUNK) && 0 == ece391_strncmp (b, ref + CHUNK, CHUNK);
+
+    /* the open file outlives the fd it was opened on */
+    ece391_close (fd);
+    ok = ok && CHUNK == ece391_read (d, a, CHUNK);
+    ok = ok && 0 == ece391_close (d) && -1 == ece391_read (d, a, CHUNK);
+    ece391_close (ref_fd);
+    return report ("shared_offset", ok);
+}
+
+/* dup2 onto stdout sends output into a pipe, then puts stdout back */
+static int32_t
+redirect_stdout (void)
+{
+    static const uint8_t msg[] = "into the pipe";
+    uint8_t buf[32];
+    int32_t p[2], saved, cnt, ok;
+
+    if (-1 == ece391_pipe (p))
+        return report ("redirect_stdout", 0);
+    saved = ece391_dup (1);
+    ok = (saved != -1 && 1 == ece391_dup2 (p[1], 1));
+    ece391_fdputs (1, msg);
+    ok = ok && 1 == ece391_dup2 (saved, 1);
+    ece391_close (saved);
+    ece391_close (p[1]);
+
+    cnt = ece391_read (p[0], buf, sizeof (buf) - 1);
+    ok = ok && cnt == sizeof (msg) - 1 && 0 == ece391_strncmp (buf, msg, cnt);
+    ok = ok && 0 == ece391_read (p[0], buf, sizeof (buf));     /* last writer gone */
+    ece391_close (p[0]);
+    return report ("redirect_stdout", ok);
+}
+
+/* more fds than the table a process starts with */
+static int32_t
+many_fds (void)
+{
+    int32_t fds[MANY_FDS], i, ok = 1;
+
+    for (i = 0; i < MANY_FDS; i++) {
+        fds[i] = ece391_open (fname);
+        ok = ok && fds[i] != -1;
+    }
+    ok = ok && -1 != ece391_dup2 (fds[0], FD_TABLE_MAX - 1);
+    ok = ok && -1 == ece391_dup2 (fds[0], FD_TABLE_MAX);
+    ece391_close (FD_TABLE_MAX - 1);
+    for (i = 0; i < MANY_FDS; i++)
+        ece391_close (fds[i]);
+    return report ("many_fds", ok);
+}
+
+int main ()
+{
+    int32_t fail = 0;
+
+    fail += shared_offset ();
+    fail += redirect_stdout ();
+    fail += many_fds ();
+    return fail ? 2 : 0;
+}
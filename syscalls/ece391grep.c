@@ -13,7 +13,10 @@ do_one_file (const char* s, const char* fname)
     uint8_t data[BUFSIZE+1];
 
     s_len = ece391_strlen ((uint8_t*)s);
-    if (-1 == (fd = ece391_open ((uint8_t*)fname))) {
+    /* no file name searches standard input */
+    if (0 == fname)
+        fd = 0;
+    else if (-1 == (fd = ece391_open ((uint8_t*)fname))) {
         ece391_fdputs (1, (uint8_t*)"file open failed\n");
         return -1;
     }
@@ -42,8 +45,10 @@ do_one_file (const char* s, const char* fname)
 	    for (check = line_start; check < line_end; check++) {
 		if (s[0] == data[check] && 
 		    0 == ece391_strncmp ((uint8_t*)(data + check), (uint8_t*)s, s_len)) {
-		    ece391_fdputs (1, (uint8_t*)fname);
-		    ece391_fdputs (1, (uint8_t*)":");
+		    if (0 != fname) {
+		        ece391_fdputs (1, (uint8_t*)fname);
+		        ece391_fdputs (1, (uint8_t*)":");
+		    }
 		    ece391_fdputs (1, data + line_start);
 		    ece391_fdputs (1, (uint8_t*)"\n");
 		    break;
@@ -58,7 +63,7 @@ do_one_file (const char* s, const char* fname)
 	if (0 == cnt)
 	    break;
     }
-    if (-1 == ece391_close (fd)) {
+    if (0 != fname && -1 == ece391_close (fd)) {
         ece391_fdputs (1, (uint8_t*)"file close failed\n");
         return -1;
     }
@@ -67,7 +72,7 @@ do_one_file (const char* s, const char* fname)
 
 int main ()
 {
-    int32_t fd, cnt;
+    int32_t fd, cnt, len;
     uint8_t buf[SBUFSIZE];
     uint8_t search[BUFSIZE];
 
@@ -76,6 +81,13 @@ int main ()
         return 3;
     }
 
+    /* "grep pattern -" searches standard input, e.g. the read end of a pipe */
+    len = ece391_strlen (search);
+    if (len >= 2 && ' ' == search[len - 2] && '-' == search[len - 1]) {
+        search[len - 2] = '\0';
+        return (0 != do_one_file ((char*)search, 0)) ? 3 : 0;
+    }
+
     if (-1 == (fd = ece391_open ((uint8_t*)"."))) {
         ece391_fdputs (1, (uint8_t*)"directory open failed\n");
 	return 2;
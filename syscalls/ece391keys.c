@@ -0,0 +1,60 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 32
+#define FRAME_HZ 32
+
+/* Game-style input loop: the terminal in raw mode and stdin non-blocking,
+   so each frame (an rtc tick) takes whatever keys came in and never waits
+   for one. Prints each key with its code and the frame it was seen in;
+   q quits */
+int main ()
+{
+    uint8_t keys[BUFSIZE];
+    uint8_t buf[16];
+    int32_t rtc_fd, cnt, i, hz = FRAME_HZ;
+    uint32_t frame = 0;
+
+    if (-1 == (rtc_fd = ece391_open ((uint8_t*)"rtc"))) {
+        ece391_fdputs (1, (uint8_t*)"rtc open failed\n");
+        return 2;
+    }
+    ece391_write (rtc_fd, &hz, sizeof (hz));
+
+    if (-1 == ece391_fcntl (0, F_SETFL, O_RAW | O_NONBLOCK)) {
+        ece391_fdputs (1, (uint8_t*)"stdin is not a terminal\n");
+        return 3;
+    }
+    ece391_fdputs (1, (uint8_t*)"press keys, q to quit\n");
+
+    while (1) {
+        if (-1 == ece391_read (rtc_fd, buf, 0))
+            break;
+        frame++;
+
+        /* -1: nothing typed this frame */
+        cnt = ece391_read (0, keys, BUFSIZE);
+        for (i = 0; i < cnt; i++) {
+            if ('q' == keys[i])
+                goto done;
+            ece391_fdputs (1, (uint8_t*)"frame ");
+            ece391_fdputs (1, ece391_itoa (frame, buf, 10));
+            ece391_fdputs (1, (uint8_t*)": key ");
+            ece391_fdputs (1, ece391_itoa (keys[i], buf, 10));
+            if (keys[i] > ' ' && keys[i] < 127) {
+                buf[0] = ' ';
+                buf[1] = keys[i];
+                buf[2] = '\0';
+                ece391_fdputs (1, buf);
+            }
+            ece391_fdputs (1, (uint8_t*)"\n");
+        }
+    }
+
+done:
+    ece391_fcntl (0, F_SETFL, 0);
+    ece391_close (rtc_fd);
+    return 0;
+}
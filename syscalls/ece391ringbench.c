@@ -0,0 +1,124 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define CHUNK 1024
+#define BATCH 16                /* reads per ioring_enter */
+#define PASSES 20
+
+static struct io_ring ring;
+static uint8_t name[CHUNK];
+static uint8_t bufs[BATCH][CHUNK];
+
+static uint32_t bytes, traps;
+
+static void
+put_num (uint32_t n)
+{
+    uint8_t buf[16];
+
+    ece391_fdputs (1, ece391_itoa (n, buf, 10));
+}
+
+/* read the file PASSES times with one trap per open, read and close */
+static int32_t
+plain_pass (void)
+{
+    int32_t fd, cnt;
+
+    if (-1 == (fd = ece391_open (name)))
+        return -1;
+    traps++;
+    while (0 < (cnt = ece391_read (fd, bufs[0], CHUNK))) {
+        bytes += cnt;
+        traps++;
+    }
+    traps++;
+    ece391_close (fd);
+    traps++;
+    return cnt;
+}
+
+/* the same through the ring, BATCH reads per trap */
+static int32_t
+ring_pass (void)
+{
+    struct io_cqe* cqe;
+    int32_t fd, i, eof = 0;
+
+    ece391_sqe_push (&ring, IORING_OP_OPEN, 0, 0, name, 0, 0);
+    ece391_ioring_enter (1);
+    traps++;
+    if (-1 == (fd = ring.cq[ring.cq_head++ & IORING_MASK].res))
+        return -1;
+
+    while (!eof) {
+        for (i = 0; i < BATCH; i++)
+            ece391_sqe_push (&ring, IORING_OP_READ, 0, fd, bufs[i], CHUNK, i);
+        ece391_ioring_enter (BATCH);
+        traps++;
+        while (ring.cq_head != ring.cq_tail) {
+            cqe = &ring.cq[ring.cq_head++ & IORING_MASK];
+            if (cqe->res < 0)
+                return -1;
+            if (0 == cqe->res)
+                eof = 1;
+            bytes += cqe->res;
+        }
+    }
+
+    ece391_sqe_push (&ring, IORING_OP_CLOSE, 0, fd, 0, 0, 0);
+    ece391_ioring_enter (1);
+    traps++;
+    ring.cq_head++;
+    return 0;
+}
+
+static void
+run (const char* what, int32_t (*pass)(void))
+{
+    uint32_t i, start, ticks;
+
+    bytes = traps = 0;
+    start = ece391_ticks ();
+    for (i = 0; i < PASSES; i++) {
+        if (-1 == pass ()) {
+            ece391_fdputs (1, (uint8_t*)"read failed\n");
+            return;
+        }
+    }
+    ticks = ece391_ticks () - start;
+
+    ece391_fdputs (1, (uint8_t*)what);
+    put_num (bytes);
+    ece391_fdputs (1, (uint8_t*)" bytes, ");
+    put_num (traps);
+    ece391_fdputs (1, (uint8_t*)" traps, ");
+    put_num (ticks);
+    ece391_fdputs (1, (uint8_t*)" ticks");
+    if (ticks != 0) {
+        ece391_fdputs (1, (uint8_t*)", ");
+        put_num (bytes / ticks * ece391_hz () / 1024);
+        ece391_fdputs (1, (uint8_t*)" KB/s");
+    }
+    ece391_fdputs (1, (uint8_t*)"\n");
+}
+
+/* reads a file with plain read calls and through the ring and compares
+   trap counts and throughput */
+int main ()
+{
+    if (0 != ece391_getargs (name, CHUNK) || '\0' == name[0]) {
+        ece391_fdputs (1, (uint8_t*)"usage: ringbench <file>\n");
+        return 3;
+    }
+    if (-1 == ece391_ioring_setup (&ring)) {
+        ece391_fdputs (1, (uint8_t*)"ioring setup failed\n");
+        return 3;
+    }
+
+    run ("read:   ", plain_pass);
+    run ("ioring: ", ring_pass);
+    return 0;
+}
@@ -4,6 +4,79 @@
 #include "ece391syscall.h"
 
 #define BUFSIZE 1024
+#define MAX_STAGES 3	/* three of the six processes are base shells */
+
+/* strip leading and trailing spaces in place */
+static uint8_t*
+trim (uint8_t* s)
+{
+    uint32_t len;
+
+    while (' ' == *s)
+	s++;
+    len = ece391_strlen (s);
+    while (len > 0 && ' ' == s[len - 1])
+	s[--len] = '\0';
+    return s;
+}
+
+/* run "a | b | c": every stage but the last runs alongside the shell with
+   its stdout on a pipe to the next one, the last is waited for.  Returns
+   what execute would for the last stage, 0 after a reported error */
+static int32_t
+run_pipeline (uint8_t* buf)
+{
+    uint8_t* stage[MAX_STAGES];
+    int32_t n = 1, i, in = 0, rval;
+    int32_t fds[2], io[2];
+    uint8_t* p;
+
+    stage[0] = buf;
+    for (p = buf; '\0' != *p; p++) {
+	if ('|' != *p)
+	    continue;
+	if (MAX_STAGES == n) {
+	    ece391_fdputs (1, (uint8_t*)"too many commands in pipeline\n");
+	    return 0;
+	}
+	*p = '\0';
+	stage[n++] = p + 1;
+    }
+    for (i = 0; i < n; i++) {
+	stage[i] = trim (stage[i]);
+	if ('\0' == stage[i][0]) {
+	    ece391_fdputs (1, (uint8_t*)"empty command in pipeline\n");
+	    return 0;
+	}
+    }
+
+    for (i = 0; i < n - 1; i++) {
+	if (-1 == ece391_pipe (fds)) {
+	    ece391_fdputs (1, (uint8_t*)"pipe failed\n");
+	    if (0 != in)
+		ece391_close (in);
+	    return 0;
+	}
+	io[0] = in;
+	io[1] = fds[1];
+	rval = ece391_spawn (stage[i], io, SPAWN_NOWAIT);
+	ece391_close (fds[1]);
+	if (0 != in)
+	    ece391_close (in);
+	in = fds[0];
+	if (-1 == rval) {
+	    ece391_fdputs (1, stage[i]);
+	    ece391_fdputs (1, (uint8_t*)": no such command\n");
+	}
+    }
+
+    io[0] = in;
+    io[1] = 1;
+    rval = ece391_spawn (stage[n - 1], io, 0);
+    if (0 != in)
+	ece391_close (in);
+    return rval;
+}
 
 int main ()
 {
@@ -24,7 +97,7 @@ int main ()
 	    return 0;
 	if ('\0' == buf[0])
 	    continue;
-	rval = ece391_execute (buf);
+	rval = run_pipeline (buf);
 	if (-1 == rval)
 	    ece391_fdputs (1, (uint8_t*)"no such command\n");
 	else if (256 == rval)
@@ -0,0 +1,47 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 1024
+#define DEFAULT_MLOOPS 200
+
+static struct cpu_stats st;
+
+/* CPU-bound loop that reports elapsed PIT ticks; start one in each
+   terminal and compare against a single run to see SMP scaling */
+int main ()
+{
+    uint8_t buf[BUFSIZE];
+    uint32_t mloops = DEFAULT_MLOOPS;
+    uint32_t i, start;
+    volatile uint32_t sink = 0;
+
+    if (0 == ece391_getargs (buf, BUFSIZE) && buf[0] != '\0') {
+        mloops = 0;
+        for (i = 0; buf[i] >= '0' && buf[i] <= '9'; i++)
+            mloops = mloops * 10 + (buf[i] - '0');
+        if (0 == mloops || buf[i] != '\0') {
+            ece391_fdputs (1, (uint8_t*)"usage: spin [million-loops]\n");
+            return 3;
+        }
+    }
+
+    if (-1 == ece391_cpustats (&st)) {
+        ece391_fdputs (1, (uint8_t*)"cpustats failed\n");
+        return 3;
+    }
+    start = st.ticks;
+
+    for (i = 0; i < mloops * 1000000; i++)
+        sink += i;
+
+    ece391_cpustats (&st);
+    ece391_fdputs (1, (uint8_t*)"spin: ");
+    ece391_fdputs (1, ece391_itoa (st.ticks - start, buf, 10));
+    ece391_fdputs (1, (uint8_t*)" ticks on ");
+    ece391_fdputs (1, ece391_itoa (st.ncpus, buf, 10));
+    ece391_fdputs (1, (uint8_t*)" cpu(s)\n");
+
+    return 0;
+}
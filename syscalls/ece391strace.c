@@ -0,0 +1,167 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 1024
+#define LOG_CHUNK 32
+
+static const char* names[SYSTRACE_NR] = {
+    "invalid", "halt", "execute", "read", "write", "open", "close", "getargs",
+    "vidmap", "set_handler", "sigreturn", "sched_setrt", "sched_getrt", "sleep",
+    "nanosleep", "yield", "cpustats", "ioring_setup", "ioring_enter", "systrace",
+    "alarm", "pipe", "spawn", "poll", "fcntl", "dup", "dup2", "dmesg"
+};
+
+static struct sc_stat stats[SYSTRACE_NR];
+static struct sc_trace trace_log[LOG_CHUNK];
+
+static void
+put_num (uint32_t n, int32_t radix)
+{
+    uint8_t buf[16];
+
+    ece391_fdputs (1, ece391_itoa (n, buf, radix));
+}
+
+/* print s left-aligned in a column of width w */
+static void
+put_col (const char* s, uint32_t w)
+{
+    uint32_t len = ece391_strlen ((uint8_t*)s);
+
+    ece391_fdputs (1, (uint8_t*)s);
+    while (len++ < w)
+        ece391_fdputs (1, (uint8_t*)" ");
+}
+
+static const char*
+name_of (uint32_t nr)
+{
+    return (nr < SYSTRACE_NR && names[nr] != 0) ? names[nr] : "?";
+}
+
+/* signed decimal, or hex for anything that looks like a user pointer */
+static void
+put_arg (int32_t v)
+{
+    if ((uint32_t)v >= 0x08000000 && (uint32_t)v < 0x08800000) {
+        ece391_fdputs (1, (uint8_t*)"0x");
+        put_num (v, 16);
+    } else if (v < 0) {
+        ece391_fdputs (1, (uint8_t*)"-");
+        put_num (-v, 10);
+    } else {
+        put_num (v, 10);
+    }
+}
+
+/* 64-by-32 division without libgcc */
+static uint32_t
+div64 (uint64_t n, uint32_t d)
+{
+    uint64_t q = 0, r = 0;
+    int32_t i;
+
+    for (i = 63; i >= 0; i--) {
+        r = (r << 1) | ((n >> i) & 1);
+        if (r >= d) {
+            r -= d;
+            q |= (uint64_t)1 << i;
+        }
+    }
+    return (q >> 32) ? 0xFFFFFFFF : (uint32_t)q;
+}
+
+/* one line per system call that was used: calls, errors, average cycles and
+   the non-empty histogram buckets as log2(cycles):count */
+static void
+print_stats (struct sc_stat* st, int32_t with_hist)
+{
+    uint32_t nr, b;
+
+    ece391_fdputs (1, (uint8_t*)"syscall      calls   errors  avg cycles\n");
+    for (nr = 0; nr < SYSTRACE_NR; nr++) {
+        if (0 == st[nr].count)
+            continue;
+        put_col (name_of (nr), 13);
+        put_num (st[nr].count, 10);
+        ece391_fdputs (1, (uint8_t*)"\t");
+        put_num (st[nr].errors, 10);
+        ece391_fdputs (1, (uint8_t*)"\t");
+        put_num (div64 (st[nr].cycles, st[nr].count), 10);
+        ece391_fdputs (1, (uint8_t*)"\n");
+        if (!with_hist)
+            continue;
+        ece391_fdputs (1, (uint8_t*)"   ");
+        for (b = 0; b < SYSTRACE_BUCKETS; b++) {
+            if (0 == st[nr].hist[b])
+                continue;
+            ece391_fdputs (1, (uint8_t*)" 2^");
+            put_num (b, 10);
+            ece391_fdputs (1, (uint8_t*)":");
+            put_num (st[nr].hist[b], 10);
+        }
+        ece391_fdputs (1, (uint8_t*)"\n");
+    }
+}
+
+/* strace -s          system-wide counters and latency histograms
+   strace <command>   run command, then print its system calls and a summary */
+int main ()
+{
+    uint8_t cmd[BUFSIZE];
+    int32_t ret, n, i, logged = 0;
+    uint32_t total = 0;
+
+    if (0 != ece391_getargs (cmd, BUFSIZE) || '\0' == cmd[0]) {
+        ece391_fdputs (1, (uint8_t*)"usage: strace -s | strace <command>\n");
+        return 3;
+    }
+
+    if (0 == ece391_strcmp (cmd, (uint8_t*)"-s")) {
+        if (-1 == ece391_systrace (SYSTRACE_STATS, 0, stats))
+            return 3;
+        print_stats (stats, 1);
+        return 0;
+    }
+
+    ece391_systrace (SYSTRACE_CHILDREN, 1, 0);
+    ret = ece391_execute (cmd);
+    ece391_systrace (SYSTRACE_CHILDREN, 0, 0);
+
+    while (0 < (n = ece391_systrace (SYSTRACE_READ_LOG, LOG_CHUNK, trace_log))) {
+        for (i = 0; i < n; i++) {
+            ece391_fdputs (1, (uint8_t*)"[");
+            put_num (trace_log[i].pid, 10);
+            ece391_fdputs (1, (uint8_t*)"] ");
+            ece391_fdputs (1, (uint8_t*)name_of (trace_log[i].nr));
+            ece391_fdputs (1, (uint8_t*)"(");
+            put_arg (trace_log[i].args[0]);
+            ece391_fdputs (1, (uint8_t*)", ");
+            put_arg (trace_log[i].args[1]);
+            ece391_fdputs (1, (uint8_t*)", ");
+            put_arg (trace_log[i].args[2]);
+            ece391_fdputs (1, (uint8_t*)") = ");
+            put_arg (trace_log[i].ret);
+            ece391_fdputs (1, (uint8_t*)" <");
+            put_num (trace_log[i].cycles, 10);
+            ece391_fdputs (1, (uint8_t*)">\n");
+        }
+        logged += n;
+    }
+
+    ece391_systrace (SYSTRACE_SUMMARY, 0, stats);
+    for (i = 0; i < SYSTRACE_NR; i++)
+        total += stats[i].count;
+    if (total > (uint32_t)logged) {
+        put_num (total - logged, 10);
+        ece391_fdputs (1, (uint8_t*)" earlier calls dropped from the log\n");
+    }
+    print_stats (stats, 0);
+
+    ece391_fdputs (1, (uint8_t*)"exit status ");
+    put_arg (ret);
+    ece391_fdputs (1, (uint8_t*)"\n");
+    return 0;
+}
@@ -102,3 +102,88 @@ uint8_t* ece391_strrev(uint8_t* s)
    return s;
 }
 
+/* Sleep for ms milliseconds, going back to sleep if woken early */
+void ece391_msleep(uint32_t ms)
+{
+    struct ece391_timespec req, rem;
+
+    req.tv_sec = ms / 1000;
+    req.tv_nsec = (ms % 1000) * 1000000;
+    while (1) {
+        rem.tv_sec = 0;
+        rem.tv_nsec = 0;
+        if (0 == ece391_nanosleep(&req, &rem))
+            break;
+        if (0 == rem.tv_sec && 0 == rem.tv_nsec)
+            break;
+        req = rem;
+    }
+}
+
+/* Queue one entry on the submission ring; the kernel only looks at it on
+   the next ece391_ioring_enter */
+int32_t ece391_sqe_push(struct io_ring* ring, uint8_t opcode, uint8_t flags,
+        int32_t fd, void* addr, int32_t len, uint32_t user_data)
+{
+    struct io_sqe* sqe;
+
+    if (ring->sq_tail - ring->sq_head == IORING_ENTRIES)
+        return -1;
+    sqe = &ring->sq[ring->sq_tail & IORING_MASK];
+    sqe->opcode = opcode;
+    sqe->flags = flags;
+    sqe->reserved = 0;
+    sqe->fd = fd;
+    sqe->addr = (uint32_t)addr;
+    sqe->len = len;
+    sqe->user_data = user_data;
+    ring->sq_tail++;
+    return 0;
+}
+
+/* kernel info page, mapped read-only into every process */
+#define KINFO ((volatile struct ece391_kinfo*)ECE391_KINFO_ADDR)
+
+/* Copy the whole info page consistently: the kernel makes seq odd while it writes */
+void ece391_kinfo(struct ece391_kinfo* info)
+{
+    uint32_t seq;
+
+    do {
+        while ((seq = KINFO->seq) & 1)
+            ;
+        info->pid = KINFO->pid;
+        info->terminal = KINFO->terminal;
+        info->cpu = KINFO->cpu;
+        info->ticks = KINFO->ticks;
+        info->hz = KINFO->hz;
+        info->time = KINFO->time;
+        info->features = KINFO->features;
+    } while (KINFO->seq != seq);
+    info->seq = seq;
+}
+
+int32_t ece391_getpid(void)
+{
+    return KINFO->pid;
+}
+
+int32_t ece391_getterminal(void)
+{
+    return KINFO->terminal;
+}
+
+uint32_t ece391_ticks(void)
+{
+    return KINFO->ticks;
+}
+
+uint32_t ece391_hz(void)
+{
+    return KINFO->hz;
+}
+
+uint32_t ece391_time(void)
+{
+    return KINFO->time;
+}
@@ -8,6 +8,14 @@ extern int32_t ece391_strcmp(const uint8_t* s1, const uint8_t* s2);
 extern int32_t ece391_strncmp(const uint8_t* s1, const uint8_t* s2, uint32_t n);
 extern uint8_t *ece391_itoa(uint32_t value, uint8_t* buf, int32_t radix);
 extern uint8_t *ece391_strrev(uint8_t* s);
+extern void ece391_msleep(uint32_t ms);
+
+/* read from the kernel info page, no system call involved */
+extern int32_t ece391_getpid(void);
+extern int32_t ece391_getterminal(void);
+extern uint32_t ece391_ticks(void);
+extern uint32_t ece391_hz(void);
+extern uint32_t ece391_time(void);
 
 #endif /* ECE391SUPPORT_H */
 
@@ -0,0 +1,53 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 32
+#define ROUNDS 10000
+
+static inline uint32_t rdtsc_lo (void)
+{
+    uint32_t lo, hi;
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return lo;
+}
+
+/* cycles per call of fn, averaged over ROUNDS calls */
+static uint32_t
+time_calls (int32_t (*fn)(void))
+{
+    uint32_t i, start;
+
+    fn ();                      /* warm up */
+    start = rdtsc_lo ();
+    for (i = 0; i < ROUNDS; i++)
+        fn ();
+    return (rdtsc_lo () - start) / ROUNDS;
+}
+
+static void
+report (const char* what, uint32_t cycles)
+{
+    uint8_t buf[BUFSIZE];
+
+    ece391_fdputs (1, (uint8_t*)what);
+    ece391_fdputs (1, ece391_itoa (cycles, buf, 10));
+    ece391_fdputs (1, (uint8_t*)" cycles\n");
+}
+
+/* null system call round trip through both entry paths, and a trap-free
+   query through the kernel info page for comparison */
+int main ()
+{
+    struct ece391_kinfo info;
+
+    ece391_kinfo (&info);
+    report ("int $0x80: ", time_calls (ece391_nullcall_int80));
+    if (info.features & ECE391_KINFO_SYSENTER)
+        report ("sysenter:  ", time_calls (ece391_nullcall));
+    else
+        ece391_fdputs (1, (uint8_t*)"sysenter:  not supported by this cpu\n");
+    report ("kinfo pid: ", time_calls (ece391_getpid));
+    return 0;
+}
@@ -22,6 +22,253 @@ extern int32_t ece391_vidmap (uint8_t** screen_start);
 extern int32_t ece391_set_handler (int32_t signum, void* handler);
 extern int32_t ece391_sigreturn (void);
 
+/*
+ * Signals are delivered when the process next returns to user mode; a
+ * blocked read or sleep gives up (returns -1) first.  alarm sends ALARM
+ * every ms milliseconds until called with 0, and returns the previous
+ * interval.  Without a handler DIV_ZERO, SEGFAULT and INTERRUPT kill the
+ * program, ALARM and USER1 are ignored.
+ */
+extern int32_t ece391_alarm (uint32_t ms);
+
+/*
+ * Pipes.  pipe stores a read end in fds[0] and a write end in fds[1]; reads
+ * block while it is empty and return 0 once every write end is closed,
+ * writes block while it is full and fail once every read end is closed.
+ * spawn runs command with io[0]/io[1] (the caller's fds, NULL for 0 and 1)
+ * as its stdin/stdout.  Without SPAWN_NOWAIT it waits like execute; with it
+ * the program runs alongside the caller and spawn returns its pid.
+ * Programs always share their parent's stdin/stdout.
+ */
+#define SPAWN_NOWAIT 0x1
+
+extern int32_t ece391_pipe (int32_t fds[2]);
+extern int32_t ece391_spawn (const uint8_t* command, const int32_t io[2], uint32_t flags);
+
+/*
+ * poll waits until one of the fds is ready for the events asked for, or
+ * timeout_ms passes (0 only checks, negative waits forever).  It fills in
+ * revents and returns how many entries are ready, 0 on timeout.  stdin is
+ * readable once a line has been entered, rtc once a tick has come in (the
+ * next read then returns straight away), a pipe once it has data or no
+ * writer left.  Files and directories are always ready.
+ */
+#define POLLIN   0x01
+#define POLLOUT  0x04
+#define POLLNVAL 0x20
+#define POLL_MAX_FDS 32
+
+struct pollfd {
+	int32_t fd;
+	int16_t events;
+	int16_t revents;
+};
+
+extern int32_t ece391_poll (struct pollfd* fds, uint32_t nfds, int32_t timeout_ms);
+
+/*
+ * fd flags.  With O_NONBLOCK a read or write that would wait returns -1
+ * instead (rtc: no tick since the last read; stdin: no line or key yet;
+ * pipes: empty or full).  O_RAW, on a terminal fd, switches the terminal
+ * from lines to single keys: reads return the keys typed so far as soon as
+ * there is one, nothing is echoed, Backspace/Tab/Esc arrive as '\b', '\t'
+ * and 27.  Ctrl+C and terminal switching still work, and the terminal goes
+ * back to lines when the program exits.  Terminal output is normally drawn
+ * in RAM and put on screen 50 times a second; O_SYNC, on a terminal fd,
+ * puts each write on screen before it returns (until the program exits).
+ */
+#define F_GETFL 3
+#define F_SETFL 4
+#define O_NONBLOCK 0x800
+#define O_RAW 0x1000
+#define O_SYNC 0x2000
+
+extern int32_t ece391_fcntl (int32_t fd, int32_t cmd, int32_t arg);
+
+/*
+ * fd tables grow as needed, up to FD_TABLE_MAX fds per process.  dup
+ * returns the lowest free fd, dup2 makes new_fd (closing it first if it
+ * was open); either way both fds share one open file: its position, its
+ * flags, and it stays open until the last of them is closed.  Programs
+ * started with execute/spawn share their stdin/stdout the same way.
+ */
+#define FD_TABLE_MAX 64
+
+extern int32_t ece391_dup (int32_t fd);
+extern int32_t ece391_dup2 (int32_t old_fd, int32_t new_fd);
+
+/*
+ * Kernel log.  dmesg copies whole lines "<level>[seconds.hundredths] text"
+ * (level 3 error, 4 warning, 6 info, 7 debug) starting at record *seq,
+ * then sets *seq to the record after the last one copied.  Start at 0 and
+ * call again until it returns 0; later calls with the same seq return only
+ * what was logged since.  A line is at most DMESG_LINE bytes.
+ */
+#define DMESG_LINE 140
+
+extern int32_t ece391_dmesg (uint32_t* seq, uint8_t* buf, int32_t nbytes);
+
+/*
+ * Real-time scheduling: each period the process gets budget_ms of cpu
+ * ahead of ordinary programs, scheduled earliest deadline first.  A job
+ * ends when the process waits for its next frame (rtc read).  setrt fails
+ * if the cpu would be overloaded; a period of 0 returns to normal
+ * scheduling.
+ */
+struct rt_stat {
+	uint32_t period_ms;
+	uint32_t budget_ms;
+	uint32_t releases;
+	uint32_t misses;
+};
+
+extern int32_t ece391_sched_setrt (uint32_t period_ms, uint32_t budget_ms);
+extern int32_t ece391_sched_getrt (struct rt_stat* stat);
+
+/*
+ * Sleeping.  Resolution is one scheduler tick (10 ms); times are rounded
+ * up.  A sleep that is cut short returns -1, and nanosleep stores the time
+ * left in rem (if not NULL).  yield gives up the rest of the time slice.
+ */
+struct ece391_timespec {
+	uint32_t tv_sec;
+	uint32_t tv_nsec;
+};
+
+extern int32_t ece391_sleep (uint32_t ms);
+extern int32_t ece391_nanosleep (const struct ece391_timespec* req, struct ece391_timespec* rem);
+extern int32_t ece391_yield (void);
+
+/*
+ * CPU accounting.  Fills in the tick counters of every running process
+ * and returns how many there are.  User and kernel time are counted in
+ * scheduler ticks (hz per second); sample twice and compare to get the
+ * share of the cpu each process used in between.
+ */
+#define PROC_NAME_LEN 32
+#define MAX_PROCS 6
+
+struct proc_stat {
+	int32_t pid;
+	int32_t parent_pid;
+	uint32_t terminal;
+	uint32_t utime;
+	uint32_t stime;
+	uint32_t nsyscalls;
+	uint8_t name[PROC_NAME_LEN];
+};
+
+struct cpu_stats {
+	uint32_t ticks;
+	uint32_t hz;
+	uint32_t idle_ticks;
+	uint32_t ncpus;
+	uint32_t nprocs;
+	struct proc_stat procs[MAX_PROCS];
+};
+
+extern int32_t ece391_cpustats (struct cpu_stats* stats);
+
+/* Batched system calls: queue entries at sq_tail, submit them with
+   ece391_ioring_enter, collect one completion per entry from cq_head */
+#define IORING_ENTRIES 32
+#define IORING_MASK (IORING_ENTRIES - 1)
+
+#define IORING_OP_NOP   0
+#define IORING_OP_READ  1
+#define IORING_OP_WRITE 2
+#define IORING_OP_OPEN  3
+#define IORING_OP_CLOSE 4
+
+/* use the previous entry's result (from the same enter) as len, skip if <= 0 */
+#define IOSQE_LEN_FROM_PREV 0x01
+
+struct io_sqe {
+	uint8_t opcode;
+	uint8_t flags;
+	uint16_t reserved;
+	int32_t fd;
+	uint32_t addr;
+	int32_t len;
+	uint32_t user_data;
+};
+
+struct io_cqe {
+	uint32_t user_data;
+	int32_t res;
+};
+
+struct io_ring {
+	volatile uint32_t sq_head;
+	volatile uint32_t sq_tail;
+	volatile uint32_t cq_head;
+	volatile uint32_t cq_tail;
+	struct io_sqe sq[IORING_ENTRIES];
+	struct io_cqe cq[IORING_ENTRIES];
+};
+
+extern int32_t ece391_ioring_setup (struct io_ring* ring);
+extern int32_t ece391_ioring_enter (uint32_t to_submit);
+
+/* queue one entry, 0 on success, -1 if the submission ring is full */
+extern int32_t ece391_sqe_push (struct io_ring* ring, uint8_t opcode, uint8_t flags,
+		int32_t fd, void* addr, int32_t len, uint32_t user_data);
+
+/* System call tracing. Counters are per system call number; the histogram
+   bucket b counts calls that took [2^b, 2^(b+1)) cycles */
+#define SYSTRACE_NR 32
+#define SYSTRACE_BUCKETS 32
+
+#define SYSTRACE_STATS      0	/* buf: struct sc_stat[SYSTRACE_NR], system-wide */
+#define SYSTRACE_RESET      1	/* clear the system-wide counters */
+#define SYSTRACE_CHILDREN   2	/* arg != 0: trace programs executed from here on */
+#define SYSTRACE_READ_LOG   3	/* buf: struct sc_trace[arg], returns entries read */
+#define SYSTRACE_SUMMARY    4	/* buf: struct sc_stat[SYSTRACE_NR], traced programs */
+
+struct sc_stat {
+	uint32_t count;
+	uint32_t errors;
+	uint64_t cycles;
+	uint32_t hist[SYSTRACE_BUCKETS];
+};
+
+struct sc_trace {
+	uint8_t pid;
+	uint8_t nr;
+	uint16_t reserved;
+	int32_t args[3];
+	int32_t ret;
+	uint32_t cycles;
+};
+
+extern int32_t ece391_systrace (int32_t op, int32_t arg, void* buf);
+
+/* Kernel info page at ECE391_KINFO_ADDR, read-only. seq is odd while the
+   kernel updates it; ece391_kinfo copies it consistently, the single-field
+   accessors in ece391support.h just load */
+#define ECE391_KINFO_ADDR 0x08401000
+
+struct ece391_kinfo {
+	uint32_t seq;
+	int32_t pid;
+	int32_t terminal;
+	uint32_t cpu;
+	uint32_t ticks;
+	uint32_t hz;
+	uint32_t time;		/* seconds since 1970-01-01 UTC */
+	uint32_t features;	/* ECE391_KINFO_* */
+};
+
+/* features: the system call wrappers use SYSENTER, else int $0x80 */
+#define ECE391_KINFO_SYSENTER 0x1
+
+extern void ece391_kinfo (struct ece391_kinfo* info);
+
+/* not a system call, returns -1; through SYSENTER (int $0x80 where the cpu
+   has no SYSENTER) and through int $0x80 */
+extern int32_t ece391_nullcall (void);
+extern int32_t ece391_nullcall_int80 (void);
+
 enum signums {
 	DIV_ZERO = 0,
 	SEGFAULT,
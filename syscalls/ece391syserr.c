@@ -91,7 +91,7 @@ int err_big_fd(void) {
 
 
 /* TEST 3 err_open_lots
- * calls open correctly seven times
+ * calls open correctly FD_TABLE_MAX - 1 times
  * prints "[TEST_NAME]: PASS" if behavior is EXPECTED
  *     and then returns 0
  * prints "[TEST_NAME]: FAIL" if behavior is UNEXPECTED
@@ -100,15 +100,15 @@ int err_big_fd(void) {
 int err_open_lots(void) {
     int32_t i, cnt = 0;
 	
-	// fd = 0,1 taken, so we should be able to open 6 files (2,3,4,5,6,7)
-	// the last file open should fail
-    for (i = 0; i < 7; i++) {
+	// fd = 0,1 taken, so we should be able to open FD_TABLE_MAX - 2 files
+	// (the table grows past 8 as needed), the last file open should fail
+    for (i = 0; i < FD_TABLE_MAX - 1; i++) {
 	    if (-1 == ece391_open ((uint8_t*)".")) {
 			cnt++;
         }
     }
     //close all fds that were just opened.
-    for(i = 2; i < 8; i++)
+    for(i = 2; i < FD_TABLE_MAX; i++)
     {
     	ece391_close(i);
     }
@@ -1,6 +1,7 @@
 #if !defined(ECE391SYSNUM_H)
 #define ECE391SYSNUM_H
 
+#define SYS_NULL    0
 #define SYS_HALT    1
 #define SYS_EXECUTE 2
 #define SYS_READ    3
@@ -11,5 +12,22 @@
 #define SYS_VIDMAP  8
 #define SYS_SET_HANDLER  9
 #define SYS_SIGRETURN  10
+#define SYS_SCHED_SETRT 11
+#define SYS_SCHED_GETRT 12
+#define SYS_SLEEP 13
+#define SYS_NANOSLEEP 14
+#define SYS_YIELD 15
+#define SYS_CPUSTATS 16
+#define SYS_IORING_SETUP 17
+#define SYS_IORING_ENTER 18
+#define SYS_SYSTRACE 19
+#define SYS_ALARM 20
+#define SYS_PIPE 21
+#define SYS_SPAWN 22
+#define SYS_POLL 23
+#define SYS_FCNTL 24
+#define SYS_DUP 25
+#define SYS_DUP2 26
+#define SYS_DMESG 27
 
 #endif /* ECE391SYSNUM_H */
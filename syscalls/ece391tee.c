@@ -0,0 +1,33 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 1024
+
+/* Copies standard input to standard output and to the named device, e.g.
+   "sysbench | tee ttyS0" to stream results out of the serial port too */
+int main ()
+{
+    int32_t fd, cnt;
+    uint8_t buf[BUFSIZE];
+
+    if (0 != ece391_getargs (buf, BUFSIZE) || '\0' == buf[0]) {
+        ece391_fdputs (1, (uint8_t*)"usage: tee <device>\n");
+        return 3;
+    }
+    if (-1 == (fd = ece391_open (buf))) {
+        ece391_fdputs (1, (uint8_t*)"cannot open ");
+        ece391_fdputs (1, buf);
+        ece391_fdputs (1, (uint8_t*)"\n");
+        return 2;
+    }
+
+    while (0 < (cnt = ece391_read (0, buf, BUFSIZE))) {
+        if (-1 == ece391_write (1, buf, cnt) || -1 == ece391_write (fd, buf, cnt))
+            break;
+    }
+
+    ece391_close (fd);
+    return 0;
+}
@@ -0,0 +1,60 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 128
+#define RTC_HZ 8
+
+/* Waits on the keyboard and the rtc at the same time with poll: counts
+   rtc ticks (a line every second) while echoing whatever lines are typed,
+   without either one holding up the other. "quit" ends it */
+int main ()
+{
+    uint8_t buf[BUFSIZE];
+    struct pollfd fds[2];
+    int32_t rtc_fd, cnt, hz = RTC_HZ;
+    uint32_t ticks = 0;
+
+    if (-1 == (rtc_fd = ece391_open ((uint8_t*)"rtc"))) {
+        ece391_fdputs (1, (uint8_t*)"rtc open failed\n");
+        return 2;
+    }
+    ece391_write (rtc_fd, &hz, sizeof (hz));
+
+    fds[0].fd = 0;
+    fds[0].events = POLLIN;
+    fds[1].fd = rtc_fd;
+    fds[1].events = POLLIN;
+
+    ece391_fdputs (1, (uint8_t*)"type lines, \"quit\" to stop\n");
+    while (1) {
+        if (-1 == ece391_poll (fds, 2, -1))
+            break;
+
+        if (fds[1].revents & POLLIN) {
+            ece391_read (rtc_fd, buf, 0);
+            if (0 == ++ticks % RTC_HZ) {
+                ece391_fdputs (1, (uint8_t*)"tick ");
+                ece391_fdputs (1, ece391_itoa (ticks / RTC_HZ, buf, 10));
+                ece391_fdputs (1, (uint8_t*)"\n");
+            }
+        }
+
+        if (fds[0].revents & POLLIN) {
+            if (-1 == (cnt = ece391_read (0, buf, BUFSIZE - 1)))
+                break;
+            buf[cnt] = '\0';
+            if (cnt > 0 && '\n' == buf[cnt - 1])
+                buf[--cnt] = '\0';
+            if (0 == ece391_strncmp (buf, (uint8_t*)"quit", 5))
+                break;
+            ece391_fdputs (1, (uint8_t*)"you typed: ");
+            ece391_fdputs (1, buf);
+            ece391_fdputs (1, (uint8_t*)"\n");
+        }
+    }
+
+    ece391_close (rtc_fd);
+    return 0;
+}
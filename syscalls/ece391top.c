@@ -0,0 +1,129 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 32
+#define DEFAULT_ROUNDS 10
+#define SAMPLE_MS 1000
+
+static struct cpu_stats prev, cur;
+
+/* print s left-aligned in a column of width w */
+static void
+put_col (const uint8_t* s, uint32_t w)
+{
+    uint32_t len = ece391_strlen (s);
+
+    ece391_fdputs (1, s);
+    while (len++ < w)
+        ece391_fdputs (1, (uint8_t*)" ");
+}
+
+static void
+put_num (uint32_t n, uint32_t w)
+{
+    uint8_t buf[BUFSIZE];
+
+    put_col (ece391_itoa (n, buf, 10), w);
+}
+
+/* per-mille of the sample interval, printed as xx.x% */
+static void
+put_share (uint32_t used, uint32_t total)
+{
+    uint8_t buf[BUFSIZE];
+    uint32_t pm = (total == 0) ? 0 : (used * 1000 + total / 2) / total;
+
+    ece391_fdputs (1, ece391_itoa (pm / 10, buf, 10));
+    ece391_fdputs (1, (uint8_t*)".");
+    ece391_fdputs (1, ece391_itoa (pm % 10, buf, 10));
+    ece391_fdputs (1, (uint8_t*)"%");
+    put_col ((uint8_t*)"", (pm >= 1000 ? 1 : (pm >= 100 ? 2 : 3)));
+}
+
+/* matching entry in the previous sample, NULL if the process is new */
+static struct proc_stat*
+find_prev (const struct proc_stat* p)
+{
+    uint32_t i;
+
+    for (i = 0; i < prev.nprocs; i++) {
+        if (prev.procs[i].pid == p->pid &&
+            0 == ece391_strcmp (prev.procs[i].name, p->name))
+            return &prev.procs[i];
+    }
+    return 0;
+}
+
+static void
+show (void)
+{
+    uint32_t i, dt, du, ds, busy = 0;
+    struct proc_stat* p;
+    struct proc_stat* old;
+
+    dt = cur.ticks - prev.ticks;
+    ece391_fdputs (1, (uint8_t*)"\nPID PPID TTY USER%  SYS%   SYSCALLS  COMMAND\n");
+    for (i = 0; i < cur.nprocs; i++) {
+        p = &cur.procs[i];
+        old = find_prev (p);
+        du = p->utime - (old ? old->utime : 0);
+        ds = p->stime - (old ? old->stime : 0);
+        busy += du + ds;
+
+        put_num (p->pid, 4);
+        if (p->parent_pid < 0)
+            put_col ((uint8_t*)"-", 5);
+        else
+            put_num (p->parent_pid, 5);
+        put_num (p->terminal, 4);
+        put_share (du, dt);
+        put_share (ds, dt);
+        put_num (p->nsyscalls - (old ? old->nsyscalls : 0), 10);
+        ece391_fdputs (1, p->name);
+        ece391_fdputs (1, (uint8_t*)"\n");
+    }
+    /* busy and idle are shares of all cpus together */
+    ece391_fdputs (1, (uint8_t*)"cpus ");
+    put_num (cur.ncpus, 1);
+    ece391_fdputs (1, (uint8_t*)" busy ");
+    put_share (busy, dt * cur.ncpus);
+    ece391_fdputs (1, (uint8_t*)" idle ");
+    put_share (cur.idle_ticks - prev.idle_ticks, dt * cur.ncpus);
+    ece391_fdputs (1, (uint8_t*)"\n");
+}
+
+int main ()
+{
+    uint8_t buf[BUFSIZE];
+    uint32_t rounds = DEFAULT_ROUNDS;
+    uint32_t i;
+
+    if (0 == ece391_getargs (buf, BUFSIZE) && buf[0] != '\0') {
+        rounds = 0;
+        for (i = 0; buf[i] >= '0' && buf[i] <= '9'; i++)
+            rounds = rounds * 10 + (buf[i] - '0');
+        if (0 == rounds || buf[i] != '\0') {
+            ece391_fdputs (1, (uint8_t*)"usage: top [rounds]\n");
+            return 3;
+        }
+    }
+
+    if (-1 == ece391_cpustats (&prev)) {
+        ece391_fdputs (1, (uint8_t*)"cpustats failed\n");
+        return 3;
+    }
+
+    for (i = 0; i < rounds; i++) {
+        ece391_msleep (SAMPLE_MS);
+        if (-1 == ece391_cpustats (&cur)) {
+            ece391_fdputs (1, (uint8_t*)"cpustats failed\n");
+            return 3;
+        }
+        show ();
+        prev = cur;
+    }
+
+    return 0;
+}